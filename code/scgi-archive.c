@@ -0,0 +1,276 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Parallel processing of request archives (UNIX only).
+ */
+
+#include "scgi-archive.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Range of requests handled by one thread. */
+struct scgi_archive_range
+{
+    pthread_t handle;
+    const struct scgi_archive * archive;
+    size_t thread;
+    size_t first;
+    size_t last;
+    scgi_archive_visit visit;
+    void * object;
+};
+
+/* Parse a decimal length, stopping at @a stop.  Returns the number of bytes
+   used, including the stop byte, or 0 on error. */
+static size_t scgi_archive_length (const char * data, size_t size,
+                                   char stop, size_t * length)
+{
+    size_t used = 0;
+    *length = 0;
+    while ((used < size) && (data[used] >= '0') && (data[used] <= '9'))
+    {
+        if (*length > (((size_t)-1 - 9) / 10)) {
+            return (0);
+        }
+        *length = *length*10 + (size_t)(data[used++] - '0');
+    }
+    if ((used == 0) || (used == size) || (data[used] != stop)) {
+        return (0);
+    }
+    return (used + 1);
+}
+
+size_t scgi_archive_measure (const char * data, size_t size)
+{
+    static const char field[] = "CONTENT_LENGTH";
+    const char * head = 0;
+    const char * end = 0;
+    const char * value = 0;
+    size_t head_size = 0;
+    size_t body_size = 0;
+    size_t used = scgi_archive_length(data, size, ':', &head_size);
+    if ((used == 0) || (head_size >= (size - used))) {
+        return (0);
+    }
+    head = data + used;
+    if (head[head_size] != ',') {
+        return (0);
+    }
+    /* "CONTENT_LENGTH" comes first in conforming requests. */
+    end = head + head_size;
+    while (head < end)
+    {
+        value = (const char*)memchr(head, '\0', end-head);
+        if (value == 0) {
+            return (0);
+        }
+        ++value;
+        if ((size_t)(value-head) == sizeof(field) &&
+            (memcmp(head, field, sizeof(field)) == 0))
+        {
+            if (scgi_archive_length(value, end-value, '\0', &body_size) == 0) {
+                return (0);
+            }
+            break;
+        }
+        head = (const char*)memchr(value, '\0', end-value);
+        if (head == 0) {
+            return (0);
+        }
+        ++head;
+    }
+    used += head_size + 1;
+    if (body_size > (size - used)) {
+        return (0);
+    }
+    return (used + body_size);
+}
+
+int scgi_archive_map (struct scgi_archive * archive, const char * path)
+{
+    struct stat status;
+    void * data = 0;
+    size_t capacity = 1024;
+    size_t offset = 0;
+    size_t size = 0;
+    size_t * offsets = 0;
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return (-1);
+    }
+    if (fstat(file, &status) < 0) {
+        close(file);
+        return (-1);
+    }
+    archive->data = 0;
+    archive->size = (size_t)status.st_size;
+    archive->count = 0;
+    archive->garbage = 0;
+    archive->offsets = 0;
+    if (archive->size > 0)
+    {
+        data = mmap(0, archive->size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED) {
+            close(file);
+            return (-1);
+        }
+        archive->data = (const char*)data;
+    }
+    close(file);
+    archive->offsets = (size_t*)malloc(capacity*sizeof(size_t));
+    if (archive->offsets == 0) {
+        scgi_archive_unmap(archive);
+        errno = ENOMEM;
+        return (-1);
+    }
+    archive->offsets[0] = 0;
+    while ((size = scgi_archive_measure(archive->data+offset,
+                                        archive->size-offset)) > 0)
+    {
+        offset += size;
+        if ((archive->count + 2) > capacity)
+        {
+            capacity *= 2;
+            offsets = (size_t*)realloc(archive->offsets,
+                                       capacity*sizeof(size_t));
+            if (offsets == 0) {
+                scgi_archive_unmap(archive);
+                errno = ENOMEM;
+                return (-1);
+            }
+            archive->offsets = offsets;
+        }
+        archive->offsets[++archive->count] = offset;
+    }
+    archive->garbage = archive->size - offset;
+    /* threads read their ranges front to back. */
+    if (archive->size > 0) {
+        madvise(data, archive->size, MADV_SEQUENTIAL);
+    }
+    return (0);
+}
+
+static void * scgi_archive_thread (void * object)
+{
+    const struct scgi_archive_range *const range =
+        (const struct scgi_archive_range*)object;
+    const size_t *const offsets = range->archive->offsets;
+    size_t i = 0;
+    for (i = range->first; i < range->last; ++i)
+    {
+        range->visit(range->object, range->thread,
+                     range->archive->data + offsets[i],
+                     offsets[i+1] - offsets[i]);
+    }
+    return (0);
+}
+
+/* First request at or after byte @a offset. */
+static size_t scgi_archive_find (const struct scgi_archive * archive,
+                                 size_t offset)
+{
+    size_t lower = 0;
+    size_t upper = archive->count;
+    size_t middle = 0;
+    while (lower < upper)
+    {
+        middle = lower + (upper - lower) / 2;
+        if (archive->offsets[middle] < offset) {
+            lower = middle + 1;
+        }
+        else {
+            upper = middle;
+        }
+    }
+    return (lower);
+}
+
+int scgi_archive_run (const struct scgi_archive * archive, size_t threads,
+                      scgi_archive_visit visit, void * object)
+{
+    struct scgi_archive_range * ranges = 0;
+    const size_t total = archive->offsets[archive->count];
+    size_t started = 0;
+    size_t i = 0;
+    int error = 0;
+    if (threads == 0) {
+        threads = 1;
+    }
+    ranges = (struct scgi_archive_range*)malloc(threads*sizeof(*ranges));
+    if (ranges == 0) {
+        errno = ENOMEM;
+        return (-1);
+    }
+    /* split by bytes, so large bodies don't unbalance the threads. */
+    for (i = 0; i < threads; ++i)
+    {
+        ranges[i].archive = archive;
+        ranges[i].thread = i;
+        ranges[i].first = (i == 0)? 0 : ranges[i-1].last;
+        ranges[i].last = (i == threads-1)? archive->count :
+            scgi_archive_find(archive, total / threads * (i+1));
+        ranges[i].visit = visit;
+        ranges[i].object = object;
+    }
+    /* the calling thread handles the first range itself. */
+    for (i = 1; i < threads; ++i, ++started)
+    {
+        error = pthread_create(&ranges[i].handle, 0,
+                               &scgi_archive_thread, &ranges[i]);
+        if (error != 0) {
+            break;
+        }
+    }
+    if (error == 0) {
+        scgi_archive_thread(&ranges[0]);
+    }
+    for (i = 0; i < started; ++i) {
+        pthread_join(ranges[i+1].handle, 0);
+    }
+    free(ranges);
+    if (error != 0) {
+        errno = error;
+        return (-1);
+    }
+    return (0);
+}
+
+void scgi_archive_unmap (struct scgi_archive * archive)
+{
+    if (archive->data != 0) {
+        munmap((void*)archive->data, archive->size);
+    }
+    free(archive->offsets);
+    archive->data = 0;
+    archive->size = 0;
+    archive->count = 0;
+    archive->garbage = 0;
+    archive->offsets = 0;
+}
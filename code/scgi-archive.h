@@ -0,0 +1,118 @@
+#ifndef _scgi_archive_h__
+#define _scgi_archive_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Parallel processing of request archives (UNIX only).
+ *
+ * An archive is a file of concatenated SCGI requests, as received by a
+ * server.  The archive is mapped in memory and indexed in a single pass
+ * that only touches the start of each request: the netstring length gives
+ * the size of the head and the "CONTENT_LENGTH" header the size of the
+ * body.  Requests are then split into one contiguous range per thread, of
+ * roughly equal size in bytes, and each thread parses its own range with
+ * its own state.  The application merges per-thread results afterwards.
+ *
+ * Functions in this module return -1 and set @c errno on failure.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Memory-mapped archive of SCGI requests.
+ */
+struct scgi_archive
+{
+    /*!
+     * @public
+     * @brief Mapped file contents.
+     */
+    const char * data;
+    size_t size;
+
+    /*!
+     * @public
+     * @brief Number of well-formed requests.
+     */
+    size_t count;
+
+    /*!
+     * @public
+     * @brief Number of trailing bytes that don't form a complete request.
+     *
+     * Indexing stops at the first malformed or truncated request.
+     */
+    size_t garbage;
+
+    /*!
+     * @private
+     * @brief Offset of each request, plus the end of the last one.
+     */
+    size_t * offsets;
+};
+
+/*!
+ * @brief Callback that processes one request.
+ * @param object Application data passed to @c scgi_archive_run().
+ * @param thread Index of the calling thread, for per-thread state.
+ * @param data Complete request (netstring head and body).
+ * @param size Size of @a data, in bytes.
+ */
+typedef void(*scgi_archive_visit)(void * object, size_t thread,
+                                  const char * data, size_t size);
+
+/*!
+ * @brief Get the size of the request at the start of @a data.
+ * @return 0 if the request is malformed or truncated.
+ */
+size_t scgi_archive_measure (const char * data, size_t size);
+
+/*!
+ * @brief Map an archive in memory and index its requests.
+ */
+int scgi_archive_map (struct scgi_archive * archive, const char * path);
+
+/*!
+ * @brief Process all requests, split across @a threads threads.
+ *
+ * Thread @c i visits a contiguous range of requests, in archive order.
+ * Returns once all threads are done.
+ */
+int scgi_archive_run (const struct scgi_archive * archive, size_t threads,
+                      scgi_archive_visit visit, void * object);
+
+/*!
+ * @brief Release the index and unmap the archive.
+ */
+void scgi_archive_unmap (struct scgi_archive * archive);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_archive_h__ */
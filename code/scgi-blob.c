@@ -0,0 +1,237 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Flat, relocatable copy of a parsed request.
+ */
+
+#include "scgi-blob.h"
+#include <errno.h>
+#include <string.h>
+
+/* Check that a span fits in a blob, without overflow. */
+static int scgi_blob_span (size_t size, size_t offset, size_t length)
+{
+    return ((offset <= size) && (length <= (size - offset)));
+}
+
+/* Check that a null-terminated string fits in a blob.  The terminator is
+   not added to the length, which could wrap. */
+static int scgi_blob_string (const char * base, size_t size,
+                             size_t offset, size_t length)
+{
+    return ((offset < size) && (length < (size - offset)) &&
+            (base[offset+length] == '\0'));
+}
+
+static int scgi_blob_append (struct scgi_parser * parser,
+                             const char * data, size_t size)
+{
+    struct scgi_blob_writer *const writer =
+        (struct scgi_blob_writer*)parser->object;
+    struct scgi_blob *const blob = (struct scgi_blob*)writer->data;
+    if (!scgi_blob_span(writer->capacity, blob->size, size)) {
+        parser->error = scgi_error_head_overflow;
+        return (0);
+    }
+    memcpy(writer->data+blob->size, data, size);
+    blob->size += (uint32_t)size;
+    return (1);
+}
+
+static void scgi_blob_accept
+    (struct scgi_parser * parser, const char * data, size_t size)
+{
+    scgi_blob_append(parser, data, size);
+}
+
+static void scgi_blob_finish (struct scgi_parser * parser)
+{
+    scgi_blob_append(parser, "", 1);
+}
+
+static void scgi_blob_finish_head (struct scgi_parser * parser)
+{
+    static const char padding[4] = { 0 };
+    struct scgi_blob_writer *const writer =
+        (struct scgi_blob_writer*)parser->object;
+    struct scgi_blob *const blob = (struct scgi_blob*)writer->data;
+    struct scgi_blob_entry * entry = 0;
+    const char * next = writer->data + sizeof(struct scgi_blob);
+    const char *const end = writer->data + blob->size;
+    size_t count = 0;
+    /* names and values alternate, each followed by a null byte. */
+    while ((next < end) &&
+           ((next = (const char*)memchr(next, '\0', end-next)) != 0)) {
+        ++next, ++count;
+    }
+    count /= 2;
+    if (!scgi_blob_append(parser, padding, (4 - (blob->size % 4)) % 4) ||
+        !scgi_blob_span(writer->capacity, blob->size,
+                        count*sizeof(struct scgi_blob_entry)))
+    {
+        parser->error = scgi_error_head_overflow;
+        return;
+    }
+    blob->count = (uint32_t)count;
+    blob->table = blob->size;
+    entry = (struct scgi_blob_entry*)(writer->data+blob->table);
+    next = writer->data + sizeof(struct scgi_blob);
+    for (; count > 0; --count, ++entry)
+    {
+        entry->field = (uint32_t)(next - writer->data);
+        entry->field_size = (uint32_t)strlen(next);
+        next += entry->field_size + 1;
+        entry->value = (uint32_t)(next - writer->data);
+        entry->value_size = (uint32_t)strlen(next);
+        next += entry->value_size + 1;
+    }
+    blob->size += blob->count * sizeof(struct scgi_blob_entry);
+    blob->body = blob->size;
+}
+
+static size_t scgi_blob_accept_body
+    (struct scgi_parser * parser, const char * data, size_t size)
+{
+    struct scgi_blob_writer *const writer =
+        (struct scgi_blob_writer*)parser->object;
+    struct scgi_blob *const blob = (struct scgi_blob*)writer->data;
+    if (!writer->body) {
+        return (size);
+    }
+    if (!scgi_blob_span(writer->capacity, blob->size, size)) {
+        parser->error = scgi_error_body_overflow;
+        return (0);
+    }
+    memcpy(writer->data+blob->size, data, size);
+    blob->size += (uint32_t)size;
+    blob->body_size += (uint32_t)size;
+    return (size);
+}
+
+int scgi_blob_writer_setup (struct scgi_blob_writer * writer,
+                            struct scgi_parser * parser,
+                            void * data, size_t capacity)
+{
+    struct scgi_blob *const blob = (struct scgi_blob*)data;
+    if (capacity < sizeof(struct scgi_blob)) {
+        errno = EINVAL;
+        return (-1);
+    }
+    writer->data = (char*)data;
+    writer->capacity = (capacity < UINT32_MAX)? capacity : UINT32_MAX;
+    blob->size = sizeof(struct scgi_blob);
+    blob->count = 0;
+    blob->table = blob->size;
+    blob->body = blob->size;
+    blob->body_size = 0;
+    parser->object = writer;
+    parser->accept_field = &scgi_blob_accept;
+    parser->finish_field = &scgi_blob_finish;
+    parser->accept_value = &scgi_blob_accept;
+    parser->finish_value = &scgi_blob_finish;
+    parser->finish_head = &scgi_blob_finish_head;
+    parser->accept_body = &scgi_blob_accept_body;
+    return (0);
+}
+
+const struct scgi_blob * scgi_blob_check (const void * data, size_t size)
+{
+    const struct scgi_blob *const blob = (const struct scgi_blob*)data;
+    const struct scgi_blob_entry * entry = 0;
+    const char *const base = (const char*)data;
+    size_t i = 0;
+    if ((size < sizeof(struct scgi_blob)) || (blob->size > size) ||
+        ((blob->table % 4) != 0) || (blob->table < sizeof(struct scgi_blob))
+        || (blob->count > (size / sizeof(struct scgi_blob_entry)))
+        || !scgi_blob_span(blob->size, blob->table,
+                           blob->count*sizeof(struct scgi_blob_entry))
+        || !scgi_blob_span(blob->size, blob->body, blob->body_size))
+    {
+        return (0);
+    }
+    entry = (const struct scgi_blob_entry*)(base+blob->table);
+    for (i = 0; i < blob->count; ++i, ++entry)
+    {
+        if (!scgi_blob_string(base, blob->size,
+                              entry->field, entry->field_size) ||
+            !scgi_blob_string(base, blob->size,
+                              entry->value, entry->value_size))
+        {
+            return (0);
+        }
+    }
+    return (blob);
+}
+
+static const struct scgi_blob_entry * scgi_blob_entry
+    (const struct scgi_blob * blob, size_t i)
+{
+    return ((const struct scgi_blob_entry*)
+            ((const char*)blob + blob->table) + i);
+}
+
+const char * scgi_blob_field (const struct scgi_blob * blob, size_t i,
+                              size_t * size)
+{
+    const struct scgi_blob_entry *const entry = scgi_blob_entry(blob, i);
+    if (size) {
+        *size = entry->field_size;
+    }
+    return ((const char*)blob + entry->field);
+}
+
+const char * scgi_blob_value (const struct scgi_blob * blob, size_t i,
+                              size_t * size)
+{
+    const struct scgi_blob_entry *const entry = scgi_blob_entry(blob, i);
+    if (size) {
+        *size = entry->value_size;
+    }
+    return ((const char*)blob + entry->value);
+}
+
+const char * scgi_blob_header (const struct scgi_blob * blob,
+                               const char * field, size_t * size)
+{
+    const size_t length = strlen(field);
+    const struct scgi_blob_entry * entry = scgi_blob_entry(blob, 0);
+    size_t i = 0;
+    for (i = 0; i < blob->count; ++i, ++entry)
+    {
+        if ((entry->field_size == length) &&
+            (memcmp((const char*)blob+entry->field, field, length) == 0))
+        {
+            return (scgi_blob_value(blob, i, size));
+        }
+    }
+    return (0);
+}
+
+const char * scgi_blob_body (const struct scgi_blob * blob, size_t * size)
+{
+    if (size) {
+        *size = blob->body_size;
+    }
+    return ((const char*)blob + blob->body);
+}
@@ -0,0 +1,168 @@
+#ifndef _scgi_blob_h__
+#define _scgi_blob_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Flat, relocatable copy of a parsed request.
+ *
+ * A blob holds a request in one contiguous buffer: a @c scgi_blob header,
+ * the raw header names and values, a table of @c scgi_blob_entry records
+ * and, optionally, the body.  All positions are offsets from the start of
+ * the blob, so it can be handed to another thread or process by passing a
+ * pointer, with a single @c memcpy(), or through shared memory, and queried
+ * in place.
+ *
+ * Blobs are written directly by the parser's callbacks (see @c
+ * scgi_blob_writer_setup()) into a buffer supplied by the application.  The
+ * buffer must be aligned on 4 bytes.  Integers are stored in the byte order
+ * of the writing host.
+ */
+
+#include "scgi.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Blob header, at the start of the buffer.
+ */
+struct scgi_blob
+{
+    /*!
+     * @brief Size of the blob, in bytes, including this header.
+     */
+    uint32_t size;
+
+    /*!
+     * @brief Number of headers.
+     */
+    uint32_t count;
+
+    /*!
+     * @brief Offset of the first of @c count @c scgi_blob_entry records.
+     */
+    uint32_t table;
+
+    /*!
+     * @brief Offset and size of the body, in bytes.
+     *
+     * The size is 0 when the body is not stored in the blob.
+     */
+    uint32_t body;
+    uint32_t body_size;
+};
+
+/*!
+ * @brief Location of a header in the blob.
+ *
+ * Names and values are followed by a null byte, which is not counted in
+ * their size.
+ */
+struct scgi_blob_entry
+{
+    uint32_t field;
+    uint32_t field_size;
+    uint32_t value;
+    uint32_t value_size;
+};
+
+/*!
+ * @brief Parser callbacks writing a blob.
+ */
+struct scgi_blob_writer
+{
+    /*!
+     * @public
+     * @brief Non-zero to store the body in the blob.
+     */
+    int body;
+
+    /*!
+     * @private
+     * @brief Output buffer.
+     */
+    char * data;
+    size_t capacity;
+};
+
+/*!
+ * @brief Start writing a blob from a parser.
+ * @param writer Writer state, which must outlive the parser.
+ * @param parser Parser, initialized with @c scgi_setup().  Its @c object and
+ *  callback fields are replaced.
+ * @param data Output buffer, aligned on 4 bytes.
+ * @param capacity Size of @a data, in bytes.
+ * @return 0 on success, -1 (with @c errno set to @c EINVAL) if @a capacity
+ *  can't even hold an empty blob, in which case nothing is changed.
+ *
+ * If the head or body does not fit in the buffer, the parser reports @c
+ * scgi_error_head_overflow or @c scgi_error_body_overflow.
+ */
+int scgi_blob_writer_setup (struct scgi_blob_writer * writer,
+                            struct scgi_parser * parser,
+                            void * data, size_t capacity);
+
+/*!
+ * @brief Check that a blob received from elsewhere is well formed.
+ * @param data Buffer holding the blob, aligned on 4 bytes.
+ * @param size Size of @a data, in bytes.
+ * @return The blob, or null if it is truncated or has invalid offsets.
+ */
+const struct scgi_blob * scgi_blob_check (const void * data, size_t size);
+
+/*!
+ * @brief Get the name of the @a i-th header.
+ * @param blob Blob.
+ * @param i Index of the header, less than @c blob->count.
+ * @param size Receives the size of the name, in bytes.  May be null.
+ * @return The null-terminated name.
+ */
+const char * scgi_blob_field (const struct scgi_blob * blob, size_t i,
+                              size_t * size);
+
+/*!
+ * @brief Get the value of the @a i-th header.
+ */
+const char * scgi_blob_value (const struct scgi_blob * blob, size_t i,
+                              size_t * size);
+
+/*!
+ * @brief Look up a header's value by name.
+ * @return The null-terminated value, or null if the header is absent.
+ */
+const char * scgi_blob_header (const struct scgi_blob * blob,
+                               const char * field, size_t * size);
+
+/*!
+ * @brief Get the body stored in the blob, if any.
+ */
+const char * scgi_blob_body (const struct scgi_blob * blob, size_t * size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_blob_h__ */
@@ -0,0 +1,103 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Process-wide memory budget shared by all connections (UNIX only).
+ */
+
+#include "scgi-budget.h"
+#include <errno.h>
+
+static void scgi_budget_peaked (struct scgi_budget * budget, size_t used)
+{
+    size_t peak = __atomic_load_n(&budget->peak, __ATOMIC_RELAXED);
+    while ((used > peak) &&
+           !__atomic_compare_exchange_n(&budget->peak, &peak, used, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+void scgi_budget_setup (struct scgi_budget * budget, size_t limit)
+{
+    budget->limit = limit;
+    budget->refuse_mark = limit / 4 * 3;
+    budget->pause_mark = limit / 8 * 7;
+    budget->used = 0;
+    budget->peak = 0;
+    budget->failures = 0;
+}
+
+int scgi_budget_charge (struct scgi_budget * budget, size_t size)
+{
+    size_t used = __atomic_load_n(&budget->used, __ATOMIC_RELAXED);
+    do {
+        if ((used > budget->limit) || (size > (budget->limit - used))) {
+            __atomic_add_fetch(&budget->failures, 1, __ATOMIC_RELAXED);
+            errno = ENOMEM;
+            return (-1);
+        }
+    }
+    while (!__atomic_compare_exchange_n(&budget->used, &used, used + size, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    scgi_budget_peaked(budget, used + size);
+    return (0);
+}
+
+void scgi_budget_force (struct scgi_budget * budget, size_t size)
+{
+    scgi_budget_peaked(budget,
+        __atomic_add_fetch(&budget->used, size, __ATOMIC_RELAXED));
+}
+
+void scgi_budget_credit (struct scgi_budget * budget, size_t size)
+{
+    __atomic_sub_fetch(&budget->used, size, __ATOMIC_RELAXED);
+}
+
+enum scgi_budget_state scgi_budget_state (const struct scgi_budget * budget)
+{
+    const size_t used = scgi_budget_used(budget);
+    if (used >= budget->pause_mark) {
+        return (scgi_budget_pause);
+    }
+    if (used >= budget->refuse_mark) {
+        return (scgi_budget_refuse);
+    }
+    return (scgi_budget_normal);
+}
+
+size_t scgi_budget_used (const struct scgi_budget * budget)
+{
+    return (__atomic_load_n(&budget->used, __ATOMIC_RELAXED));
+}
+
+size_t scgi_budget_peak (const struct scgi_budget * budget)
+{
+    return (__atomic_load_n(&budget->peak, __ATOMIC_RELAXED));
+}
+
+size_t scgi_budget_failures (const struct scgi_budget * budget)
+{
+    return (__atomic_load_n(&budget->failures, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,162 @@
+#ifndef _scgi_budget_h__
+#define _scgi_budget_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Process-wide memory budget shared by all connections (UNIX only).
+ *
+ * @c scgi_limits bounds a single request.  A budget bounds the total memory
+ * held by all connections: connection objects, parsers, header buffers and
+ * body buffers are charged when allocated and credited when released.
+ * Charges never exceed the limit.  Before that, the server sheds load in two
+ * steps: above the "refuse" mark it stops accepting connections, and above
+ * the "pause" mark it also stops reading from connections whose request is
+ * incomplete.  Requests already being handled, and responses being sent,
+ * are never interrupted.
+ *
+ * All functions are lock-free and may be called from any thread.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Load shedding levels.
+ */
+enum scgi_budget_state
+{
+    /*!
+     * @brief Accept connections and read requests.
+     */
+    scgi_budget_normal,
+
+    /*!
+     * @brief Stop accepting new connections.
+     */
+    scgi_budget_refuse,
+
+    /*!
+     * @brief Also stop reading incomplete requests.
+     */
+    scgi_budget_pause,
+};
+
+/*!
+ * @brief Memory budget.
+ */
+struct scgi_budget
+{
+    /*!
+     * @public
+     * @brief Maximum number of bytes charged at any time.
+     */
+    size_t limit;
+
+    /*!
+     * @public
+     * @brief Usage above which new connections are refused.
+     *
+     * Defaults to 3/4 of the limit.
+     */
+    size_t refuse_mark;
+
+    /*!
+     * @public
+     * @brief Usage above which reads are paused.
+     *
+     * Defaults to 7/8 of the limit.
+     */
+    size_t pause_mark;
+
+    /*!
+     * @private
+     * @brief Number of bytes currently charged.
+     */
+    size_t used;
+
+    /*!
+     * @private
+     * @brief Highest value of @c used so far.
+     */
+    size_t peak;
+
+    /*!
+     * @private
+     * @brief Number of failed charges.
+     */
+    size_t failures;
+};
+
+/*!
+ * @brief Initialize a budget of @a limit bytes, with default marks.
+ */
+void scgi_budget_setup (struct scgi_budget * budget, size_t limit);
+
+/*!
+ * @brief Charge an allocation against the budget.
+ * @return 0 on success, -1 (with @c errno set to @c ENOMEM) if the charge
+ *  would exceed the limit, in which case nothing is charged.
+ */
+int scgi_budget_charge (struct scgi_budget * budget, size_t size);
+
+/*!
+ * @brief Charge an allocation, even past the limit.
+ *
+ * Use this for memory that an in-flight request cannot do without.
+ */
+void scgi_budget_force (struct scgi_budget * budget, size_t size);
+
+/*!
+ * @brief Return memory to the budget.
+ */
+void scgi_budget_credit (struct scgi_budget * budget, size_t size);
+
+/*!
+ * @brief Get the current load shedding level.
+ */
+enum scgi_budget_state scgi_budget_state (const struct scgi_budget * budget);
+
+/*!
+ * @brief Get the number of bytes currently charged.
+ */
+size_t scgi_budget_used (const struct scgi_budget * budget);
+
+/*!
+ * @brief Get the highest number of bytes charged so far.
+ */
+size_t scgi_budget_peak (const struct scgi_budget * budget);
+
+/*!
+ * @brief Get the number of charges refused so far.
+ */
+size_t scgi_budget_failures (const struct scgi_budget * budget);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_budget_h__ */
@@ -0,0 +1,354 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief In-process cache of serialized responses (UNIX only).
+ */
+
+#include "scgi-cache.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SCGI_CACHE_SHARDS 16
+#define SCGI_CACHE_BUCKETS 256
+
+#if defined(CLOCK_MONOTONIC_COARSE)
+# define SCGI_CACHE_CLOCK CLOCK_MONOTONIC_COARSE
+#else
+# define SCGI_CACHE_CLOCK CLOCK_MONOTONIC
+#endif
+
+static uint64_t scgi_cache_now ()
+{
+    struct timespec now;
+    clock_gettime(SCGI_CACHE_CLOCK, &now);
+    return ((uint64_t)now.tv_sec*1000000000u + (uint64_t)now.tv_nsec);
+}
+
+/* FNV-1a. */
+static uint64_t scgi_cache_hash (const char * data, size_t size)
+{
+    uint64_t hash = 14695981039346656037u;
+    size_t i = 0;
+    for (i = 0; i < size; ++i) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211u;
+    }
+    return (hash);
+}
+
+static const char * scgi_cache_entry_key (const struct scgi_cache_entry * entry)
+{
+    return ((const char*)(entry+1));
+}
+
+static struct scgi_cache_shard * scgi_cache_shard
+    (const struct scgi_cache * cache, uint64_t hash)
+{
+    return (&cache->shards[hash % cache->shard_count]);
+}
+
+static struct scgi_cache_entry ** scgi_cache_bucket
+    (const struct scgi_cache * cache, struct scgi_cache_shard * shard,
+     uint64_t hash)
+{
+    return (&shard->buckets[(hash >> 32) % cache->bucket_count]);
+}
+
+int scgi_cache_setup (struct scgi_cache * cache, size_t readers,
+                      size_t capacity, unsigned long ttl)
+{
+    size_t i = 0;
+    cache->ttl = (uint64_t)ttl * 1000000u;
+    cache->capacity = capacity;
+    cache->vary_count = 0;
+    cache->shard_count = SCGI_CACHE_SHARDS;
+    cache->bucket_count = SCGI_CACHE_BUCKETS;
+    cache->epoch = 0;
+    cache->reader_count = readers;
+    cache->retired = 0;
+    cache->shards = (struct scgi_cache_shard*)calloc(
+        cache->shard_count, sizeof(struct scgi_cache_shard));
+    cache->readers = (uint64_t*)calloc(readers + 1, sizeof(uint64_t));
+    if ((cache->shards == 0) || (cache->readers == 0)) {
+        free(cache->shards), cache->shards = 0;
+        free(cache->readers), cache->readers = 0;
+        errno = ENOMEM;
+        return (-1);
+    }
+    for (i = 0; i < cache->shard_count; ++i)
+    {
+        cache->shards[i].buckets = (struct scgi_cache_entry**)calloc(
+            cache->bucket_count, sizeof(struct scgi_cache_entry*));
+        if (cache->shards[i].buckets == 0) {
+            cache->shard_count = i;
+            scgi_cache_release(cache);
+            errno = ENOMEM;
+            return (-1);
+        }
+        pthread_mutex_init(&cache->shards[i].lock, 0);
+    }
+    pthread_mutex_init(&cache->lock, 0);
+    return (0);
+}
+
+void scgi_cache_release (struct scgi_cache * cache)
+{
+    struct scgi_cache_entry * entry = 0;
+    struct scgi_cache_entry * next = 0;
+    size_t i = 0;
+    for (i = 0; i < cache->shard_count; ++i)
+    {
+        for (entry = cache->shards[i].oldest; entry != 0; entry = next) {
+            next = entry->newer, free(entry);
+        }
+        free(cache->shards[i].buckets);
+        pthread_mutex_destroy(&cache->shards[i].lock);
+    }
+    for (entry = cache->retired; entry != 0; entry = next) {
+        next = entry->older, free(entry);
+    }
+    if (cache->shards != 0) {
+        pthread_mutex_destroy(&cache->lock);
+    }
+    free(cache->shards), cache->shards = 0;
+    free(cache->readers), cache->readers = 0;
+    cache->shard_count = 0;
+    cache->retired = 0;
+}
+
+int scgi_cache_vary (struct scgi_cache * cache, const char * name)
+{
+    if (cache->vary_count == SCGI_CACHE_MAX_VARY) {
+        errno = ENOSPC;
+        return (-1);
+    }
+    cache->vary[cache->vary_count++] = name;
+    return (0);
+}
+
+int scgi_cache_vary_index (const struct scgi_cache * cache,
+                           const char * field, size_t size)
+{
+    size_t i = 0;
+    for (i = 0; i < cache->vary_count; ++i)
+    {
+        if ((strlen(cache->vary[i]) == size) &&
+            (memcmp(cache->vary[i], field, size) == 0))
+        {
+            return ((int)i);
+        }
+    }
+    return (-1);
+}
+
+void scgi_cache_key_clear (struct scgi_cache_key * key)
+{
+    key->size = 0;
+    key->overflow = 0;
+}
+
+void scgi_cache_key_append (struct scgi_cache_key * key,
+                            const char * data, size_t size)
+{
+    if (key->overflow || (size >= (SCGI_CACHE_MAX_KEY - key->size))) {
+        key->overflow = 1;
+        return;
+    }
+    memcpy(key->data+key->size, data, size);
+    key->size += size;
+    key->data[key->size++] = '\0';
+}
+
+const struct scgi_cache_entry * scgi_cache_lookup
+    (struct scgi_cache * cache, size_t reader,
+     const struct scgi_cache_key * key)
+{
+    const uint64_t hash = scgi_cache_hash(key->data, key->size);
+    struct scgi_cache_shard *const shard = scgi_cache_shard(cache, hash);
+    struct scgi_cache_entry * entry = 0;
+    (void)reader;
+    if (key->overflow) {
+        return (0);
+    }
+    entry = __atomic_load_n(scgi_cache_bucket(cache, shard, hash),
+                            __ATOMIC_ACQUIRE);
+    for (; entry != 0; entry = __atomic_load_n(&entry->next, __ATOMIC_ACQUIRE))
+    {
+        if ((entry->hash == hash) && (entry->key_size == key->size) &&
+            (memcmp(scgi_cache_entry_key(entry), key->data, key->size) == 0))
+        {
+            /* stale entries are replaced by the next insert. */
+            if (entry->expires <= scgi_cache_now()) {
+                return (0);
+            }
+            __atomic_add_fetch(&entry->references, 1, __ATOMIC_RELAXED);
+            return (entry);
+        }
+    }
+    return (0);
+}
+
+void scgi_cache_unref (const struct scgi_cache_entry * entry)
+{
+    struct scgi_cache_entry *const self = (struct scgi_cache_entry*)entry;
+    if (__atomic_sub_fetch(&self->references, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(self);
+    }
+}
+
+/* Remove an entry from its shard (shard lock held).  Readers may still be
+   walking through it, so it is only queued for reclamation. */
+static void scgi_cache_remove (struct scgi_cache * cache,
+                               struct scgi_cache_shard * shard,
+                               struct scgi_cache_entry * entry)
+{
+    struct scgi_cache_entry ** link =
+        scgi_cache_bucket(cache, shard, entry->hash);
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    __atomic_store_n(link, entry->next, __ATOMIC_RELEASE);
+    if (entry->older != 0) {
+        entry->older->newer = entry->newer;
+    }
+    else {
+        shard->oldest = entry->newer;
+    }
+    if (entry->newer != 0) {
+        entry->newer->older = entry->older;
+    }
+    else {
+        shard->newest = entry->older;
+    }
+    shard->size -= entry->size;
+    entry->retired = __atomic_add_fetch(&cache->epoch, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&cache->lock);
+    entry->older = cache->retired;
+    __atomic_store_n(&cache->retired, entry, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+int scgi_cache_insert (struct scgi_cache * cache,
+                       const struct scgi_cache_key * key,
+                       const char * data, size_t size)
+{
+    const uint64_t hash = scgi_cache_hash(key->data, key->size);
+    struct scgi_cache_shard *const shard = scgi_cache_shard(cache, hash);
+    struct scgi_cache_entry ** bucket = scgi_cache_bucket(cache, shard, hash);
+    const size_t budget = cache->capacity / cache->shard_count;
+    struct scgi_cache_entry * entry = 0;
+    struct scgi_cache_entry * item = 0;
+    uint64_t now = 0;
+    if (key->overflow || (size > budget)) {
+        errno = E2BIG;
+        return (-1);
+    }
+    entry = (struct scgi_cache_entry*)malloc(
+        sizeof(struct scgi_cache_entry) + key->size + size);
+    if (entry == 0) {
+        errno = ENOMEM;
+        return (-1);
+    }
+    memcpy((char*)(entry+1), key->data, key->size);
+    memcpy((char*)(entry+1)+key->size, data, size);
+    entry->hash = hash;
+    entry->retired = 0;
+    entry->references = 1;
+    entry->key_size = key->size;
+    entry->size = size;
+    entry->data = (const char*)(entry+1) + key->size;
+    now = scgi_cache_now();
+    entry->expires = now + cache->ttl;
+    pthread_mutex_lock(&shard->lock);
+    for (item = *bucket; item != 0; item = item->next)
+    {
+        if ((item->hash == hash) && (item->key_size == key->size) &&
+            (memcmp(scgi_cache_entry_key(item), key->data, key->size) == 0))
+        {
+            scgi_cache_remove(cache, shard, item);
+            break;
+        }
+    }
+    /* all entries share the same TTL, so the oldest expire first. */
+    while ((shard->oldest != 0) &&
+           ((shard->oldest->expires <= now) ||
+            (shard->size + size > budget)))
+    {
+        scgi_cache_remove(cache, shard, shard->oldest);
+    }
+    entry->next = *bucket;
+    entry->older = shard->newest;
+    entry->newer = 0;
+    if (shard->newest != 0) {
+        shard->newest->newer = entry;
+    }
+    else {
+        shard->oldest = entry;
+    }
+    shard->newest = entry;
+    shard->size += size;
+    __atomic_store_n(bucket, entry, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&shard->lock);
+    return (0);
+}
+
+void scgi_cache_quiescent (struct scgi_cache * cache, size_t reader)
+{
+    struct scgi_cache_entry ** link = 0;
+    struct scgi_cache_entry * entry = 0;
+    uint64_t oldest = 0;
+    size_t i = 0;
+    __atomic_store_n(&cache->readers[reader],
+                     __atomic_load_n(&cache->epoch, __ATOMIC_SEQ_CST),
+                     __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&cache->retired, __ATOMIC_ACQUIRE) == 0) {
+        return;
+    }
+    /* readers never wait: another reader is already reclaiming. */
+    if (pthread_mutex_trylock(&cache->lock) != 0) {
+        return;
+    }
+    oldest = __atomic_load_n(&cache->readers[0], __ATOMIC_SEQ_CST);
+    for (i = 1; i < cache->reader_count; ++i)
+    {
+        const uint64_t epoch =
+            __atomic_load_n(&cache->readers[i], __ATOMIC_SEQ_CST);
+        if (epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+    /* every reader has moved on since these entries were removed. */
+    link = &cache->retired;
+    while ((entry = *link) != 0)
+    {
+        if (entry->retired > oldest) {
+            link = &entry->older;
+            continue;
+        }
+        *link = entry->older;
+        scgi_cache_unref(entry);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
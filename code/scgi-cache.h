@@ -0,0 +1,306 @@
+#ifndef _scgi_cache_h__
+#define _scgi_cache_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief In-process cache of serialized responses (UNIX only).
+ *
+ * Responses are keyed on "REQUEST_METHOD", "REQUEST_URI", "QUERY_STRING"
+ * and an optional list of "vary" headers.  The key can be built as soon as
+ * the @c finish_head callback fires, so cache hits are served before any
+ * handler runs.
+ *
+ * Lookups never take a lock.  Writers lock one of several shards, and
+ * replaced or evicted entries are reclaimed only after each reader thread
+ * has reported a quiescent state (i.e. once per iteration of its I/O loop)
+ * by calling @c scgi_cache_quiescent().  Each entry lives for a fixed time
+ * and each shard is bounded in size, evicting its oldest entries first.
+ *
+ * Functions in this module that can fail return -1 and set @c errno.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Maximum size of a cache key.
+ */
+#define SCGI_CACHE_MAX_KEY 1024
+
+/*!
+ * @brief Maximum number of "vary" headers.
+ */
+#define SCGI_CACHE_MAX_VARY 8
+
+/*!
+ * @brief Cache key, built from header values.
+ */
+struct scgi_cache_key
+{
+    /*!
+     * @private
+     * @brief Key parts, each followed by a null byte.
+     */
+    char data[SCGI_CACHE_MAX_KEY];
+
+    /*!
+     * @private
+     * @brief Size of @c data, in bytes.
+     */
+    size_t size;
+
+    /*!
+     * @public
+     * @brief Non-zero if the key is too long to be cached.
+     */
+    int overflow;
+};
+
+/*!
+ * @brief Cached response.
+ *
+ * Entries are immutable once inserted.
+ */
+struct scgi_cache_entry
+{
+    /*!
+     * @private
+     * @brief Next entry in the same hash bucket.
+     */
+    struct scgi_cache_entry * next;
+
+    /*!
+     * @private
+     * @brief Neighbours in the shard's insertion order list.
+     */
+    struct scgi_cache_entry * older;
+    struct scgi_cache_entry * newer;
+
+    /*!
+     * @private
+     * @brief Hash of the key.
+     */
+    uint64_t hash;
+
+    /*!
+     * @private
+     * @brief Expiry time, on the monotonic clock (nanoseconds).
+     */
+    uint64_t expires;
+
+    /*!
+     * @private
+     * @brief Epoch at which the entry was removed from the cache.
+     */
+    uint64_t retired;
+
+    /*!
+     * @private
+     * @brief One for the cache itself, plus one per reader holding it.
+     */
+    long references;
+
+    /*!
+     * @private
+     * @brief Size of the key, in bytes.
+     */
+    size_t key_size;
+
+    /*!
+     * @public
+     * @brief Size of the serialized response, in bytes.
+     */
+    size_t size;
+
+    /*!
+     * @public
+     * @brief Serialized response.
+     */
+    const char * data;
+};
+
+/*!
+ * @private
+ * @brief Subset of cache entries, protected by its own lock.
+ */
+struct scgi_cache_shard
+{
+    pthread_mutex_t lock;
+    struct scgi_cache_entry ** buckets;
+    struct scgi_cache_entry * oldest;
+    struct scgi_cache_entry * newest;
+    size_t size;
+};
+
+/*!
+ * @brief Response cache.
+ */
+struct scgi_cache
+{
+    /*!
+     * @public
+     * @brief Time to live of entries, in nanoseconds.
+     */
+    uint64_t ttl;
+
+    /*!
+     * @public
+     * @brief Maximum total size of cached responses, in bytes.
+     */
+    size_t capacity;
+
+    /*!
+     * @public
+     * @brief Names of headers that select between response variants.
+     *
+     * Set with @c scgi_cache_vary().
+     */
+    const char * vary[SCGI_CACHE_MAX_VARY];
+    size_t vary_count;
+
+    /*!
+     * @private
+     * @brief Entry shards.
+     */
+    struct scgi_cache_shard * shards;
+    size_t shard_count;
+    size_t bucket_count;
+
+    /*!
+     * @private
+     * @brief Reclamation epoch, incremented each time an entry is removed.
+     */
+    uint64_t epoch;
+
+    /*!
+     * @private
+     * @brief Last epoch observed by each reader in a quiescent state.
+     */
+    uint64_t * readers;
+    size_t reader_count;
+
+    /*!
+     * @private
+     * @brief Removed entries waiting for readers to move on.
+     */
+    pthread_mutex_t lock;
+    struct scgi_cache_entry * retired;
+};
+
+/*!
+ * @brief Initialize an empty cache.
+ * @param cache Cache state.
+ * @param readers Number of threads that will call @c scgi_cache_lookup().
+ * @param capacity Maximum total size of cached responses, in bytes.
+ * @param ttl Time to live of entries, in milliseconds.
+ */
+int scgi_cache_setup (struct scgi_cache * cache, size_t readers,
+                      size_t capacity, unsigned long ttl);
+
+/*!
+ * @brief Release all entries.  No other thread may use the cache.
+ */
+void scgi_cache_release (struct scgi_cache * cache);
+
+/*!
+ * @brief Register a header that selects between response variants.
+ *
+ * The name must outlive the cache.
+ */
+int scgi_cache_vary (struct scgi_cache * cache, const char * name);
+
+/*!
+ * @brief Get the position of a "vary" header in the key.
+ * @return -1 if @a field is not a "vary" header.
+ *
+ * Use this from the @c finish_value callback to decide which header values
+ * to keep for @c scgi_cache_key_append().
+ */
+int scgi_cache_vary_index (const struct scgi_cache * cache,
+                           const char * field, size_t size);
+
+/*!
+ * @brief Start building a key.
+ */
+void scgi_cache_key_clear (struct scgi_cache_key * key);
+
+/*!
+ * @brief Append a key part.
+ *
+ * Append the method, URI, query string and then each "vary" header value
+ * (empty if absent) in the order they were registered.
+ */
+void scgi_cache_key_append (struct scgi_cache_key * key,
+                            const char * data, size_t size);
+
+/*!
+ * @brief Look up a response.  Never blocks.
+ * @param cache Response cache.
+ * @param reader Index of the calling thread, less than the number of
+ *  readers passed to @c scgi_cache_setup().
+ * @param key Key built from the request's headers.
+ * @return The cached response, or null if it is not in the cache or has
+ *  expired.
+ *
+ * A non-null entry must be handed back to @c scgi_cache_unref() once the
+ * response has been sent, possibly from another thread.
+ */
+const struct scgi_cache_entry * scgi_cache_lookup
+    (struct scgi_cache * cache, size_t reader,
+     const struct scgi_cache_key * key);
+
+/*!
+ * @brief Release an entry returned by @c scgi_cache_lookup().
+ */
+void scgi_cache_unref (const struct scgi_cache_entry * entry);
+
+/*!
+ * @brief Insert or replace a response.  May be called from any thread.
+ * @param cache Response cache.
+ * @param key Key built from the request's headers.
+ * @param data Serialized response, which is copied.
+ * @param size Size of @a data, in bytes.
+ */
+int scgi_cache_insert (struct scgi_cache * cache,
+                       const struct scgi_cache_key * key,
+                       const char * data, size_t size);
+
+/*!
+ * @brief Report that a reader holds no pointer into the cache.
+ *
+ * Call this once per iteration of each reader's I/O loop.  Entries held
+ * through @c scgi_cache_lookup() remain valid until released.
+ */
+void scgi_cache_quiescent (struct scgi_cache * cache, size_t reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_cache_h__ */
@@ -0,0 +1,186 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Capture of raw SCGI traffic for offline replay (UNIX only).
+ */
+
+#include "scgi-capture.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char scgi_capture_magic[8] = "SCGICAP";
+
+static size_t scgi_capture_padding (size_t size)
+{
+    return ((8 - (size % 8)) % 8);
+}
+
+static uint64_t scgi_capture_now ()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return ((uint64_t)now.tv_sec*1000000000u + (uint64_t)now.tv_nsec);
+}
+
+int scgi_capture_open (struct scgi_capture * capture, const char * path)
+{
+    struct scgi_capture_header header;
+    struct stat status;
+    capture->file = open(path, O_WRONLY|O_CREAT|O_APPEND, 0644);
+    if (capture->file < 0) {
+        return (-1);
+    }
+    if (fstat(capture->file, &status) < 0) {
+        close(capture->file), capture->file = -1;
+        return (-1);
+    }
+    /* new file, write the header. */
+    if (status.st_size == 0)
+    {
+        memcpy(header.magic, scgi_capture_magic, sizeof(header.magic));
+        header.order = 0x01020304;
+        header.version = 1;
+        if (write(capture->file, &header, sizeof(header)) != sizeof(header))
+        {
+            close(capture->file), capture->file = -1;
+            return (-1);
+        }
+    }
+    return (0);
+}
+
+int scgi_capture_write (struct scgi_capture * capture, uint64_t connection,
+                        unsigned int flags, const char * data, size_t size)
+{
+    static const char padding[8] = { 0 };
+    struct scgi_capture_record record;
+    struct iovec vector[3];
+    ssize_t used = 0;
+    size_t total = 0;
+    record.time = scgi_capture_now();
+    record.connection = connection;
+    record.size = (uint32_t)size;
+    record.flags = flags;
+    vector[0].iov_base = &record;
+    vector[0].iov_len = sizeof(record);
+    vector[1].iov_base = (void*)data;
+    vector[1].iov_len = size;
+    vector[2].iov_base = (void*)padding;
+    vector[2].iov_len = scgi_capture_padding(size);
+    total = sizeof(record) + size + vector[2].iov_len;
+    do {
+        used = writev(capture->file, vector, 3);
+    }
+    while ((used < 0) && (errno == EINTR));
+    if (used < 0) {
+        return (-1);
+    }
+    /* the rest can't be appended without splitting the record. */
+    if ((size_t)used != total) {
+        errno = EIO;
+        return (-1);
+    }
+    return (0);
+}
+
+void scgi_capture_close (struct scgi_capture * capture)
+{
+    close(capture->file), capture->file = -1;
+}
+
+int scgi_capture_map (struct scgi_capture_reader * reader, const char * path)
+{
+    const struct scgi_capture_header * header = 0;
+    struct stat status;
+    void * data = 0;
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return (-1);
+    }
+    if (fstat(file, &status) < 0) {
+        close(file);
+        return (-1);
+    }
+    if ((size_t)status.st_size < sizeof(struct scgi_capture_header)) {
+        close(file);
+        errno = EINVAL;
+        return (-1);
+    }
+    data = mmap(0, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED) {
+        return (-1);
+    }
+    reader->data = (const char*)data;
+    reader->size = (size_t)status.st_size;
+    reader->used = sizeof(struct scgi_capture_header);
+    header = (const struct scgi_capture_header*)data;
+    if ((memcmp(header->magic, scgi_capture_magic, 8) != 0) ||
+        (header->order != 0x01020304) || (header->version != 1))
+    {
+        scgi_capture_unmap(reader);
+        errno = EINVAL;
+        return (-1);
+    }
+    return (0);
+}
+
+int scgi_capture_next (struct scgi_capture_reader * reader,
+                       const struct scgi_capture_record ** record,
+                       const char ** data)
+{
+    const struct scgi_capture_record * next = 0;
+    size_t size = 0;
+    if ((reader->size - reader->used) < sizeof(struct scgi_capture_record)) {
+        return (0);
+    }
+    next = (const struct scgi_capture_record*)(reader->data+reader->used);
+    size = sizeof(*next) + next->size + scgi_capture_padding(next->size);
+    if ((reader->size - reader->used) < size) {
+        return (0);
+    }
+    *record = next;
+    *data = reader->data + reader->used + sizeof(*next);
+    reader->used += size;
+    return (1);
+}
+
+void scgi_capture_rewind (struct scgi_capture_reader * reader)
+{
+    reader->used = sizeof(struct scgi_capture_header);
+}
+
+void scgi_capture_unmap (struct scgi_capture_reader * reader)
+{
+    munmap((void*)reader->data, reader->size);
+    reader->data = 0;
+    reader->size = 0;
+    reader->used = 0;
+}
@@ -0,0 +1,206 @@
+#ifndef _scgi_capture_h__
+#define _scgi_capture_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Capture of raw SCGI traffic for offline replay (UNIX only).
+ *
+ * A capture file starts with a @c scgi_capture_header and contains one
+ * record per read performed by the server: a @c scgi_capture_record
+ * followed by the bytes that were read, padded to a multiple of 8 bytes so
+ * that all records are aligned when the file is mapped in memory.  Records
+ * for concurrent connections are interleaved in the order the reads
+ * happened, which preserves the original fragmentation and timing.
+ *
+ * Integers are stored in the byte order of the capturing host.
+ *
+ * Functions in this module return -1 and set @c errno on failure.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Flags attached to a capture record.
+ */
+enum scgi_capture_flags
+{
+    /*!
+     * @brief First record for a connection.
+     */
+    scgi_capture_begin = 1,
+
+    /*!
+     * @brief Connection was closed.  The record holds no data.
+     */
+    scgi_capture_end = 2,
+};
+
+/*!
+ * @brief Capture file header.
+ */
+struct scgi_capture_header
+{
+    /*!
+     * @brief Always "SCGICAP" (null-terminated).
+     */
+    char magic[8];
+
+    /*!
+     * @brief Always 0x01020304, used to detect the byte order.
+     */
+    uint32_t order;
+
+    /*!
+     * @brief Format version, currently 1.
+     */
+    uint32_t version;
+};
+
+/*!
+ * @brief Capture record header, followed by @c size bytes of data.
+ */
+struct scgi_capture_record
+{
+    /*!
+     * @brief Time of the read, in nanoseconds since the UNIX epoch.
+     */
+    uint64_t time;
+
+    /*!
+     * @brief Identifier of the connection, chosen by the application.
+     */
+    uint64_t connection;
+
+    /*!
+     * @brief Number of bytes read.
+     */
+    uint32_t size;
+
+    /*!
+     * @brief Combination of @c scgi_capture_flags values.
+     */
+    uint32_t flags;
+};
+
+/*!
+ * @brief Capture file writer.
+ */
+struct scgi_capture
+{
+    /*!
+     * @private
+     * @brief File descriptor, opened in append mode.
+     */
+    int file;
+};
+
+/*!
+ * @brief Open (or create) a capture file for appending.
+ */
+int scgi_capture_open (struct scgi_capture * capture, const char * path);
+
+/*!
+ * @brief Append a record for data read from a connection.
+ * @param capture Capture file.
+ * @param connection Identifier of the connection.
+ * @param flags Combination of @c scgi_capture_flags values.
+ * @param data Data that was read, may be null when @a size is 0.
+ * @param size Size of @a data, in bytes.
+ *
+ * Each record is written with a single system call, so several threads may
+ * share a capture file.  Fails with @c EIO when the record is only partly
+ * written (e.g. when the disk is full): the records that follow could not
+ * be read back, so the capture should be closed.
+ */
+int scgi_capture_write (struct scgi_capture * capture, uint64_t connection,
+                        unsigned int flags, const char * data, size_t size);
+
+/*!
+ * @brief Close the capture file.
+ */
+void scgi_capture_close (struct scgi_capture * capture);
+
+/*!
+ * @brief Capture file reader, over a memory-mapped file.
+ */
+struct scgi_capture_reader
+{
+    /*!
+     * @private
+     * @brief Mapped file contents.
+     */
+    const char * data;
+
+    /*!
+     * @private
+     * @brief Size of @c data, in bytes.
+     */
+    size_t size;
+
+    /*!
+     * @private
+     * @brief Offset of the next record.
+     */
+    size_t used;
+};
+
+/*!
+ * @brief Map a capture file in memory.
+ */
+int scgi_capture_map (struct scgi_capture_reader * reader, const char * path);
+
+/*!
+ * @brief Get the next record.
+ * @param reader Capture file reader.
+ * @param record Receives a pointer to the record header.
+ * @param data Receives a pointer to the record data.
+ * @return 0 when all records have been read, else non-zero.
+ *
+ * A truncated record at the end of the file (e.g. if the capturing process
+ * crashed) is ignored.
+ */
+int scgi_capture_next (struct scgi_capture_reader * reader,
+                       const struct scgi_capture_record ** record,
+                       const char ** data);
+
+/*!
+ * @brief Restart from the first record.
+ */
+void scgi_capture_rewind (struct scgi_capture_reader * reader);
+
+/*!
+ * @brief Unmap the capture file.
+ */
+void scgi_capture_unmap (struct scgi_capture_reader * reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_capture_h__ */
@@ -0,0 +1,689 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Bridge to CGI programs (UNIX only).
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE /* splice(), pipe2() */
+#endif
+
+#include "scgi-cgi.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#if defined(__linux__)
+# include <sys/syscall.h>
+#endif
+
+#ifndef PATH_MAX
+# define PATH_MAX 4096
+#endif
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+#ifndef MSG_DONTWAIT
+# define MSG_DONTWAIT 0
+#endif
+
+/* Message boundaries, and end-of-file when the server exits. */
+#if defined(__linux__) || defined(__FreeBSD__)
+# define SCGI_CGI_CONTROL SOCK_SEQPACKET
+#else
+# define SCGI_CGI_CONTROL SOCK_DGRAM
+#endif
+
+/* Largest transfer in a single system call. */
+#define SCGI_CGI_CHUNK (64*1024)
+
+/* Upper bound on the number of variables in a head. */
+static size_t scgi_cgi_count (const char * head, size_t size,
+                              const char *const * extra)
+{
+    const char * end = head + size;
+    const char * next = 0;
+    size_t count = 0;
+    while ((next = (const char*)memchr(head, '\0', end-head)) != 0)
+    {
+        head = next + 1;
+        ++count;
+    }
+    count /= 2;
+    while (extra && *extra++) {
+        ++count;
+    }
+    return (count);
+}
+
+ssize_t scgi_cgi_environ_into (char * head, size_t size,
+                               const char *const * extra,
+                               char ** variables, size_t capacity)
+{
+    char *const end = head + size;
+    char * name = head;
+    char * equal = 0;
+    char * next = 0;
+    size_t count = 0;
+    if (scgi_cgi_count(head, size, extra) >= capacity) {
+        errno = ENOBUFS;
+        return (-1);
+    }
+    while (name < end)
+    {
+        equal = (char*)memchr(name, '\0', end-name);
+        if (equal == 0) {
+            break;
+        }
+        next = (char*)memchr(equal+1, '\0', end-(equal+1));
+        if (next == 0) {
+            break;
+        }
+        /* "NAME\0VALUE\0" becomes "NAME=VALUE\0". */
+        if ((equal > name) && (memchr(name, '=', equal-name) == 0)) {
+            *equal = '=';
+            variables[count++] = name;
+        }
+        name = next + 1;
+    }
+    while (extra && *extra) {
+        variables[count++] = (char*)*extra++;
+    }
+    variables[count] = 0;
+    return ((ssize_t)count);
+}
+
+char ** scgi_cgi_environ (char * head, size_t size,
+                          const char *const * extra)
+{
+    const size_t capacity = scgi_cgi_count(head, size, extra) + 1;
+    char ** variables = (char**)malloc(capacity*sizeof(char*));
+    if (variables == 0) {
+        errno = ENOMEM;
+        return (0);
+    }
+    scgi_cgi_environ_into(head, size, extra, variables, capacity);
+    return (variables);
+}
+
+/* Both ends are closed in child processes, except when duplicated. */
+static int scgi_cgi_pipe (int ends[2])
+{
+#if defined(__linux__)
+    return (pipe2(ends, O_CLOEXEC));
+#else
+    if (pipe(ends) == -1) {
+        return (-1);
+    }
+    fcntl(ends[0], F_SETFD, FD_CLOEXEC);
+    fcntl(ends[1], F_SETFD, FD_CLOEXEC);
+    return (0);
+#endif
+}
+
+int scgi_cgi_spawn (struct scgi_cgi_child * child, const char * path,
+                    char *const * argv, char *const * envp)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributes;
+    sigset_t signals;
+    short flags = POSIX_SPAWN_SETSIGDEF|POSIX_SPAWN_SETSIGMASK;
+    int input[2];
+    int output[2];
+    int result = 0;
+    if (scgi_cgi_pipe(input) == -1) {
+        return (-1);
+    }
+    if (scgi_cgi_pipe(output) == -1) {
+        close(input[0]), close(input[1]);
+        return (-1);
+    }
+#if defined(POSIX_SPAWN_USEVFORK)
+    flags |= POSIX_SPAWN_USEVFORK;
+#endif
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, input[0], 0);
+    posix_spawn_file_actions_adddup2(&actions, output[1], 1);
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, flags);
+    /* Servers ignore SIGPIPE, CGI programs expect to be killed by it. */
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attributes, &signals);
+    sigaddset(&signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attributes, &signals);
+    result = posix_spawn(&child->pid, path, &actions, &attributes,
+                         argv, envp);
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    close(input[0]), close(output[1]);
+    if (result != 0) {
+        close(input[1]), close(output[0]);
+        errno = result;
+        return (-1);
+    }
+    child->input = input[1];
+    child->output = output[0];
+    return (0);
+}
+
+/* Move up to size bytes without copying them, 0 at end of file.  Fails
+   with EINVAL when the descriptors do not support it. */
+static ssize_t scgi_cgi_splice (int from, int to, size_t size)
+{
+#if defined(__linux__)
+    if (size > SCGI_CGI_CHUNK) {
+        size = SCGI_CGI_CHUNK;
+    }
+    return (splice(from, 0, to, 0, size, SPLICE_F_MOVE|SPLICE_F_NONBLOCK));
+#else
+    (void)from;
+    (void)to;
+    (void)size;
+    errno = EINVAL;
+    return (-1);
+#endif
+}
+
+static void scgi_cgi_nonblocking (int stream)
+{
+    const int flags = fcntl(stream, F_GETFL);
+    if (flags != -1) {
+        fcntl(stream, F_SETFL, flags|O_NONBLOCK);
+    }
+}
+
+static void scgi_cgi_close (int * stream)
+{
+    if (*stream != -1) {
+        close(*stream), *stream = -1;
+    }
+}
+
+int scgi_cgi_relay (struct scgi_cgi_child * child, int socket,
+                    const char * body, size_t size, size_t remaining)
+{
+    struct pollfd events[3];
+    /* Without splice(), data is copied through these buffers.  Each is
+       only refilled once the destination has taken all of its data. */
+    char upload_buffer[PIPE_BUF];
+    char download_buffer[PIPE_BUF];
+    const char * download = download_buffer;
+    size_t pending = 0;
+    ssize_t used = 0;
+    /* After EAGAIN from splice(), wait for the destination instead of the
+       source. */
+    int upload_blocked = 0;
+    int download_blocked = 0;
+    /* Set once splice() is known not to work for a direction. */
+    int upload_copy = 0;
+    int download_copy = 0;
+    int upload = 0;
+    int ready = 0;
+    /* Both pipes belong to us, the program has its own ends. */
+    scgi_cgi_nonblocking(child->input);
+    scgi_cgi_nonblocking(child->output);
+    if ((size == 0) && (remaining == 0)) {
+        scgi_cgi_close(&child->input);
+    }
+    while ((child->output != -1) || (pending > 0))
+    {
+        upload = (child->input != -1);
+        events[0].events = 0;
+        if (upload && (size == 0) && !upload_blocked) {
+            events[0].events |= POLLIN;
+        }
+        if (download_blocked || (pending > 0)) {
+            events[0].events |= POLLOUT;
+        }
+        events[1].events = 0;
+        if (upload && ((size > 0) || upload_blocked)) {
+            events[1].events = POLLOUT;
+        }
+        events[2].events = 0;
+        if ((child->output != -1) && !download_blocked && (pending == 0)) {
+            events[2].events = POLLIN;
+        }
+        /* Unwatched descriptors would still report POLLHUP and POLLERR. */
+        events[0].fd = (events[0].events != 0)? socket : -1;
+        events[1].fd = (events[1].events != 0)? child->input : -1;
+        events[2].fd = (events[2].events != 0)? child->output : -1;
+        events[0].revents = 0;
+        events[1].revents = 0;
+        events[2].revents = 0;
+        if (poll(events, 3, -1) == -1)
+        {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (-1);
+        }
+
+        /* Request body, from the buffer then from the socket. */
+        used = -1;
+        errno = EAGAIN;
+        if (upload && (size > 0) && (events[1].revents != 0))
+        {
+            used = write(child->input, body, size < PIPE_BUF? size : PIPE_BUF);
+            if (used > 0) {
+                body += used;
+                size -= used;
+            }
+        }
+        else if (upload && (size == 0) &&
+                 (((events[0].revents & ~POLLOUT) != 0) ||
+                  (upload_blocked && (events[1].revents != 0))))
+        {
+            if (!upload_copy) {
+                used = scgi_cgi_splice(socket, child->input, remaining);
+                upload_copy = (used == -1) && (errno == EINVAL);
+                upload_blocked = (used == -1) && (errno == EAGAIN) &&
+                    (events[1].revents == 0);
+            }
+            if (upload_copy)
+            {
+                /* Buffer the data, it is sent once the pipe has room. */
+                if (remaining < sizeof(upload_buffer)) {
+                    used = read(socket, upload_buffer, remaining);
+                }
+                else {
+                    used = read(socket, upload_buffer, sizeof(upload_buffer));
+                }
+                if (used > 0) {
+                    body = upload_buffer;
+                    size = used;
+                }
+            }
+            if (used > 0) {
+                remaining -= used;
+            }
+        }
+        if (upload && (used == -1) && (errno == EPIPE))
+        {
+            /* Program does not want the rest of its input. */
+            size = 0;
+            remaining = 0;
+        }
+        else if ((used == -1) && (errno != EAGAIN) && (errno != EINTR)) {
+            return (-1);
+        }
+        if (used == 0)
+        {
+            /* Client closed its end. */
+            size = 0;
+            remaining = 0;
+        }
+        if (upload && (size == 0) && (remaining == 0)) {
+            scgi_cgi_close(&child->input);
+        }
+
+        /* Response, from the program to the socket. */
+        if (pending > 0)
+        {
+            if ((events[0].revents & ~POLLIN) == 0) {
+                continue;
+            }
+            used = send(socket, download, pending, MSG_DONTWAIT|MSG_NOSIGNAL);
+            if (used > 0) {
+                download += used;
+                pending -= used;
+            }
+            else if ((errno != EAGAIN) && (errno != EINTR)) {
+                return (-1);
+            }
+            continue;
+        }
+        ready = download_blocked?
+            (events[0].revents & ~POLLIN) != 0 : events[2].revents != 0;
+        if (!ready) {
+            continue;
+        }
+        used = -1;
+        if (!download_copy) {
+            used = scgi_cgi_splice(child->output, socket, SCGI_CGI_CHUNK);
+            download_copy = (used == -1) && (errno == EINVAL);
+        }
+        if (download_copy)
+        {
+            used = read(child->output, download_buffer,
+                        sizeof(download_buffer));
+            if (used > 0) {
+                download = download_buffer;
+                pending = used;
+            }
+        }
+        if (used == 0) {
+            scgi_cgi_close(&child->output);
+        }
+        else if (used > 0) {
+            download_blocked = 0;
+        }
+        else if (errno == EAGAIN) {
+            /* Either end may be the one that is not ready. */
+            download_blocked = !download_copy && !download_blocked;
+        }
+        else if (errno != EINTR) {
+            return (-1);
+        }
+    }
+    scgi_cgi_close(&child->input);
+    return (0);
+}
+
+int scgi_cgi_wait (struct scgi_cgi_child * child, int * status)
+{
+    int result = 0;
+    scgi_cgi_close(&child->input);
+    scgi_cgi_close(&child->output);
+    while (waitpid(child->pid, &result, 0) == -1)
+    {
+        if (errno != EINTR) {
+            return (-1);
+        }
+    }
+    if (status != 0) {
+        *status = result;
+    }
+    return (0);
+}
+
+/* Close all descriptors inherited from the server, except the standard
+   streams and keep.  Workers may be forked while connections are open, and
+   must not hold them open: clients wait for the server to close them. */
+static void scgi_cgi_isolate (int keep)
+{
+    long limit = 0;
+    int stream = 0;
+#if defined(__linux__) && defined(SYS_close_range)
+    if (((keep <= 3) || (syscall(SYS_close_range, 3, keep-1, 0) == 0)) &&
+        (syscall(SYS_close_range, keep+1, ~0U, 0) == 0))
+    {
+        return;
+    }
+#endif
+    limit = sysconf(_SC_OPEN_MAX);
+    if (limit < 0) {
+        limit = 1024;
+    }
+    for (stream = 3; stream < limit; ++stream)
+    {
+        if (stream != keep) {
+            close(stream);
+        }
+    }
+}
+
+/* Runs in a pre-forked process, until it replaces itself. */
+static void scgi_cgi_worker (const struct scgi_cgi_pool * pool, int control)
+{
+    union {
+        struct cmsghdr header;
+        char data[CMSG_SPACE(2*sizeof(int))];
+    } ancillary;
+    struct msghdr message;
+    struct iovec vector;
+    struct cmsghdr * header = 0;
+    struct sigaction action;
+    char * arguments[2];
+    char * head = 0;
+    int streams[2];
+    ssize_t size = 0;
+    scgi_cgi_isolate(control);
+    vector.iov_base = pool->message;
+    vector.iov_len = pool->capacity;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = ancillary.data;
+    message.msg_controllen = sizeof(ancillary.data);
+    do {
+        size = recvmsg(control, &message, 0);
+    }
+    while ((size == -1) && (errno == EINTR));
+    if (size <= 0) {
+        _exit(0);
+    }
+    header = CMSG_FIRSTHDR(&message);
+    if ((header == 0) || (header->cmsg_type != SCM_RIGHTS) ||
+        (header->cmsg_len != CMSG_LEN(2*sizeof(int))))
+    {
+        _exit(127);
+    }
+    memcpy(streams, CMSG_DATA(header), sizeof(streams));
+    head = (char*)memchr(pool->message, '\0', size);
+    if ((head == 0) || (scgi_cgi_environ_into
+        (head+1, size-(head+1-pool->message), pool->extra,
+         pool->variables, pool->variable_capacity) == -1))
+    {
+        _exit(127);
+    }
+    if ((dup2(streams[0], 0) == -1) || (dup2(streams[1], 1) == -1)) {
+        _exit(127);
+    }
+    if (streams[0] > 1) {
+        close(streams[0]);
+    }
+    if (streams[1] > 1) {
+        close(streams[1]);
+    }
+    /* Same signal state as scgi_cgi_spawn() gives. */
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = SIG_DFL;
+    sigaction(SIGPIPE, &action, 0);
+    sigprocmask(SIG_SETMASK, &action.sa_mask, 0);
+    arguments[0] = pool->message;
+    arguments[1] = 0;
+    execve(pool->message, arguments, pool->variables);
+    _exit(127);
+}
+
+int scgi_cgi_pool_refill (struct scgi_cgi_pool * pool)
+{
+    const int size = (int)pool->capacity + 1024;
+    int pair[2];
+    pid_t worker = 0;
+    size_t i = 0;
+    for (i = 0; i < pool->count; ++i)
+    {
+        if (pool->controls[i] != -1) {
+            continue;
+        }
+        if (socketpair(AF_UNIX, SCGI_CGI_CONTROL, 0, pair) == -1) {
+            return (-1);
+        }
+        fcntl(pair[0], F_SETFD, FD_CLOEXEC);
+        fcntl(pair[1], F_SETFD, FD_CLOEXEC);
+        setsockopt(pair[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        setsockopt(pair[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        worker = fork();
+        if (worker == -1) {
+            close(pair[0]), close(pair[1]);
+            return (-1);
+        }
+        if (worker == 0) {
+            close(pair[0]);
+            scgi_cgi_worker(pool, pair[1]);
+        }
+        close(pair[1]);
+        pool->controls[i] = pair[0];
+        pool->workers[i] = worker;
+    }
+    return (0);
+}
+
+int scgi_cgi_pool_setup (struct scgi_cgi_pool * pool, size_t count,
+                         size_t max_head_size, const char *const * extra)
+{
+    size_t i = 0;
+    memset(pool, 0, sizeof(*pool));
+    pool->count = count;
+    pool->extra = extra;
+    pool->capacity = PATH_MAX + max_head_size;
+    pool->variable_capacity = scgi_cgi_count("", 0, extra) +
+        max_head_size/2 + 1;
+    pool->controls = (int*)malloc(count*sizeof(int));
+    pool->workers = (pid_t*)malloc(count*sizeof(pid_t));
+    pool->message = (char*)malloc(pool->capacity);
+    pool->variables = (char**)malloc(
+        pool->variable_capacity*sizeof(char*));
+    if ((pool->controls == 0) || (pool->workers == 0) ||
+        (pool->message == 0) || (pool->variables == 0))
+    {
+        scgi_cgi_pool_release(pool);
+        errno = ENOMEM;
+        return (-1);
+    }
+    for (i = 0; i < count; ++i) {
+        pool->controls[i] = -1;
+    }
+    if (scgi_cgi_pool_refill(pool) == -1) {
+        const int error = errno;
+        scgi_cgi_pool_release(pool);
+        errno = error;
+        return (-1);
+    }
+    return (0);
+}
+
+void scgi_cgi_pool_release (struct scgi_cgi_pool * pool)
+{
+    size_t i = 0;
+    for (i = 0; (pool->controls != 0) && (i < pool->count); ++i)
+    {
+        if (pool->controls[i] == -1) {
+            continue;
+        }
+        /* An empty message stops the worker. */
+        send(pool->controls[i], "", 0, MSG_NOSIGNAL);
+        close(pool->controls[i]);
+        while ((waitpid(pool->workers[i], 0, 0) == -1) && (errno == EINTR)) {
+        }
+    }
+    free(pool->controls);
+    free(pool->workers);
+    free(pool->message);
+    free(pool->variables);
+    memset(pool, 0, sizeof(*pool));
+}
+
+/* Hand the head and pipe ends to a worker. */
+static int scgi_cgi_pool_send (int control, const char * path,
+                               const char * head, size_t size,
+                               int input, int output)
+{
+    union {
+        struct cmsghdr header;
+        char data[CMSG_SPACE(2*sizeof(int))];
+    } ancillary;
+    struct msghdr message;
+    struct iovec vectors[2];
+    struct cmsghdr * header = 0;
+    int streams[2];
+    ssize_t used = 0;
+    streams[0] = input;
+    streams[1] = output;
+    vectors[0].iov_base = (char*)path;
+    vectors[0].iov_len = strlen(path) + 1;
+    vectors[1].iov_base = (char*)head;
+    vectors[1].iov_len = size;
+    memset(&message, 0, sizeof(message));
+    memset(&ancillary, 0, sizeof(ancillary));
+    message.msg_iov = vectors;
+    message.msg_iovlen = 2;
+    message.msg_control = ancillary.data;
+    message.msg_controllen = sizeof(ancillary.data);
+    header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(streams));
+    memcpy(CMSG_DATA(header), streams, sizeof(streams));
+    do {
+        used = sendmsg(control, &message, MSG_NOSIGNAL);
+    }
+    while ((used == -1) && (errno == EINTR));
+    return (used == -1? -1 : 0);
+}
+
+int scgi_cgi_pool_spawn (struct scgi_cgi_pool * pool,
+                         struct scgi_cgi_child * child, const char * path,
+                         char * head, size_t size)
+{
+    char * arguments[2];
+    char ** variables = 0;
+    int input[2];
+    int output[2];
+    int result = 0;
+    size_t i = 0;
+    if (strlen(path) + 1 + size <= pool->capacity)
+    {
+        for (i = 0; i < pool->count; ++i)
+        {
+            if (pool->controls[i] == -1) {
+                continue;
+            }
+            if (scgi_cgi_pipe(input) == -1) {
+                return (-1);
+            }
+            if (scgi_cgi_pipe(output) == -1) {
+                close(input[0]), close(input[1]);
+                return (-1);
+            }
+            result = scgi_cgi_pool_send(pool->controls[i], path, head, size,
+                                        input[0], output[1]);
+            close(input[0]), close(output[1]);
+            /* Either way, this worker will not take another request. */
+            close(pool->controls[i]), pool->controls[i] = -1;
+            if (result == 0) {
+                child->pid = pool->workers[i];
+                child->input = input[1];
+                child->output = output[0];
+                return (0);
+            }
+            close(input[1]), close(output[0]);
+            while ((waitpid(pool->workers[i], 0, 0) == -1) &&
+                   (errno == EINTR))
+            {
+            }
+        }
+    }
+    variables = scgi_cgi_environ(head, size, pool->extra);
+    if (variables == 0) {
+        return (-1);
+    }
+    arguments[0] = (char*)path;
+    arguments[1] = 0;
+    result = scgi_cgi_spawn(child, path, arguments, variables);
+    free(variables);
+    return (result);
+}
@@ -0,0 +1,220 @@
+#ifndef _scgi_cgi_h__
+#define _scgi_cgi_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Bridge to CGI programs (UNIX only).
+ *
+ * An SCGI head is a sequence of "NAME\0VALUE\0" pairs.  Replacing the null
+ * byte after each name with "=" turns it into "NAME=VALUE\0", so the
+ * environment of a CGI program is built over the received head without
+ * copying a single header: @c scgi_cgi_environ() only allocates the array
+ * of pointers.
+ *
+ * The program is started with @c posix_spawn(), with pipes for its
+ * standard input and output.  @c scgi_cgi_relay() then moves the rest of
+ * the request body from the connection to the program, and its output
+ * (CGI responses are also SCGI responses) back to the connection, with
+ * @c splice() on Linux so data never goes through user space.
+ *
+ * A pool of pre-forked workers keeps @c fork() off the request path: each
+ * worker waits for a head, builds the environment and replaces itself with
+ * the CGI program.
+ *
+ * Functions in this module that can fail return -1 and set @c errno.
+ */
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Running CGI program.
+ */
+struct scgi_cgi_child
+{
+    /*!
+     * @public
+     * @brief Process identifier.
+     */
+    pid_t pid;
+
+    /*!
+     * @public
+     * @brief Pipe to the program's standard input, -1 once closed.
+     */
+    int input;
+
+    /*!
+     * @public
+     * @brief Pipe from the program's standard output, -1 once closed.
+     */
+    int output;
+};
+
+/*!
+ * @brief Pre-forked workers that start CGI programs.
+ */
+struct scgi_cgi_pool
+{
+    /*!
+     * @private
+     * @brief Control socket of each worker, -1 for empty slots.
+     */
+    int * controls;
+
+    /*!
+     * @private
+     * @brief Process identifier of each worker.
+     */
+    pid_t * workers;
+    size_t count;
+
+    /*!
+     * @private
+     * @brief Variables added to each environment.
+     */
+    const char *const * extra;
+
+    /*!
+     * @private
+     * @brief Buffers used by workers, allocated before forking.
+     */
+    char * message;
+    size_t capacity;
+    char ** variables;
+    size_t variable_capacity;
+};
+
+/*!
+ * @brief Build a CGI environment over an SCGI head, in place.
+ * @param head Contents of the head netstring, which are modified.
+ * @param size Size of @a head, in bytes.
+ * @param extra Null-terminated list of "NAME=VALUE" strings to add (e.g.
+ *  "GATEWAY_INTERFACE=CGI/1.1"), may be null.
+ * @return A null-terminated array to pass to @c scgi_cgi_spawn(), to be
+ *  released with @c free().  Pointers refer to @a head and @a extra.
+ *
+ * Headers with an empty name or a name containing "=" are left out.
+ */
+char ** scgi_cgi_environ (char * head, size_t size,
+                          const char *const * extra);
+
+/*!
+ * @brief Same as @c scgi_cgi_environ(), without allocating.
+ * @param variables Receives the array.
+ * @param capacity Number of items in @a variables, including the final
+ *  null.
+ * @return Number of variables, or -1 if @a capacity is too small.
+ */
+ssize_t scgi_cgi_environ_into (char * head, size_t size,
+                               const char *const * extra,
+                               char ** variables, size_t capacity);
+
+/*!
+ * @brief Start a CGI program with pipes for its input and output.
+ * @param child Receives the process identifier and pipes.
+ * @param path Path of the program.
+ * @param argv Null-terminated arguments, starting with the program name.
+ * @param envp Environment, usually from @c scgi_cgi_environ().
+ */
+int scgi_cgi_spawn (struct scgi_cgi_child * child, const char * path,
+                    char *const * argv, char *const * envp);
+
+/*!
+ * @brief Move the request body to the program and its response back.
+ * @param child Running program.
+ * @param socket Connection to the client.
+ * @param body Part of the body already read from @a socket, may be null.
+ * @param size Size of @a body, in bytes.
+ * @param remaining Size of the body still in @a socket, in bytes.
+ * @return 0 once the program has closed its output.
+ *
+ * Both directions progress at the same time, so programs may respond
+ * before reading their whole input.  The program's input is closed once
+ * the body has been sent.  Works with blocking and non-blocking sockets;
+ * the pipes are switched to non-blocking mode.
+ */
+int scgi_cgi_relay (struct scgi_cgi_child * child, int socket,
+                    const char * body, size_t size, size_t remaining);
+
+/*!
+ * @brief Close the pipes and wait for the program to exit.
+ * @param child Program.
+ * @param status Receives the exit status, as for @c waitpid().  May be
+ *  null.
+ */
+int scgi_cgi_wait (struct scgi_cgi_child * child, int * status);
+
+/*!
+ * @brief Start pre-forked workers.
+ * @param pool Worker pool.
+ * @param count Number of workers.
+ * @param max_head_size Largest head that will be handed to a worker.
+ * @param extra Variables added to each environment, must outlive the pool.
+ *
+ * Workers are forked from the calling process and never allocate memory,
+ * so they may be started after other threads.  The server should ignore
+ * @c SIGPIPE; programs get the default handler back.
+ */
+int scgi_cgi_pool_setup (struct scgi_cgi_pool * pool, size_t count,
+                         size_t max_head_size, const char *const * extra);
+
+/*!
+ * @brief Stop idle workers.
+ */
+void scgi_cgi_pool_release (struct scgi_cgi_pool * pool);
+
+/*!
+ * @brief Replace workers that started a program.
+ *
+ * Call this when idle, to keep @c fork() off the request path.  New
+ * workers close all descriptors but the standard streams, so connections
+ * and programs that are open at the time are not held open.
+ */
+int scgi_cgi_pool_refill (struct scgi_cgi_pool * pool);
+
+/*!
+ * @brief Start a CGI program in an idle worker.
+ * @param pool Worker pool.
+ * @param child Receives the process identifier and pipes.
+ * @param path Path of the program, which gets no arguments.
+ * @param head Contents of the head netstring.
+ * @param size Size of @a head, in bytes.
+ *
+ * Without an idle worker, the environment is built over @a head and the
+ * program is started with @c scgi_cgi_spawn().
+ */
+int scgi_cgi_pool_spawn (struct scgi_cgi_pool * pool,
+                         struct scgi_cgi_child * child, const char * path,
+                         char * head, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_cgi_h__ */
@@ -0,0 +1,222 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Coalescing of identical concurrent requests (UNIX only).
+ */
+
+#include "scgi-coalesce.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Requests in flight for one key, followed by the key itself. */
+struct scgi_coalesce_flight
+{
+    struct scgi_coalesce_flight * next;
+    struct scgi_coalesce_waiter * leader;
+    struct scgi_coalesce_waiter * waiters;
+    struct scgi_coalesce_waiter ** tail;
+    uint64_t hash;
+    size_t key_size;
+};
+
+/* FNV-1a. */
+static uint64_t scgi_coalesce_hash (const char * data, size_t size)
+{
+    uint64_t hash = 14695981039346656037u;
+    size_t i;
+    for (i = 0; i < size; ++i) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211u;
+    }
+    return (hash);
+}
+
+static struct scgi_coalesce_flight ** scgi_coalesce_bucket
+    (struct scgi_coalesce * coalesce, uint64_t hash)
+{
+    return (&coalesce->buckets[hash & (coalesce->bucket_count-1)]);
+}
+
+int scgi_coalesce_setup (struct scgi_coalesce * coalesce, size_t buckets)
+{
+    size_t count = 1;
+    while (count < buckets) {
+        count *= 2;
+    }
+    coalesce->coalesced = 0;
+    coalesce->bucket_count = count;
+    coalesce->buckets = calloc(count, sizeof(struct scgi_coalesce_flight*));
+    if (coalesce->buckets == 0) {
+        errno = ENOMEM;
+        return (-1);
+    }
+    if (pthread_mutex_init(&coalesce->lock, 0) != 0) {
+        free(coalesce->buckets), coalesce->buckets = 0;
+        errno = ENOMEM;
+        return (-1);
+    }
+    return (0);
+}
+
+void scgi_coalesce_release (struct scgi_coalesce * coalesce)
+{
+    struct scgi_coalesce_flight * flight;
+    size_t i;
+    for (i = 0; i < coalesce->bucket_count; ++i)
+    {
+        while ((flight = coalesce->buckets[i]) != 0) {
+            coalesce->buckets[i] = flight->next, free(flight);
+        }
+    }
+    pthread_mutex_destroy(&coalesce->lock);
+    free(coalesce->buckets), coalesce->buckets = 0;
+}
+
+int scgi_coalesce_is_method (const char * method, size_t size)
+{
+    return (((size == 3) && (memcmp(method, "GET", 3) == 0)) ||
+            ((size == 4) && (memcmp(method, "HEAD", 4) == 0)));
+}
+
+int scgi_coalesce_join (struct scgi_coalesce * coalesce,
+                        const struct scgi_cache_key * key,
+                        struct scgi_coalesce_waiter * waiter)
+{
+    const uint64_t hash = scgi_coalesce_hash(key->data, key->size);
+    struct scgi_coalesce_flight ** bucket;
+    struct scgi_coalesce_flight * flight;
+    if (key->overflow) {
+        errno = ENAMETOOLONG;
+        return (-1);
+    }
+    waiter->next = 0;
+    pthread_mutex_lock(&coalesce->lock);
+    bucket = scgi_coalesce_bucket(coalesce, hash);
+    for (flight = *bucket; flight != 0; flight = flight->next)
+    {
+        if ((flight->hash == hash) && (flight->key_size == key->size) &&
+            (memcmp(flight+1, key->data, key->size) == 0))
+        {
+            /* Wait in order of arrival. */
+            waiter->flight = flight;
+            *flight->tail = waiter, flight->tail = &waiter->next;
+            ++coalesce->coalesced;
+            pthread_mutex_unlock(&coalesce->lock);
+            return (0);
+        }
+    }
+    flight = malloc(sizeof(struct scgi_coalesce_flight) + key->size);
+    if (flight == 0) {
+        pthread_mutex_unlock(&coalesce->lock);
+        errno = ENOMEM;
+        return (-1);
+    }
+    flight->leader = waiter;
+    flight->waiters = 0;
+    flight->tail = &flight->waiters;
+    flight->hash = hash;
+    flight->key_size = key->size;
+    memcpy(flight+1, key->data, key->size);
+    flight->next = *bucket, *bucket = flight;
+    waiter->flight = flight;
+    pthread_mutex_unlock(&coalesce->lock);
+    return (1);
+}
+
+void scgi_coalesce_finish (struct scgi_coalesce * coalesce,
+                           struct scgi_coalesce_waiter * leader,
+                           const char * data, size_t size)
+{
+    struct scgi_coalesce_response * response = 0;
+    struct scgi_coalesce_flight ** link;
+    struct scgi_coalesce_flight * flight;
+    struct scgi_coalesce_waiter * waiter;
+    struct scgi_coalesce_waiter * next;
+    long count = 0;
+    pthread_mutex_lock(&coalesce->lock);
+    flight = leader->flight;
+    if ((flight == 0) || (flight->leader != leader)) {
+        pthread_mutex_unlock(&coalesce->lock);
+        return;
+    }
+    link = scgi_coalesce_bucket(coalesce, flight->hash);
+    while (*link != flight) {
+        link = &(*link)->next;
+    }
+    *link = flight->next;
+    for (waiter = flight->waiters; waiter != 0; waiter = waiter->next) {
+        waiter->flight = 0, ++count;
+    }
+    leader->flight = 0;
+    pthread_mutex_unlock(&coalesce->lock);
+
+    /* One copy, shared by all waiters. */
+    if ((count > 0) && (data != 0))
+    {
+        response = malloc(sizeof(struct scgi_coalesce_response) + size);
+        if (response != 0) {
+            response->references = count;
+            response->size = size;
+            response->data = memcpy(response+1, data, size);
+        }
+    }
+    for (waiter = flight->waiters; waiter != 0; waiter = next) {
+        next = waiter->next, waiter->next = 0;
+        waiter->deliver(waiter, response);
+    }
+    free(flight);
+}
+
+int scgi_coalesce_leave (struct scgi_coalesce * coalesce,
+                         struct scgi_coalesce_waiter * waiter)
+{
+    struct scgi_coalesce_waiter ** link;
+    struct scgi_coalesce_flight * flight;
+    pthread_mutex_lock(&coalesce->lock);
+    flight = waiter->flight;
+    if ((flight == 0) || (flight->leader == waiter)) {
+        pthread_mutex_unlock(&coalesce->lock);
+        errno = EINVAL;
+        return (-1);
+    }
+    link = &flight->waiters;
+    while (*link != waiter) {
+        link = &(*link)->next;
+    }
+    if ((*link = waiter->next) == 0) {
+        flight->tail = link;
+    }
+    waiter->flight = 0, waiter->next = 0;
+    pthread_mutex_unlock(&coalesce->lock);
+    return (0);
+}
+
+void scgi_coalesce_unref (const struct scgi_coalesce_response * response)
+{
+    struct scgi_coalesce_response *const shared =
+        (struct scgi_coalesce_response*)response;
+    if (__atomic_sub_fetch(&shared->references, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(shared);
+    }
+}
@@ -0,0 +1,199 @@
+#ifndef _scgi_coalesce_h__
+#define _scgi_coalesce_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Coalescing of identical concurrent requests (UNIX only).
+ *
+ * During a burst of cache misses, identical requests would each run the
+ * same handler.  Once the @c finish_head callback has fired, build the
+ * request's key with @c scgi_cache_key_append() and join the flight for
+ * that key: the first request becomes the leader and runs the handler,
+ * later identical requests wait.  When the leader finishes, its serialized
+ * response is copied once and handed to each waiter.
+ *
+ * Only coalesce requests that have no side effects and no body, i.e. GET
+ * and HEAD requests.
+ *
+ * Functions in this module that can fail return -1 and set @c errno.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "scgi-cache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct scgi_coalesce_flight;
+
+/*!
+ * @brief Response shared by all requests of a flight.
+ */
+struct scgi_coalesce_response
+{
+    /*!
+     * @private
+     * @brief One per waiter holding the response.
+     */
+    long references;
+
+    /*!
+     * @public
+     * @brief Size of the serialized response, in bytes.
+     */
+    size_t size;
+
+    /*!
+     * @public
+     * @brief Serialized response.
+     */
+    const char * data;
+};
+
+/*!
+ * @brief Request taking part in a flight, embedded in connection state.
+ */
+struct scgi_coalesce_waiter
+{
+    /*!
+     * @public
+     * @brief Called with the leader's response.
+     *
+     * Called from the thread that calls @c scgi_coalesce_finish(), with a
+     * null response if the leader gave up: the request must then be
+     * handled on its own.  Otherwise, hand the response back to
+     * @c scgi_coalesce_unref() once it has been sent.
+     */
+    void(*deliver)(struct scgi_coalesce_waiter*,
+                   const struct scgi_coalesce_response*);
+
+    /*!
+     * @public
+     * @brief Extra field for use by the application.
+     */
+    void * object;
+
+    /*!
+     * @private
+     * @brief Flight this request leads or waits for, null once finished.
+     */
+    struct scgi_coalesce_flight * flight;
+
+    /*!
+     * @private
+     * @brief Next waiter of the same flight.
+     */
+    struct scgi_coalesce_waiter * next;
+};
+
+/*!
+ * @brief Requests in flight, by key.
+ */
+struct scgi_coalesce
+{
+    /*!
+     * @public
+     * @brief Number of requests that waited instead of running a handler.
+     */
+    uint64_t coalesced;
+
+    /*!
+     * @private
+     * @brief Flights, by hash of their key.
+     */
+    pthread_mutex_t lock;
+    struct scgi_coalesce_flight ** buckets;
+    size_t bucket_count;
+};
+
+/*!
+ * @brief Initialize an empty table of flights.
+ * @param coalesce Table state.
+ * @param buckets Expected number of distinct keys in flight at once.
+ */
+int scgi_coalesce_setup (struct scgi_coalesce * coalesce, size_t buckets);
+
+/*!
+ * @brief Release the table.  No request may be in flight.
+ */
+void scgi_coalesce_release (struct scgi_coalesce * coalesce);
+
+/*!
+ * @brief Check if requests with a given method may be coalesced.
+ */
+int scgi_coalesce_is_method (const char * method, size_t size);
+
+/*!
+ * @brief Lead or wait for the flight of a key.
+ * @param coalesce Table of flights.
+ * @param key Key built from the request's headers.
+ * @param waiter Request state, with @c deliver set.
+ * @return 1 if the request leads the flight and must run the handler, 0
+ *  if it waits for the leader's response, -1 if it cannot be coalesced
+ *  (e.g. the key overflowed) and must run the handler on its own.
+ */
+int scgi_coalesce_join (struct scgi_coalesce * coalesce,
+                        const struct scgi_cache_key * key,
+                        struct scgi_coalesce_waiter * waiter);
+
+/*!
+ * @brief Close a flight and hand its response to all waiters.
+ * @param coalesce Table of flights.
+ * @param leader Request that joined first.  Does nothing for requests that
+ *  do not lead a flight.
+ * @param data Serialized response, which is copied.  Null if the handler
+ *  failed: waiters then run their own handler.
+ * @param size Size of @a data, in bytes.
+ *
+ * Waiters are called after the flight is closed, so a request with the
+ * same key that arrives meanwhile starts a new flight.
+ */
+void scgi_coalesce_finish (struct scgi_coalesce * coalesce,
+                           struct scgi_coalesce_waiter * leader,
+                           const char * data, size_t size);
+
+/*!
+ * @brief Stop waiting, e.g. when the client goes away.
+ * @return 0 if the request no longer waits, -1 if the flight is over (the
+ *  @c deliver callback has been or is about to be called).
+ *
+ * Leaders must call @c scgi_coalesce_finish() instead.
+ */
+int scgi_coalesce_leave (struct scgi_coalesce * coalesce,
+                         struct scgi_coalesce_waiter * waiter);
+
+/*!
+ * @brief Release a response handed to a waiter.
+ */
+void scgi_coalesce_unref (const struct scgi_coalesce_response * response);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_coalesce_h__ */
@@ -0,0 +1,182 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Compact parser for servers with many idle connections.
+ */
+
+#include "scgi-compact.h"
+#include <string.h>
+
+static size_t scgi_compact_min (size_t lhs, size_t rhs)
+{
+    return ((lhs < rhs)? lhs : rhs);
+}
+
+void scgi_compact_setup (struct scgi_compact * parser,
+                         const struct scgi_limits * limits,
+                         const struct scgi_compact_callbacks * callbacks,
+                         void * object)
+{
+    parser->limits = limits;
+    parser->callbacks = callbacks;
+    parser->object = object;
+    scgi_compact_clear(parser);
+}
+
+void scgi_compact_clear (struct scgi_compact * parser)
+{
+    parser->used = 0;
+    parser->head_size = 0;
+    parser->state = scgi_compact_start;
+    parser->error = scgi_error_ok;
+}
+
+size_t scgi_compact_body_size (const struct scgi_compact * parser)
+{
+    return ((parser->state == scgi_compact_body)? parser->used : 0);
+}
+
+/* netstring prefix, one byte at a time. */
+static void scgi_compact_prefix (struct scgi_compact * parser, char c)
+{
+    const size_t limit = parser->limits->max_head_size;
+    if ((c == ':') && (parser->state != scgi_compact_start))
+    {
+        parser->state = (parser->head_size == 0)?
+            scgi_compact_comma : scgi_compact_field;
+        return;
+    }
+    if ((c < '0') || (c > '9') || (parser->state == scgi_compact_zero)) {
+        parser->error = scgi_error_head_syntax;
+        return;
+    }
+    if ((parser->head_size > (UINT32_MAX-9)/10) ||
+        ((limit != 0) && (parser->head_size*10u + (c-'0') > limit)))
+    {
+        parser->error = scgi_error_head_overflow;
+        return;
+    }
+    parser->head_size = parser->head_size*10u + (uint32_t)(c-'0');
+    parser->state = (parser->head_size == 0)?
+        scgi_compact_zero : scgi_compact_size;
+}
+
+/* header names and values, up to the end of the head. */
+static size_t scgi_compact_head (struct scgi_compact * parser,
+                                 const char * data, size_t size)
+{
+    const struct scgi_compact_callbacks *const callbacks =
+        parser->callbacks;
+    const char * stop = 0;
+    size_t used = 0;
+    size_t peek = 0;
+    size = scgi_compact_min(size, parser->head_size - parser->used);
+    while (used < size)
+    {
+        stop = (const char*)memchr(data+used, '\0', size-used);
+        peek = (stop == 0)? size-used : (size_t)(stop-(data+used));
+        if (peek > 0)
+        {
+            if (parser->state == scgi_compact_field) {
+                callbacks->accept_field(parser, data+used, peek);
+            }
+            else {
+                callbacks->accept_value(parser, data+used, peek);
+            }
+            used += peek;
+        }
+        if (stop != 0)
+        {
+            ++used;
+            if (parser->state == scgi_compact_field)
+            {
+                parser->state = scgi_compact_value;
+                if (callbacks->finish_field) {
+                    callbacks->finish_field(parser);
+                }
+            }
+            else
+            {
+                parser->state = scgi_compact_field;
+                if (callbacks->finish_value) {
+                    callbacks->finish_value(parser);
+                }
+            }
+        }
+    }
+    parser->used += used;
+    if (parser->used == parser->head_size) {
+        parser->state = scgi_compact_comma;
+    }
+    return (used);
+}
+
+size_t scgi_compact_consume (struct scgi_compact * parser,
+                             const char * data, size_t size)
+{
+    const size_t limit = parser->limits->max_body_size;
+    size_t used = 0;
+    size_t pass = 0;
+    while ((used < size) && (parser->error == scgi_error_ok) &&
+           (parser->state != scgi_compact_body))
+    {
+        switch (parser->state)
+        {
+        case scgi_compact_start:
+        case scgi_compact_zero:
+        case scgi_compact_size:
+            scgi_compact_prefix(parser, data[used++]);
+            break;
+        case scgi_compact_field:
+        case scgi_compact_value:
+            used += scgi_compact_head(parser, data+used, size-used);
+            break;
+        case scgi_compact_comma:
+            if (data[used++] != ',') {
+                parser->error = scgi_error_head_syntax;
+                break;
+            }
+            parser->state = scgi_compact_body;
+            parser->used = 0;
+            parser->callbacks->finish_head(parser);
+            break;
+        }
+    }
+    if ((parser->state != scgi_compact_body) ||
+        (parser->error != scgi_error_ok) || (used == size))
+    {
+        return (used);
+    }
+    /* grab as much data as we possibly can without exceeding limits. */
+    pass = size-used;
+    if (limit > 0) {
+        pass = scgi_compact_min(pass, limit-parser->used);
+    }
+    pass = parser->callbacks->accept_body(parser, data+used, pass);
+    used += pass, parser->used += pass;
+    if ((used < size) && (limit > 0) && (parser->used == limit)) {
+        parser->error = scgi_error_body_overflow;
+    }
+    return (used);
+}
@@ -0,0 +1,197 @@
+#ifndef _scgi_compact_h__
+#define _scgi_compact_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Compact parser for servers with many idle connections.
+ *
+ * @c scgi_parser keeps its own copies of the limits, its callbacks and a
+ * complete netstring parser, which adds up with tens of thousands of open
+ * connections.  This parser references limits and callbacks shared by all
+ * connections, packs its state and error in single bytes and keeps only
+ * the counters needed to resume parsing: it is 5 words on 64-bit systems.
+ *
+ * Callbacks are invoked the same way as by @c scgi_consume(), except that
+ * they are never passed empty data.  Strict mode, @c scgi_next() and
+ * tracing are only available with @c scgi_parser.
+ */
+
+#include "scgi.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct scgi_compact;
+
+/*!
+ * @brief Parser states, stored in @c scgi_compact::state.
+ */
+enum scgi_compact_state
+{
+    /*!
+     * @private
+     * @brief Expecting the first digit of the head size.
+     */
+    scgi_compact_start,
+
+    /*!
+     * @private
+     * @brief Head size is "0", expecting the colon.
+     */
+    scgi_compact_zero,
+
+    /*!
+     * @private
+     * @brief Parsing the head size.
+     */
+    scgi_compact_size,
+
+    /*!
+     * @private
+     * @brief Parsing a header name.
+     */
+    scgi_compact_field,
+
+    /*!
+     * @private
+     * @brief Parsing a header value.
+     */
+    scgi_compact_value,
+
+    /*!
+     * @private
+     * @brief Expecting the comma after the head.
+     */
+    scgi_compact_comma,
+
+    /*!
+     * @brief Head has been parsed, streaming body.
+     */
+    scgi_compact_body,
+};
+
+/*!
+ * @brief Callbacks shared by all parsers of a server.
+ *
+ * See @c scgi_parser for details.  @c finish_field and @c finish_value may
+ * be null.
+ */
+struct scgi_compact_callbacks
+{
+    void(*accept_field)(struct scgi_compact*, const char *, size_t);
+    void(*finish_field)(struct scgi_compact*);
+    void(*accept_value)(struct scgi_compact*, const char *, size_t);
+    void(*finish_value)(struct scgi_compact*);
+    void(*finish_head)(struct scgi_compact*);
+    size_t(*accept_body)(struct scgi_compact*, const char *, size_t);
+};
+
+/*!
+ * @brief Compact SCGI request parser state.
+ */
+struct scgi_compact
+{
+    /*!
+     * @private
+     * @brief Limits shared by all parsers, must outlive the parser.
+     */
+    const struct scgi_limits * limits;
+
+    /*!
+     * @private
+     * @brief Callbacks shared by all parsers, must outlive the parser.
+     */
+    const struct scgi_compact_callbacks * callbacks;
+
+    /*!
+     * @public
+     * @brief Extra field for client code's use.
+     */
+    void * object;
+
+    /*!
+     * @private
+     * @brief Head bytes parsed, then body bytes accepted.
+     *
+     * Use @c scgi_compact_body_size() to get the size of the body.
+     */
+    size_t used;
+
+    /*!
+     * @private
+     * @brief Size of the head, as announced by the netstring prefix.
+     */
+    uint32_t head_size;
+
+    /*!
+     * @public
+     * @brief Current state, from @c scgi_compact_state.  Read-only.
+     */
+    unsigned char state;
+
+    /*!
+     * @public
+     * @brief Last error, from @c scgi_parser_error.  Read-only.
+     */
+    unsigned char error;
+};
+
+/*!
+ * @brief Initialize a parser.
+ * @param parser Parser state.
+ * @param limits Limits shared by all parsers.
+ * @param callbacks Callbacks shared by all parsers.
+ * @param object Extra field for client code's use.
+ */
+void scgi_compact_setup (struct scgi_compact * parser,
+                         const struct scgi_limits * limits,
+                         const struct scgi_compact_callbacks * callbacks,
+                         void * object);
+
+/*!
+ * @brief Prepare to parse another request on the same connection.
+ */
+void scgi_compact_clear (struct scgi_compact * parser);
+
+/*!
+ * @brief Feed data to the parser.
+ * @return Amount of data processed, in bytes.
+ *
+ * Check the @c error field after each call.
+ */
+size_t scgi_compact_consume (struct scgi_compact * parser,
+                             const char * data, size_t size);
+
+/*!
+ * @brief Get the size of the body processed so far, in bytes.
+ */
+size_t scgi_compact_body_size (const struct scgi_compact * parser);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_compact_h__ */
@@ -0,0 +1,345 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Streaming compression of response bodies (requires zlib).
+ */
+
+#include "scgi-deflate.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* zlib's default memory level. */
+#define SCGI_DEFLATE_MEMORY 8
+
+static int scgi_deflate_lower (int c)
+{
+    return (((c >= 'A') && (c <= 'Z'))? c-'A'+'a' : c);
+}
+
+static int scgi_deflate_is_space (int c)
+{
+    return ((c == ' ') || (c == '\t'));
+}
+
+static int scgi_deflate_match (const char * data, size_t size,
+                               const char * name)
+{
+    size_t i = 0;
+    for (i = 0; i < size; ++i)
+    {
+        if ((name[i] == '\0') || (scgi_deflate_lower(data[i]) != name[i])) {
+            return (0);
+        }
+    }
+    return (name[size] == '\0');
+}
+
+/* quality value of a list item's parameters, in thousandths. */
+static int scgi_deflate_quality (const char * data, size_t size)
+{
+    size_t i = 0;
+    int quality = 0;
+    int scale = 1000;
+    /* skip to the "q" parameter, if any. */
+    while ((size > 0) && (scgi_deflate_is_space(*data) || (*data == ';')))
+    {
+        ++data, --size;
+    }
+    if ((size < 2) || (scgi_deflate_lower(data[0]) != 'q') ||
+        (data[1] != '='))
+    {
+        return (1000);
+    }
+    data += 2, size -= 2;
+    if ((size == 0) || (data[0] < '0') || (data[0] > '1')) {
+        return (0);
+    }
+    quality = (data[0] - '0') * 1000;
+    if ((size > 1) && (data[1] == '.'))
+    {
+        for (i = 2; (i < size) && (i < 5); ++i)
+        {
+            if ((data[i] < '0') || (data[i] > '9')) {
+                break;
+            }
+            scale /= 10;
+            quality += (data[i] - '0') * scale;
+        }
+    }
+    return ((quality > 1000)? 1000 : quality);
+}
+
+enum scgi_deflate_encoding scgi_deflate_negotiate
+    (const char * value, size_t size)
+{
+    const char *const end = value + size;
+    const char * item = value;
+    const char * name = 0;
+    int gzip = -1;
+    int deflate = -1;
+    int other = -1;
+    int quality = 0;
+    while (item < end)
+    {
+        const char * stop = item;
+        size_t length = 0;
+        while ((stop < end) && (*stop != ',')) {
+            ++stop;
+        }
+        while ((item < stop) && scgi_deflate_is_space(*item)) {
+            ++item;
+        }
+        name = item;
+        while ((item < stop) && (*item != ';') &&
+               !scgi_deflate_is_space(*item))
+        {
+            ++item;
+        }
+        length = item - name;
+        quality = scgi_deflate_quality(item, stop-item);
+        if (scgi_deflate_match(name, length, "gzip") ||
+            scgi_deflate_match(name, length, "x-gzip"))
+        {
+            gzip = quality;
+        }
+        else if (scgi_deflate_match(name, length, "deflate")) {
+            deflate = quality;
+        }
+        else if (scgi_deflate_match(name, length, "*")) {
+            other = quality;
+        }
+        item = stop + 1;
+    }
+    /* "*" covers codings that are not listed. */
+    if (gzip < 0) {
+        gzip = other;
+    }
+    if (deflate < 0) {
+        deflate = other;
+    }
+    if ((gzip > 0) && (gzip >= deflate)) {
+        return (scgi_deflate_gzip);
+    }
+    if (deflate > 0) {
+        return (scgi_deflate_deflate);
+    }
+    return (scgi_deflate_identity);
+}
+
+const char * scgi_deflate_name (enum scgi_deflate_encoding encoding)
+{
+    switch (encoding)
+    {
+    case scgi_deflate_gzip:
+        return ("gzip");
+    case scgi_deflate_deflate:
+        return ("deflate");
+    default:
+        return (0);
+    }
+}
+
+void scgi_deflate_setup (struct scgi_deflate * state, int level)
+{
+    memset(state, 0, sizeof(*state));
+    state->level = level;
+    state->encoding = scgi_deflate_identity;
+}
+
+void scgi_deflate_release (struct scgi_deflate * state)
+{
+    int i = 0;
+    for (i = 0; i < 2; ++i)
+    {
+        if (state->ready & (1 << i)) {
+            deflateEnd(&state->streams[i]);
+        }
+    }
+    state->ready = 0;
+}
+
+/* get a stream for a compressed coding, reset for a new body. */
+static z_stream * scgi_deflate_stream (struct scgi_deflate * state,
+                                       enum scgi_deflate_encoding encoding)
+{
+    const int index = (encoding == scgi_deflate_gzip)? 0 : 1;
+    z_stream *const stream = &state->streams[index];
+    int status = Z_OK;
+    if (state->ready & (1 << index))
+    {
+        /* the level may have changed since the last body. */
+        if ((deflateReset(stream) != Z_OK) ||
+            (deflateParams(stream, state->level,
+                           Z_DEFAULT_STRATEGY) != Z_OK))
+        {
+            errno = EINVAL;
+            return (0);
+        }
+        return (stream);
+    }
+    memset(stream, 0, sizeof(*stream));
+    /* "deflate" is the zlib format; gzip needs 16 more window bits. */
+    status = deflateInit2(stream, state->level, Z_DEFLATED,
+                          (encoding == scgi_deflate_gzip)? 15+16 : 15,
+                          SCGI_DEFLATE_MEMORY, Z_DEFAULT_STRATEGY);
+    if (status != Z_OK) {
+        errno = (status == Z_MEM_ERROR)? ENOMEM : EINVAL;
+        return (0);
+    }
+    state->ready |= (1 << index);
+    return (stream);
+}
+
+int scgi_deflate_start (struct scgi_deflate * state,
+                        enum scgi_deflate_encoding encoding,
+                        scgi_deflate_sink sink, void * object)
+{
+    state->encoding = scgi_deflate_identity;
+    state->sink = sink;
+    state->object = object;
+    if ((encoding != scgi_deflate_identity) &&
+        (scgi_deflate_stream(state, encoding) == 0))
+    {
+        return (-1);
+    }
+    state->encoding = encoding;
+    return (0);
+}
+
+static int scgi_deflate_pump (struct scgi_deflate * state,
+                              const char * data, size_t size, int flush)
+{
+    z_stream *const stream =
+        &state->streams[(state->encoding == scgi_deflate_gzip)? 0 : 1];
+    size_t used = 0;
+    int status = Z_OK;
+    if (state->encoding == scgi_deflate_identity)
+    {
+        if (size == 0) {
+            return (0);
+        }
+        return (state->sink(state->object, data, size));
+    }
+    stream->next_in = (Bytef*)data;
+    stream->avail_in = (uInt)size;
+    do {
+        stream->next_out = (Bytef*)state->buffer;
+        stream->avail_out = SCGI_DEFLATE_CHUNK;
+        status = deflate(stream, flush);
+        if (status == Z_STREAM_ERROR) {
+            errno = EINVAL;
+            return (-1);
+        }
+        used = SCGI_DEFLATE_CHUNK - stream->avail_out;
+        if ((used > 0) &&
+            (state->sink(state->object, state->buffer, used) < 0))
+        {
+            return (-1);
+        }
+    }
+    while (stream->avail_out == 0);
+    return (0);
+}
+
+int scgi_deflate_write (struct scgi_deflate * state,
+                        const char * data, size_t size)
+{
+    /* zlib counts input in "uInt". */
+    const size_t limit = (size_t)1 << 30;
+    while (size > limit)
+    {
+        if (scgi_deflate_pump(state, data, limit, Z_NO_FLUSH) < 0) {
+            return (-1);
+        }
+        data += limit, size -= limit;
+    }
+    return (scgi_deflate_pump(state, data, size, Z_NO_FLUSH));
+}
+
+int scgi_deflate_flush (struct scgi_deflate * state)
+{
+    return (scgi_deflate_pump(state, 0, 0, Z_SYNC_FLUSH));
+}
+
+int scgi_deflate_finish (struct scgi_deflate * state)
+{
+    return (scgi_deflate_pump(state, 0, 0, Z_FINISH));
+}
+
+#if !defined(_WIN32)
+
+const struct scgi_cache_entry * scgi_deflate_cached
+    (struct scgi_cache * cache, size_t reader,
+     const struct scgi_cache_key * key, struct scgi_deflate * state,
+     enum scgi_deflate_encoding encoding, const char * data, size_t size)
+{
+    const char *const name = scgi_deflate_name(encoding);
+    const struct scgi_cache_entry * entry = 0;
+    struct scgi_cache_key variant;
+    z_stream * stream = 0;
+    char * output = 0;
+    size_t capacity = 0;
+    int status = Z_OK;
+    if ((name == 0) || (size > ((size_t)1 << 30))) {
+        errno = EINVAL;
+        return (0);
+    }
+    memcpy(&variant, key, sizeof(variant));
+    scgi_cache_key_append(&variant, name, strlen(name));
+    entry = scgi_cache_lookup(cache, reader, &variant);
+    if ((entry != 0) || variant.overflow) {
+        return (entry);
+    }
+    /* miss: compress the whole body in one pass. */
+    stream = scgi_deflate_stream(state, encoding);
+    if (stream == 0) {
+        return (0);
+    }
+    capacity = deflateBound(stream, (uLong)size);
+    output = (char*)malloc(capacity);
+    if (output == 0) {
+        errno = ENOMEM;
+        return (0);
+    }
+    stream->next_in = (Bytef*)data;
+    stream->avail_in = (uInt)size;
+    stream->next_out = (Bytef*)output;
+    stream->avail_out = (uInt)capacity;
+    status = deflate(stream, Z_FINISH);
+    if (status != Z_STREAM_END) {
+        free(output);
+        errno = EINVAL;
+        return (0);
+    }
+    status = scgi_cache_insert(cache, &variant,
+                               output, capacity-stream->avail_out);
+    free(output);
+    if (status < 0) {
+        return (0);
+    }
+    return (scgi_cache_lookup(cache, reader, &variant));
+}
+
+#endif
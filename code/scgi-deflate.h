@@ -0,0 +1,219 @@
+#ifndef _scgi_deflate_h__
+#define _scgi_deflate_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Streaming compression of response bodies (requires zlib).
+ *
+ * The content coding is chosen from the "HTTP_ACCEPT_ENCODING" request
+ * header with @c scgi_deflate_negotiate(), typically from the
+ * @c finish_value callback.  The body is then compressed in chunks of
+ * @c SCGI_DEFLATE_CHUNK bytes, which are handed to a sink as they fill up.
+ *
+ * Compressor state is expensive to create, so keep one
+ * @c scgi_deflate object per thread and reuse it for each response: zlib's
+ * buffers are allocated on first use and only reset afterwards.
+ *
+ * Bodies that are served many times (e.g. static assets) should be
+ * compressed only once with @c scgi_deflate_cached(), which keeps each
+ * compressed variant in a response cache.
+ *
+ * Functions in this module that can fail return -1 and set @c errno.
+ */
+
+#include <stddef.h>
+#include <zlib.h>
+
+#if !defined(_WIN32)
+# include "scgi-cache.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Size of compressed chunks handed to the sink, in bytes.
+ */
+#define SCGI_DEFLATE_CHUNK 16384
+
+/*!
+ * @brief Content codings.
+ */
+enum scgi_deflate_encoding
+{
+    scgi_deflate_identity,
+    scgi_deflate_gzip,
+    scgi_deflate_deflate
+};
+
+/*!
+ * @brief Receives compressed output.
+ * @return -1 to abort, after setting @c errno.
+ */
+typedef int(*scgi_deflate_sink)(void*,const char*,size_t);
+
+/*!
+ * @brief Per-thread compressor state.
+ */
+struct scgi_deflate
+{
+    /*!
+     * @public
+     * @brief Compression level, from 1 (fastest) to 9 (smallest).
+     */
+    int level;
+
+    /*!
+     * @public
+     * @brief Content coding of the current response.
+     */
+    enum scgi_deflate_encoding encoding;
+
+    /*!
+     * @public
+     * @brief Destination of the current response's output.
+     */
+    scgi_deflate_sink sink;
+
+    /*!
+     * @public
+     * @brief Application defined data passed to the sink.
+     */
+    void * object;
+
+    /*!
+     * @private
+     * @brief zlib streams, one per compressed coding.
+     */
+    z_stream streams[2];
+
+    /*!
+     * @private
+     * @brief Bit mask of initialized streams.
+     */
+    int ready;
+
+    /*!
+     * @private
+     * @brief Output buffer.
+     */
+    char buffer[SCGI_DEFLATE_CHUNK];
+};
+
+/*!
+ * @brief Pick a content coding.
+ * @param value Value of the "HTTP_ACCEPT_ENCODING" header.
+ * @param size Size of @a value, in bytes.
+ * @return The coding with the highest quality value, with "gzip" winning
+ *  ties.  @c scgi_deflate_identity when neither coding is acceptable.
+ */
+enum scgi_deflate_encoding scgi_deflate_negotiate
+    (const char * value, size_t size);
+
+/*!
+ * @brief Get the name of a content coding, for "Content-Encoding".
+ * @return Null for @c scgi_deflate_identity.
+ */
+const char * scgi_deflate_name (enum scgi_deflate_encoding encoding);
+
+/*!
+ * @brief Initialize compressor state.  No memory is allocated yet.
+ * @param state Compressor state.
+ * @param level Compression level, from 1 (fastest) to 9 (smallest).
+ */
+void scgi_deflate_setup (struct scgi_deflate * state, int level);
+
+/*!
+ * @brief Release memory held by zlib.
+ */
+void scgi_deflate_release (struct scgi_deflate * state);
+
+/*!
+ * @brief Start a new response body.
+ * @param state Compressor state.
+ * @param encoding Content coding, usually from @c scgi_deflate_negotiate().
+ * @param sink Destination of compressed output.
+ * @param object Application defined data passed to @a sink.
+ *
+ * With @c scgi_deflate_identity, data is passed to the sink unchanged.
+ */
+int scgi_deflate_start (struct scgi_deflate * state,
+                        enum scgi_deflate_encoding encoding,
+                        scgi_deflate_sink sink, void * object);
+
+/*!
+ * @brief Compress part of the response body.
+ *
+ * Output is handed to the sink only once a full chunk is available.
+ */
+int scgi_deflate_write (struct scgi_deflate * state,
+                        const char * data, size_t size);
+
+/*!
+ * @brief Hand all pending output to the sink.
+ *
+ * Use this before waiting for more of the body (e.g. streamed events).
+ * Flushing often hurts the compression ratio.
+ */
+int scgi_deflate_flush (struct scgi_deflate * state);
+
+/*!
+ * @brief End the response body and hand remaining output to the sink.
+ */
+int scgi_deflate_finish (struct scgi_deflate * state);
+
+#if !defined(_WIN32)
+
+/*!
+ * @brief Get a compressed variant of a body, compressing it on a miss.
+ * @param cache Cache holding compressed variants.
+ * @param reader Index of the calling thread, as for
+ *  @c scgi_cache_lookup().
+ * @param key Key identifying the body, such as its path and modification
+ *  time.  The coding's name is added to the key.
+ * @param state Compressor state of the calling thread.
+ * @param encoding Content coding, other than @c scgi_deflate_identity.
+ * @param data Uncompressed body.
+ * @param size Size of @a data, in bytes.
+ * @return The compressed body, to be released with @c scgi_cache_unref().
+ *  Null if it cannot be cached, in which case the streaming functions
+ *  should be used instead.
+ *
+ * Threads that miss at the same time each compress the body, and the last
+ * one replaces the others' variant.  @a state must not be in the middle of
+ * a response.
+ */
+const struct scgi_cache_entry * scgi_deflate_cached
+    (struct scgi_cache * cache, size_t reader,
+     const struct scgi_cache_key * key, struct scgi_deflate * state,
+     enum scgi_deflate_encoding encoding, const char * data, size_t size);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_deflate_h__ */
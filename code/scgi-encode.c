@@ -0,0 +1,182 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Encoder for Simple Common Gateway Interface (SCGI) requests.
+ */
+
+#include "scgi-encode.h"
+#include <string.h>
+
+static const char scgi_encode_content_length[] = "CONTENT_LENGTH";
+static const char scgi_encode_scgi[] = "SCGI\0" "1";
+
+static size_t scgi_encode_digits (size_t value)
+{
+    size_t digits = 1;
+    while (value >= 10) {
+        value /= 10, ++digits;
+    }
+    return (digits);
+}
+
+static char * scgi_encode_number (size_t value, char * buffer)
+{
+    const size_t digits = scgi_encode_digits(value);
+    size_t i = digits;
+    do {
+        buffer[--i] = (char)('0' + (value % 10)), value /= 10;
+    }
+    while (i > 0);
+    return (buffer+digits);
+}
+
+static size_t scgi_encode_pairs_size
+    (const struct scgi_header * headers, size_t count)
+{
+    size_t size = 0;
+    size_t i = 0;
+    for (i = 0; i < count; ++i) {
+        size += headers[i].name_size + headers[i].value_size + 2;
+    }
+    return (size);
+}
+
+/* Size of the netstring payload. */
+static size_t scgi_encode_payload_size
+    (size_t pairs_size, size_t body_size)
+{
+    return (sizeof(scgi_encode_content_length)
+            + scgi_encode_digits(body_size) + 1
+            + sizeof(scgi_encode_scgi)
+            + pairs_size);
+}
+
+/* Write the netstring length and the mandatory headers. */
+static char * scgi_encode_prefix
+    (size_t payload_size, size_t body_size, char * buffer)
+{
+    buffer = scgi_encode_number(payload_size, buffer);
+    *buffer++ = ':';
+    memcpy(buffer, scgi_encode_content_length,
+           sizeof(scgi_encode_content_length));
+    buffer += sizeof(scgi_encode_content_length);
+    buffer = scgi_encode_number(body_size, buffer);
+    *buffer++ = '\0';
+    memcpy(buffer, scgi_encode_scgi, sizeof(scgi_encode_scgi));
+    return (buffer + sizeof(scgi_encode_scgi));
+}
+
+static char * scgi_encode_write
+    (const struct scgi_header * headers, size_t count, char * buffer)
+{
+    size_t i = 0;
+    for (i = 0; i < count; ++i)
+    {
+        memcpy(buffer, headers[i].name, headers[i].name_size);
+        buffer += headers[i].name_size;
+        *buffer++ = '\0';
+        memcpy(buffer, headers[i].value, headers[i].value_size);
+        buffer += headers[i].value_size;
+        *buffer++ = '\0';
+    }
+    return (buffer);
+}
+
+size_t scgi_encode_pairs (const struct scgi_header * headers, size_t count,
+                          char * buffer, size_t size)
+{
+    const size_t used = scgi_encode_pairs_size(headers, count);
+    if (used <= size) {
+        scgi_encode_write(headers, count, buffer);
+    }
+    return (used);
+}
+
+size_t scgi_encode_head (const char * fixed, size_t fixed_size,
+                         const struct scgi_header * headers, size_t count,
+                         size_t body_size, char * buffer, size_t size)
+{
+    const size_t payload_size = scgi_encode_payload_size(
+        fixed_size + scgi_encode_pairs_size(headers, count), body_size);
+    const size_t used = scgi_encode_digits(payload_size) + 1
+        + payload_size + 1;
+    if (used > size) {
+        return (used);
+    }
+    buffer = scgi_encode_prefix(payload_size, body_size, buffer);
+    if (fixed_size > 0) {
+        memcpy(buffer, fixed, fixed_size), buffer += fixed_size;
+    }
+    buffer = scgi_encode_write(headers, count, buffer);
+    *buffer = ',';
+    return (used);
+}
+
+#if !defined(_WIN32)
+
+static void scgi_encode_chunk (struct iovec * vector, size_t * used,
+                               const char * data, size_t size)
+{
+    vector[*used].iov_base = (void*)data;
+    vector[*used].iov_len = size;
+    ++*used;
+}
+
+size_t scgi_encode_iovec (const char * fixed, size_t fixed_size,
+                          const struct scgi_header * headers, size_t count,
+                          const char * body, size_t body_size,
+                          char * prefix, struct iovec * vector,
+                          size_t capacity)
+{
+    static const char separator[] = "";
+    static const char terminator[] = ",";
+    const size_t payload_size = scgi_encode_payload_size(
+        fixed_size + scgi_encode_pairs_size(headers, count), body_size);
+    size_t used = 0;
+    size_t i = 0;
+    if (capacity < (4*count + 4)) {
+        return (0);
+    }
+    scgi_encode_chunk(vector, &used, prefix, (size_t)(
+        scgi_encode_prefix(payload_size, body_size, prefix) - prefix));
+    if (fixed_size > 0) {
+        scgi_encode_chunk(vector, &used, fixed, fixed_size);
+    }
+    for (i = 0; i < count; ++i)
+    {
+        scgi_encode_chunk(vector, &used,
+                          headers[i].name, headers[i].name_size);
+        scgi_encode_chunk(vector, &used, separator, 1);
+        scgi_encode_chunk(vector, &used,
+                          headers[i].value, headers[i].value_size);
+        scgi_encode_chunk(vector, &used, separator, 1);
+    }
+    scgi_encode_chunk(vector, &used, terminator, 1);
+    if (body_size > 0) {
+        scgi_encode_chunk(vector, &used, body, body_size);
+    }
+    return (used);
+}
+
+#endif
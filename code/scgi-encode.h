@@ -0,0 +1,128 @@
+#ifndef _scgi_encode_h__
+#define _scgi_encode_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Encoder for Simple Common Gateway Interface (SCGI) requests.
+ *
+ * The encoder always starts the head with the "CONTENT_LENGTH" and "SCGI"
+ * headers, as required by the protocol, so they must not be part of the
+ * headers supplied by the application.  Other headers are written in the
+ * order in which they are supplied.  Headers that are identical for all
+ * requests can be encoded once with @c scgi_encode_pairs() and passed as a
+ * template for each request.
+ */
+
+#include <stddef.h>
+
+#if !defined(_WIN32)
+# include <sys/uio.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Maximum size of the prefix written by @c scgi_encode_iovec().
+ */
+#define SCGI_ENCODE_PREFIX_SIZE 64
+
+/*!
+ * @brief Name and value of a request header.
+ *
+ * Strings need not be null-terminated.
+ */
+struct scgi_header
+{
+    const char * name;
+    size_t name_size;
+    const char * value;
+    size_t value_size;
+};
+
+/*!
+ * @brief Encode headers as a sequence of name/value pairs.
+ * @param headers Array of headers.
+ * @param count Number of items in @a headers.
+ * @param buffer Output buffer.
+ * @param size Size of @a buffer, in bytes.
+ * @return Size of encoded pairs, in bytes.  If larger than @a size, nothing
+ *  is written.
+ *
+ * Use this to build a template for headers shared by many requests.
+ */
+size_t scgi_encode_pairs (const struct scgi_header * headers, size_t count,
+                          char * buffer, size_t size);
+
+/*!
+ * @brief Encode a complete request head.
+ * @param fixed Template of pre-encoded pairs, may be null.
+ * @param fixed_size Size of @a fixed, in bytes.
+ * @param headers Array of headers specific to this request.
+ * @param count Number of items in @a headers.
+ * @param body_size Size of the request body, in bytes.
+ * @param buffer Output buffer.
+ * @param size Size of @a buffer, in bytes.
+ * @return Size of the head, including netstring delimiters, in bytes.  If
+ *  larger than @a size, nothing is written.
+ *
+ * The body is not written.  It should be sent right after the head.
+ */
+size_t scgi_encode_head (const char * fixed, size_t fixed_size,
+                         const struct scgi_header * headers, size_t count,
+                         size_t body_size, char * buffer, size_t size);
+
+#if !defined(_WIN32)
+
+/*!
+ * @brief Describe a complete request for gathered output.
+ * @param fixed Template of pre-encoded pairs, may be null.
+ * @param fixed_size Size of @a fixed, in bytes.
+ * @param headers Array of headers specific to this request.
+ * @param count Number of items in @a headers.
+ * @param body Request body.
+ * @param body_size Size of @a body, in bytes.
+ * @param prefix Scratch buffer of @c SCGI_ENCODE_PREFIX_SIZE bytes, which
+ *  must outlive @a vector.
+ * @param vector Output I/O vector, suitable for @c writev().
+ * @param capacity Number of items in @a vector.
+ * @return Number of items used in @a vector.  0 if @a capacity is too small.
+ *
+ * Header names, values and the body are referenced in place and never
+ * copied.  At most <tt>4*count+4</tt> items are used.
+ */
+size_t scgi_encode_iovec (const char * fixed, size_t fixed_size,
+                          const struct scgi_header * headers, size_t count,
+                          const char * body, size_t body_size,
+                          char * prefix, struct iovec * vector,
+                          size_t capacity);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_encode_h__ */
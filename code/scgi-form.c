@@ -0,0 +1,141 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Decoder for "QUERY_STRING" and URL-encoded form data.
+ */
+
+#include "scgi-form.h"
+#include <string.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+# include <emmintrin.h>
+# define SCGI_FORM_SSE2 1
+#endif
+
+/* Locate the first occurrence of either of two bytes. */
+static size_t scgi_form_find (const char * data, size_t size,
+                              char lhs, char rhs)
+{
+    size_t peek = 0;
+#ifdef SCGI_FORM_SSE2
+    const __m128i a = _mm_set1_epi8(lhs);
+    const __m128i b = _mm_set1_epi8(rhs);
+    while ((peek + 16) <= size)
+    {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)(data+peek));
+        const unsigned int mask = (unsigned int)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, a), _mm_cmpeq_epi8(chunk, b)));
+        if (mask != 0) {
+            return (peek + (size_t)__builtin_ctz(mask));
+        }
+        peek += 16;
+    }
+#endif
+    while ((peek < size) && (data[peek] != lhs) && (data[peek] != rhs)) {
+        ++peek;
+    }
+    return (peek);
+}
+
+static int scgi_form_hex (char digit)
+{
+    if ((digit >= '0') && (digit <= '9')) {
+        return (digit - '0');
+    }
+    if ((digit >= 'a') && (digit <= 'f')) {
+        return (digit - 'a' + 10);
+    }
+    if ((digit >= 'A') && (digit <= 'F')) {
+        return (digit - 'A' + 10);
+    }
+    return (-1);
+}
+
+int scgi_form_next (const char * data, size_t size, size_t * used,
+                    const char ** key, size_t * key_size,
+                    const char ** value, size_t * value_size)
+{
+    size_t peek = 0;
+    while (*used < size)
+    {
+        /* find the end of the key. */
+        peek = *used + scgi_form_find(data+*used, size-*used, '=', '&');
+        *key = data+*used;
+        *key_size = peek-*used;
+        *value = data+peek;
+        *value_size = 0;
+        if ((peek < size) && (data[peek] == '='))
+        {
+            /* find the end of the value. */
+            *value = data+(++peek);
+            peek += scgi_form_find(data+peek, size-peek, '&', '&');
+            *value_size = (size_t)((data+peek)-*value);
+        }
+        *used = (peek < size)? peek+1 : peek;
+        if ((*key_size > 0) || (*value_size > 0)) {
+            return (1);
+        }
+    }
+    return (0);
+}
+
+int scgi_form_escaped (const char * data, size_t size)
+{
+    return (scgi_form_find(data, size, '%', '+') < size);
+}
+
+size_t scgi_form_decode (const char * data, size_t size, char * buffer)
+{
+    size_t used = 0;
+    size_t peek = 0;
+    size_t next = 0;
+    int high = 0;
+    int low = 0;
+    while (used < size)
+    {
+        /* copy runs of plain characters in bulk. */
+        peek = used + scgi_form_find(data+used, size-used, '%', '+');
+        if ((buffer+next) != (data+used)) {
+            memmove(buffer+next, data+used, peek-used);
+        }
+        next += peek-used, used = peek;
+        if (used == size) {
+            break;
+        }
+        if (data[used] == '+') {
+            buffer[next++] = ' ', ++used;
+            continue;
+        }
+        if (((used+2) < size) &&
+            ((high = scgi_form_hex(data[used+1])) >= 0) &&
+            ((low = scgi_form_hex(data[used+2])) >= 0))
+        {
+            buffer[next++] = (char)((high << 4) | low), used += 3;
+        }
+        else {
+            buffer[next++] = data[used++];
+        }
+    }
+    return (next);
+}
@@ -0,0 +1,82 @@
+#ifndef _scgi_form_h__
+#define _scgi_form_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Decoder for "QUERY_STRING" and URL-encoded form data.
+ *
+ * The tokenizer does not copy or decode anything: it returns spans over the
+ * original data.  Spans that contain escapes can then be decoded on demand
+ * into a buffer supplied by the caller (possibly the span itself).
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Extract the next key/value pair from URL-encoded data.
+ * @param data Pointer to first byte of data.
+ * @param size Size of @a data, in bytes.
+ * @param used Offset at which to resume scanning.  Initialize to 0 and pass
+ *  the same variable in all calls for the same data.
+ * @param key Receives a pointer to the (still encoded) key.
+ * @param key_size Receives the size of @a key, in bytes.
+ * @param value Receives a pointer to the (still encoded) value.
+ * @param value_size Receives the size of @a value, in bytes.  Pairs without
+ *  a "=" sign have an empty value.
+ * @return 0 when all pairs have been extracted, else non-zero.
+ *
+ * Empty pairs (e.g. "a=1&&b=2") are skipped.
+ */
+int scgi_form_next (const char * data, size_t size, size_t * used,
+                    const char ** key, size_t * key_size,
+                    const char ** value, size_t * value_size);
+
+/*!
+ * @brief Check if a key or value needs to be decoded.
+ * @return 0 if @a data contains no escapes and can be used as-is, else
+ *  non-zero.
+ */
+int scgi_form_escaped (const char * data, size_t size);
+
+/*!
+ * @brief Decode percent escapes and "+" signs in a key or value.
+ * @param data Encoded data.
+ * @param size Size of @a data, in bytes.
+ * @param buffer Output buffer, of at least @a size bytes.  May be equal to
+ *  @a data to decode in place.
+ * @return Size of decoded data, in bytes.  Never more than @a size.
+ *
+ * Malformed escapes are copied verbatim.
+ */
+size_t scgi_form_decode (const char * data, size_t size, char * buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_form_h__ */
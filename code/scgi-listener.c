@@ -0,0 +1,349 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Listening socket with batched accepts (UNIX only).
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE /* accept4() */
+#endif
+
+#include "scgi-listener.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#if defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+# define SCGI_LISTENER_FLAGS (SOCK_NONBLOCK|SOCK_CLOEXEC)
+#else
+# define SCGI_LISTENER_FLAGS 0
+#endif
+
+/* make a socket non-blocking and close-on-exec, if not done atomically. */
+static int scgi_listener_configure (int socket)
+{
+#if !SCGI_LISTENER_FLAGS
+    const int flags = fcntl(socket, F_GETFL);
+    if ((flags < 0) || (fcntl(socket, F_SETFL, flags|O_NONBLOCK) < 0) ||
+        (fcntl(socket, F_SETFD, FD_CLOEXEC) < 0))
+    {
+        return (-1);
+    }
+#else
+    (void)socket;
+#endif
+    return (0);
+}
+
+static int scgi_listener_socket (int family)
+{
+    const int result = socket(family, SOCK_STREAM|SCGI_LISTENER_FLAGS, 0);
+    if ((result >= 0) && (scgi_listener_configure(result) < 0))
+    {
+        close(result);
+        return (-1);
+    }
+    return (result);
+}
+
+/* start listening on a bound socket, closing it on failure. */
+static int scgi_listener_start (struct scgi_listener * listener, int result)
+{
+    int error = 0;
+    if (listen(result, listener->backlog) < 0)
+    {
+        error = errno;
+        close(result);
+        errno = error;
+        return (-1);
+    }
+    listener->socket = result;
+    return (0);
+}
+
+/* check whether a socket file was left over by a server that's gone. */
+static int scgi_listener_stale (const struct sockaddr_un * host,
+                                socklen_t host_size)
+{
+    int probe = -1;
+    int stale = 0;
+    probe = scgi_listener_socket(AF_UNIX);
+    if (probe < 0) {
+        return (0);
+    }
+    /* a live server accepts (or queues, or refuses with EAGAIN). */
+    stale = (connect(probe, (const struct sockaddr*)host, host_size) < 0) &&
+        (errno == ECONNREFUSED);
+    close(probe);
+    return (stale);
+}
+
+static int scgi_listener_open_unix (struct scgi_listener * listener,
+                                    const char * path)
+{
+    struct sockaddr_un host;
+    struct stat status;
+    const size_t size = strlen(path);
+    socklen_t host_size = 0;
+    int result = -1;
+    int error = 0;
+    if ((size == 0) || (size >= sizeof(host.sun_path)) ||
+        (size >= sizeof(listener->path)))
+    {
+        errno = ENAMETOOLONG;
+        return (-1);
+    }
+    memset(&host, 0, sizeof(host));
+    host.sun_family = AF_UNIX;
+    memcpy(host.sun_path, path, size);
+    host_size = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + size);
+    if (path[0] == '@')
+    {
+#if defined(__linux__)
+        host.sun_path[0] = '\0';
+#else
+        errno = EAFNOSUPPORT;
+        return (-1);
+#endif
+    }
+    /* replace a socket left over by a previous run, but not a live one. */
+    else if ((lstat(path, &status) == 0) && S_ISSOCK(status.st_mode) &&
+             scgi_listener_stale(&host, host_size))
+    {
+        unlink(path);
+    }
+    result = scgi_listener_socket(AF_UNIX);
+    if (result < 0) {
+        return (-1);
+    }
+    if (bind(result, (struct sockaddr*)&host, host_size) < 0)
+    {
+        error = errno;
+        close(result);
+        errno = error;
+        return (-1);
+    }
+    /* the socket file is ours from here on: remove it on failure. */
+    if ((path[0] != '@') && (listener->mode != 0) &&
+        (chmod(path, (mode_t)listener->mode) < 0))
+    {
+        error = errno;
+        close(result);
+        unlink(path);
+        errno = error;
+        return (-1);
+    }
+    if (scgi_listener_start(listener, result) < 0)
+    {
+        error = errno;
+        if (path[0] != '@') {
+            unlink(path);
+        }
+        errno = error;
+        return (-1);
+    }
+    if (path[0] != '@') {
+        memcpy(listener->path, path, size+1);
+    }
+    listener->family = AF_UNIX;
+    return (0);
+}
+
+/* queue TCP connections only once the client has sent data. */
+static void scgi_listener_defer (struct scgi_listener * listener, int result)
+{
+#if defined(TCP_DEFER_ACCEPT)
+    const int seconds = listener->defer;
+    setsockopt(result, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+               &seconds, sizeof(seconds));
+#elif defined(SO_ACCEPTFILTER)
+    struct accept_filter_arg filter;
+    memset(&filter, 0, sizeof(filter));
+    strcpy(filter.af_name, "dataready");
+    setsockopt(result, SOL_SOCKET, SO_ACCEPTFILTER,
+               &filter, sizeof(filter));
+    (void)listener;
+#else
+    (void)listener;
+    (void)result;
+#endif
+}
+
+static int scgi_listener_open_tcp (struct scgi_listener * listener,
+                                   const char * address)
+{
+    const char * colon = strrchr(address, ':');
+    char host[256];
+    size_t size = 0;
+    struct addrinfo hints;
+    struct addrinfo * hosts = 0;
+    struct addrinfo * item = 0;
+    const int enable = 1;
+    int wildcard = 0;
+    int pass = 0;
+    int result = -1;
+    int error = EADDRNOTAVAIL;
+    if ((colon == 0) || (colon[1] == '\0')) {
+        errno = EINVAL;
+        return (-1);
+    }
+    size = colon - address;
+    if ((size >= 2) && (address[0] == '[') && (address[size-1] == ']')) {
+        ++address, size -= 2;
+    }
+    if (size >= sizeof(host)) {
+        errno = ENAMETOOLONG;
+        return (-1);
+    }
+    memcpy(host, address, size), host[size] = '\0';
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE|AI_NUMERICSERV;
+    wildcard = (size == 0) || (strcmp(host, "*") == 0);
+    if (getaddrinfo(wildcard? 0 : host, colon+1, &hints, &hosts) != 0)
+    {
+        errno = EINVAL;
+        return (-1);
+    }
+    /* IPv6 wildcards usually accept IPv4 too, so try them first. */
+    for (pass = 0; (pass < 2) && (result < 0); ++pass)
+    {
+        for (item = hosts; item != 0; item = item->ai_next)
+        {
+            if ((pass == 0) !=
+                (wildcard && (item->ai_family == AF_INET6)))
+            {
+                continue;
+            }
+            result = scgi_listener_socket(item->ai_family);
+            if (result < 0) {
+                error = errno;
+                continue;
+            }
+            setsockopt(result, SOL_SOCKET, SO_REUSEADDR,
+                       &enable, sizeof(enable));
+            if (bind(result, item->ai_addr, item->ai_addrlen) == 0) {
+                listener->family = item->ai_family;
+                break;
+            }
+            error = errno;
+            close(result), result = -1;
+        }
+    }
+    freeaddrinfo(hosts);
+    if (result < 0) {
+        errno = error;
+        return (-1);
+    }
+    if (scgi_listener_start(listener, result) < 0) {
+        return (-1);
+    }
+    /* accept filters can only be installed on a listening socket. */
+    if (listener->defer > 0) {
+        scgi_listener_defer(listener, result);
+    }
+    return (0);
+}
+
+void scgi_listener_setup (struct scgi_listener * listener)
+{
+    memset(listener, 0, sizeof(*listener));
+    listener->backlog = SOMAXCONN;
+    listener->socket = -1;
+    listener->family = AF_UNSPEC;
+}
+
+int scgi_listener_open (struct scgi_listener * listener,
+                        const char * address)
+{
+    if (listener->socket >= 0) {
+        errno = EISCONN;
+        return (-1);
+    }
+    listener->path[0] = '\0';
+    if (strncmp(address, "unix:", 5) == 0) {
+        return (scgi_listener_open_unix(listener, address+5));
+    }
+    if ((address[0] == '/') || (address[0] == '.') || (address[0] == '@')) {
+        return (scgi_listener_open_unix(listener, address));
+    }
+    return (scgi_listener_open_tcp(listener, address));
+}
+
+void scgi_listener_close (struct scgi_listener * listener)
+{
+    if (listener->socket < 0) {
+        return;
+    }
+    close(listener->socket);
+    listener->socket = -1;
+    if (listener->path[0] != '\0') {
+        unlink(listener->path);
+        listener->path[0] = '\0';
+    }
+}
+
+int scgi_listener_accept (struct scgi_listener * listener,
+                          int * sockets, size_t capacity)
+{
+    size_t count = 0;
+    int result = -1;
+    while (count < capacity)
+    {
+#if SCGI_LISTENER_FLAGS
+        result = accept4(listener->socket, 0, 0, SCGI_LISTENER_FLAGS);
+#else
+        result = accept(listener->socket, 0, 0);
+        if ((result >= 0) && (scgi_listener_configure(result) < 0)) {
+            close(result);
+            continue;
+        }
+#endif
+        if (result >= 0) {
+            sockets[count++] = result;
+            continue;
+        }
+        /* the client gave up while queued, or a signal arrived. */
+        if ((errno == ECONNABORTED) || (errno == EINTR) ||
+            (errno == EPROTO))
+        {
+            continue;
+        }
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (count > 0)) {
+            break;
+        }
+        return (-1);
+    }
+    return ((int)count);
+}
@@ -0,0 +1,141 @@
+#ifndef _scgi_listener_h__
+#define _scgi_listener_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Listening socket with batched accepts (UNIX only).
+ *
+ * SCGI opens one connection per request, so accepting is as hot as parsing.
+ * The listener drains the accept queue in batches and returns sockets that
+ * are already non-blocking and close-on-exec.  It listens on TCP or on a
+ * Unix-domain socket, which is how front-end servers usually reach SCGI
+ * backends on the same host.
+ *
+ * With @c defer set, TCP connections are queued by the kernel only once
+ * the client has sent data (@c TCP_DEFER_ACCEPT on Linux, the "dataready"
+ * accept filter on FreeBSD), so the head is usually readable as soon as the
+ * socket is accepted.  Read and parse right away, and register the socket
+ * with the poller only if the read would block.
+ *
+ * Functions in this module that can fail return -1 and set @c errno.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Maximum size of a Unix-domain socket path.
+ */
+#define SCGI_LISTENER_MAX_PATH 104
+
+/*!
+ * @brief Listening socket.
+ */
+struct scgi_listener
+{
+    /*!
+     * @public
+     * @brief Maximum number of pending connections.
+     */
+    int backlog;
+
+    /*!
+     * @public
+     * @brief Seconds to wait for data before queuing a TCP connection, or
+     *  0 to queue connections as soon as they are established.
+     *
+     * Ignored where the system has no such option.
+     */
+    int defer;
+
+    /*!
+     * @public
+     * @brief Permissions of a Unix-domain socket, or 0 to apply the umask.
+     */
+    int mode;
+
+    /*!
+     * @public
+     * @brief Listening socket, -1 when closed.
+     */
+    int socket;
+
+    /*!
+     * @public
+     * @brief Address family of the listening socket.
+     */
+    int family;
+
+    /*!
+     * @private
+     * @brief Path of a Unix-domain socket, removed when closed.
+     */
+    char path[SCGI_LISTENER_MAX_PATH];
+};
+
+/*!
+ * @brief Set default options: @c SOMAXCONN backlog, no deferral.
+ */
+void scgi_listener_setup (struct scgi_listener * listener);
+
+/*!
+ * @brief Start listening.
+ * @param listener Listener, with options set.
+ * @param address One of:
+ *  - "unix:/path/to/socket" or "/path/to/socket", for a Unix-domain socket
+ *    (a stale socket file at that path is replaced, but opening fails with
+ *    @c EADDRINUSE if a server still accepts on it);
+ *  - "@name", for a socket in the abstract namespace (Linux only);
+ *  - "host:port", "[ipv6]:port" or "*:port", for TCP.
+ */
+int scgi_listener_open (struct scgi_listener * listener,
+                        const char * address);
+
+/*!
+ * @brief Stop listening, removing the socket file if any.
+ */
+void scgi_listener_close (struct scgi_listener * listener);
+
+/*!
+ * @brief Accept pending connections.
+ * @param listener Listener.
+ * @param sockets Receives the non-blocking, close-on-exec sockets.
+ * @param capacity Number of items in @a sockets.
+ * @return Number of accepted connections, 0 once the queue is empty.  -1
+ *  only if none was accepted, e.g. with @c EMFILE when out of descriptors.
+ *
+ * Call this until it returns less than @a capacity each time the
+ * listening socket is readable.
+ */
+int scgi_listener_accept (struct scgi_listener * listener,
+                          int * sockets, size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_listener_h__ */
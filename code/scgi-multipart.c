@@ -0,0 +1,427 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Streaming parser for "multipart/form-data" request bodies.
+ */
+
+#include "scgi-multipart.h"
+#include <ctype.h>
+#include <string.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+# include <emmintrin.h>
+# define SCGI_MULTIPART_SSE2 1
+#endif
+
+static const char * scgi_multipart_error_messages[] =
+{
+    "so far, so good",
+    "invalid multipart boundary",
+    "bad multipart body syntax",
+    "multipart part head too long",
+};
+
+const char * scgi_multipart_error_message (enum scgi_multipart_error error)
+{
+    return (scgi_multipart_error_messages[error]);
+}
+
+static int scgi_multipart_istarts (const char * data, size_t size,
+                                   const char * prefix)
+{
+    size_t used = 0;
+    while (prefix[used] != '\0')
+    {
+        if ((used == size) ||
+            (tolower((unsigned char)data[used]) != prefix[used])) {
+            return (0);
+        }
+        ++used;
+    }
+    return (1);
+}
+
+int scgi_multipart_boundary (const char * data, size_t size,
+                             const char ** boundary, size_t * length)
+{
+    size_t used = 0;
+    size_t peek = 0;
+    if (!scgi_multipart_istarts(data, size, "multipart/")) {
+        return (0);
+    }
+    while (used < size)
+    {
+        /* skip to the next parameter. */
+        while ((used < size) && (data[used] != ';')) {
+            ++used;
+        }
+        if (used == size) {
+            break;
+        }
+        ++used;
+        while ((used < size) &&
+               ((data[used] == ' ') || (data[used] == '\t'))) {
+            ++used;
+        }
+        if (!scgi_multipart_istarts(data+used, size-used, "boundary=")) {
+            continue;
+        }
+        used += 9;
+        /* boundary may be a quoted string. */
+        if ((used < size) && (data[used] == '"'))
+        {
+            peek = ++used;
+            while ((peek < size) && (data[peek] != '"')) {
+                ++peek;
+            }
+            if (peek == size) {
+                return (0);
+            }
+        }
+        else
+        {
+            peek = used;
+            while ((peek < size) && (data[peek] != ';') &&
+                   (data[peek] != ' ') && (data[peek] != '\t')) {
+                ++peek;
+            }
+        }
+        *boundary = data+used;
+        *length = peek-used;
+        return (peek > used);
+    }
+    return (0);
+}
+
+void scgi_multipart_setup (const struct scgi_multipart_limits * limits,
+                           struct scgi_multipart_parser * parser,
+                           const char * boundary, size_t size)
+{
+    size_t i = 0;
+      /* store limits. */
+    parser->limits.max_head_size = limits->max_head_size;
+      /* global parser setup. */
+    parser->state = scgi_multipart_preamble;
+    parser->error = scgi_multipart_error_ok;
+    parser->head_size = 0;
+    parser->accept_field = 0;
+    parser->finish_field = 0;
+    parser->accept_value = 0;
+    parser->finish_value = 0;
+    parser->finish_head = 0;
+    parser->accept_data = 0;
+    parser->finish_part = 0;
+    parser->finish_body = 0;
+      /* delimiter setup.  line breaks are not valid boundary characters,
+         which guarantees the delimiter never overlaps with itself. */
+    parser->delimiter_size = 0;
+    parser->match = 0;
+    if ((size == 0) || (size > SCGI_MULTIPART_MAX_BOUNDARY)) {
+        parser->error = scgi_multipart_error_boundary;
+        return;
+    }
+    for (i = 0; i < size; ++i)
+    {
+        if ((boundary[i] == '\r') || (boundary[i] == '\n')) {
+            parser->error = scgi_multipart_error_boundary;
+            return;
+        }
+    }
+    memcpy(parser->delimiter, "\r\n--", 4);
+    memcpy(parser->delimiter+4, boundary, size);
+    parser->delimiter_size = 4+size;
+      /* the first boundary is usually not preceded by a line break. */
+    parser->match = 2;
+}
+
+/* Locate the first complete occurrence of the delimiter in the data. */
+static size_t scgi_multipart_find (const char * delimiter, size_t length,
+                                   const char * data, size_t size)
+{
+    size_t peek = 0;
+    const char * next = 0;
+#ifdef SCGI_MULTIPART_SSE2
+    /* compare the first and last delimiter bytes at 16 positions at once and
+       only check candidates that match both. */
+    const __m128i first = _mm_set1_epi8(delimiter[0]);
+    const __m128i last = _mm_set1_epi8(delimiter[length-1]);
+    while ((peek + length + 15) <= size)
+    {
+        const __m128i lhs = _mm_loadu_si128(
+            (const __m128i*)(data+peek));
+        const __m128i rhs = _mm_loadu_si128(
+            (const __m128i*)(data+peek+length-1));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(lhs, first), _mm_cmpeq_epi8(rhs, last)));
+        while (mask != 0)
+        {
+            const size_t bit = (size_t)__builtin_ctz(mask);
+            if (memcmp(data+peek+bit+1, delimiter+1, length-2) == 0) {
+                return (peek+bit);
+            }
+            mask &= mask-1;
+        }
+        peek += 16;
+    }
+#endif
+    while ((peek + length) <= size)
+    {
+        next = (const char*)memchr(data+peek, delimiter[0],
+                                   size-length+1-peek);
+        if (next == 0) {
+            break;
+        }
+        peek = (size_t)(next-data);
+        if (memcmp(data+peek, delimiter, length) == 0) {
+            return (peek);
+        }
+        ++peek;
+    }
+    return (size);
+}
+
+/* Locate the start of a partial delimiter at the end of the data. */
+static size_t scgi_multipart_tail (const char * delimiter, size_t length,
+                                   const char * data, size_t size)
+{
+    size_t peek = (size < length)? 0 : size-length+1;
+    const char * next = 0;
+    while ((next = (const char*)memchr(data+peek, delimiter[0],
+                                       size-peek)) != 0)
+    {
+        peek = (size_t)(next-data);
+        if (memcmp(data+peek, delimiter, size-peek) == 0) {
+            return (peek);
+        }
+        ++peek;
+    }
+    return (size);
+}
+
+static void scgi_multipart_accept_data (struct scgi_multipart_parser * parser,
+                                        const char * data, size_t size)
+{
+    if ((parser->state == scgi_multipart_data) &&
+        (size > 0) && parser->accept_data)
+    {
+        parser->accept_data(parser, data, size);
+    }
+}
+
+static void scgi_multipart_finish_data (struct scgi_multipart_parser * parser)
+{
+    if ((parser->state == scgi_multipart_data) && parser->finish_part) {
+        parser->finish_part(parser);
+    }
+    parser->state = scgi_multipart_delimiter;
+}
+
+/* Scan preamble or part data for the next delimiter. */
+static size_t scgi_multipart_search
+    (struct scgi_multipart_parser * parser, const char * data, size_t size)
+{
+    const char *const delimiter = parser->delimiter;
+    const size_t length = parser->delimiter_size;
+    size_t used = 0;
+    size_t peek = 0;
+    /* settle the partial match held back from the previous chunk. */
+    if (parser->match > 0)
+    {
+        while ((used < size) && (parser->match < length) &&
+               (data[used] == delimiter[parser->match])) {
+            ++used, ++parser->match;
+        }
+        if (parser->match == length) {
+            parser->match = 0;
+            scgi_multipart_finish_data(parser);
+        }
+        else if (used < size) {
+            /* false alarm, release the held back bytes. */
+            scgi_multipart_accept_data(parser, delimiter, parser->match);
+            parser->match = 0;
+        }
+        return (used);
+    }
+    peek = scgi_multipart_find(delimiter, length, data, size);
+    if (peek < size) {
+        scgi_multipart_accept_data(parser, data, peek);
+        scgi_multipart_finish_data(parser);
+        return (peek+length);
+    }
+    peek = scgi_multipart_tail(delimiter, length, data, size);
+    scgi_multipart_accept_data(parser, data, peek);
+    parser->match = size-peek;
+    return (size);
+}
+
+/* Consume as much of a part header name or value as possible. */
+static size_t scgi_multipart_token
+    (struct scgi_multipart_parser * parser, const char * data, size_t size,
+     void(*accept)(struct scgi_multipart_parser*, const char *, size_t))
+{
+    size_t peek = 0;
+    while ((peek < size) && (data[peek] != '\r') && (data[peek] != '\n') &&
+           ((parser->state != scgi_multipart_field) || (data[peek] != ':'))) {
+        ++peek;
+    }
+    if ((peek > 0) && accept) {
+        accept(parser, data, peek);
+    }
+    return (peek);
+}
+
+static size_t scgi_multipart_step
+    (struct scgi_multipart_parser * parser, const char * data, size_t size)
+{
+    const char byte = data[0];
+    size_t used = 0;
+    switch (parser->state)
+    {
+    case scgi_multipart_preamble:
+    case scgi_multipart_data:
+        return (scgi_multipart_search(parser, data, size));
+    case scgi_multipart_delimiter:
+        if (byte == '-') {
+            parser->state = scgi_multipart_close;
+        }
+        else if (byte == '\r') {
+            parser->state = scgi_multipart_delimiter_lf;
+        }
+        else if ((byte != ' ') && (byte != '\t')) {
+            parser->error = scgi_multipart_error_syntax;
+            return (0);
+        }
+        return (1);
+    case scgi_multipart_close:
+        if (byte != '-') {
+            parser->error = scgi_multipart_error_syntax;
+            return (0);
+        }
+        parser->state = scgi_multipart_epilogue;
+        if (parser->finish_body) {
+            parser->finish_body(parser);
+        }
+        return (1);
+    case scgi_multipart_delimiter_lf:
+        if (byte != '\n') {
+            parser->error = scgi_multipart_error_syntax;
+            return (0);
+        }
+        parser->state = scgi_multipart_head;
+        parser->head_size = 0;
+        return (1);
+    case scgi_multipart_head:
+        if (byte == '\r') {
+            parser->state = scgi_multipart_head_lf;
+            return (1);
+        }
+        parser->state = scgi_multipart_field;
+        return (0);
+    case scgi_multipart_field:
+        used = scgi_multipart_token(parser, data, size, parser->accept_field);
+        if (used < size)
+        {
+            if (data[used] != ':') {
+                parser->error = scgi_multipart_error_syntax;
+                return (used);
+            }
+            parser->state = scgi_multipart_space;
+            if (parser->finish_field) {
+                parser->finish_field(parser);
+            }
+            ++used;
+        }
+        return (used);
+    case scgi_multipart_space:
+        if ((byte != ' ') && (byte != '\t')) {
+            parser->state = scgi_multipart_value;
+            return (0);
+        }
+        return (1);
+    case scgi_multipart_value:
+        used = scgi_multipart_token(parser, data, size, parser->accept_value);
+        if (used < size)
+        {
+            if (data[used] != '\r') {
+                parser->error = scgi_multipart_error_syntax;
+                return (used);
+            }
+            parser->state = scgi_multipart_value_lf;
+            ++used;
+        }
+        return (used);
+    case scgi_multipart_value_lf:
+        if (byte != '\n') {
+            parser->error = scgi_multipart_error_syntax;
+            return (0);
+        }
+        parser->state = scgi_multipart_head;
+        if (parser->finish_value) {
+            parser->finish_value(parser);
+        }
+        return (1);
+    case scgi_multipart_head_lf:
+        if (byte != '\n') {
+            parser->error = scgi_multipart_error_syntax;
+            return (0);
+        }
+        parser->state = scgi_multipart_data;
+        if (parser->finish_head) {
+            parser->finish_head(parser);
+        }
+        return (1);
+    case scgi_multipart_epilogue:
+        return (size);
+    }
+    return (size);
+}
+
+static int scgi_multipart_in_head (enum scgi_multipart_state state)
+{
+    return (state >= scgi_multipart_head) && (state <= scgi_multipart_head_lf);
+}
+
+size_t scgi_multipart_consume (struct scgi_multipart_parser * parser,
+                               const char * data, size_t size)
+{
+    size_t used = 0;
+    size_t pass = 0;
+    int head = 0;
+    while ((used < size) && (parser->error == scgi_multipart_error_ok))
+    {
+        head = scgi_multipart_in_head(parser->state);
+        pass = scgi_multipart_step(parser, data+used, size-used);
+        used += pass;
+        if (head)
+        {
+            parser->head_size += pass;
+            if ((parser->limits.max_head_size != 0) &&
+                (parser->head_size > parser->limits.max_head_size))
+            {
+                parser->error = scgi_multipart_error_head_overflow;
+            }
+        }
+    }
+    return (used);
+}
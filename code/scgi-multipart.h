@@ -0,0 +1,304 @@
+#ifndef _scgi_multipart_h__
+#define _scgi_multipart_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Streaming parser for "multipart/form-data" request bodies.
+ *
+ * This parser is meant to be fed from the @c accept_body callback of a @c
+ * scgi_parser.  Like the SCGI request parser, it is implemented as an
+ * interruptible FSM and does not buffer any data: part headers and part
+ * contents are forwarded to registered callbacks as soon as they are
+ * recognized, so uploads of any size are processed in constant memory.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Maximum length of a boundary, as per RFC 2046.
+ */
+#define SCGI_MULTIPART_MAX_BOUNDARY 70
+
+/*!
+ * @brief Enumeration of error states the parser may report.
+ */
+enum scgi_multipart_error
+{
+    scgi_multipart_error_ok=0,
+    scgi_multipart_error_boundary,
+    scgi_multipart_error_syntax,
+    scgi_multipart_error_head_overflow,
+};
+
+/*!
+ * @brief Gets a human-readable description of the error.
+ */
+const char * scgi_multipart_error_message (enum scgi_multipart_error error);
+
+/*!
+ * @internal
+ * @brief Enumeration of parser states.
+ */
+enum scgi_multipart_state
+{
+    /*!
+     * @private
+     * @brief Skipping data that precedes the first boundary.
+     */
+    scgi_multipart_preamble,
+
+    /*!
+     * @private
+     * @brief Matched a boundary, expecting "--" or the end of the line.
+     */
+    scgi_multipart_delimiter,
+
+    /*!
+     * @private
+     * @brief Matched the first dash of a close delimiter.
+     */
+    scgi_multipart_close,
+
+    /*!
+     * @private
+     * @brief Matched the CR at the end of the boundary line.
+     */
+    scgi_multipart_delimiter_lf,
+
+    /*!
+     * @private
+     * @brief At the start of a part header line.
+     */
+    scgi_multipart_head,
+
+    /*!
+     * @private
+     * @brief Parsing a part header name.
+     */
+    scgi_multipart_field,
+
+    /*!
+     * @private
+     * @brief Skipping whitespace between header name and value.
+     */
+    scgi_multipart_space,
+
+    /*!
+     * @private
+     * @brief Parsing a part header value.
+     */
+    scgi_multipart_value,
+
+    /*!
+     * @private
+     * @brief Matched the CR at the end of a part header value.
+     */
+    scgi_multipart_value_lf,
+
+    /*!
+     * @private
+     * @brief Matched the CR of the empty line that ends part headers.
+     */
+    scgi_multipart_head_lf,
+
+    /*!
+     * @private
+     * @brief Streaming part contents.
+     */
+    scgi_multipart_data,
+
+    /*!
+     * @private
+     * @brief Close delimiter seen, skipping the remainder of the body.
+     */
+    scgi_multipart_epilogue,
+};
+
+/*!
+ * @brief Customizable limits for multipart bodies.
+ */
+struct scgi_multipart_limits
+{
+    /*!
+     * @brief Maximum size of the headers of a single part.
+     *
+     * @note Use 0 to disable the limit.
+     */
+    size_t max_head_size;
+};
+
+/*!
+ * @brief Multipart body parser state.
+ */
+struct scgi_multipart_parser
+{
+    /*!
+     * @public
+     * @brief Current state of the parser.
+     *
+     * @warning This field is provided to clients as read-only.
+     */
+    enum scgi_multipart_state state;
+
+    /*!
+     * @public
+     * @brief Last error reported by the parser.
+     *
+     * You should check this after each call to @c scgi_multipart_consume().
+     */
+    enum scgi_multipart_error error;
+
+    /*!
+     * @private
+     * @brief Internal copy of the parser limits.
+     */
+    struct scgi_multipart_limits limits;
+
+    /*!
+     * @private
+     * @brief Delimiter searched for in the body ("\r\n--" + boundary).
+     */
+    char delimiter[4+SCGI_MULTIPART_MAX_BOUNDARY];
+
+    /*!
+     * @private
+     * @brief Length of @c delimiter, in bytes.
+     */
+    size_t delimiter_size;
+
+    /*!
+     * @private
+     * @brief Length of the delimiter prefix matched at the end of the last
+     *  chunk.
+     *
+     * Bytes that might be the start of a delimiter are held back from the @c
+     * accept_data callback until the match is settled.  Because they are a
+     * prefix of the delimiter, they are replayed from @c delimiter and never
+     * need to be buffered.
+     */
+    size_t match;
+
+    /*!
+     * @private
+     * @brief Size of the current part's headers processed so far, in bytes.
+     */
+    size_t head_size;
+
+    /*!
+     * @public
+     * @brief Extra field for client code's use.
+     */
+    void * object;
+
+    /*!
+     * @brief Callback supplying data for a part header name.
+     *
+     * May be invoked several times for the same header.
+     */
+    void(*accept_field)(struct scgi_multipart_parser*, const char *, size_t);
+
+    /*!
+     * @brief Informs the application that the part header name is finished.
+     */
+    void(*finish_field)(struct scgi_multipart_parser*);
+
+    /*!
+     * @brief Callback supplying data for a part header value.
+     *
+     * May be invoked several times for the same header.
+     */
+    void(*accept_value)(struct scgi_multipart_parser*, const char *, size_t);
+
+    /*!
+     * @brief Informs the application that the part header value is finished.
+     */
+    void(*finish_value)(struct scgi_multipart_parser*);
+
+    /*!
+     * @brief Callback indicating the end of the current part's headers.
+     */
+    void(*finish_head)(struct scgi_multipart_parser*);
+
+    /*!
+     * @brief Callback supplying data for the current part's contents.
+     *
+     * May be invoked several times for the same part.
+     */
+    void(*accept_data)(struct scgi_multipart_parser*, const char *, size_t);
+
+    /*!
+     * @brief Informs the application that the current part is finished.
+     */
+    void(*finish_part)(struct scgi_multipart_parser*);
+
+    /*!
+     * @brief Informs the application that the close delimiter was found.
+     *
+     * Any data that follows is ignored.
+     */
+    void(*finish_body)(struct scgi_multipart_parser*);
+};
+
+/*!
+ * @brief Extract the boundary from a "Content-Type" header value.
+ * @param data "CONTENT_TYPE" header value.
+ * @param size Size of @a data, in bytes.
+ * @param boundary Receives a pointer to the boundary inside @a data.
+ * @param length Receives the size of @a boundary, in bytes.
+ * @return 0 if @a data is not a multipart media type with a boundary
+ *  parameter, else non-zero.
+ */
+int scgi_multipart_boundary (const char * data, size_t size,
+                             const char ** boundary, size_t * length);
+
+/*!
+ * @brief Initialize a parser for a body delimited by @a boundary.
+ *
+ * The boundary is copied, so the header buffer it was extracted from may be
+ * released afterwards.  If the boundary is empty or too long, the parser's
+ * @c error field is set to @c scgi_multipart_error_boundary.  All callbacks
+ * are cleared and may be left unset when the application doesn't need them.
+ */
+void scgi_multipart_setup (const struct scgi_multipart_limits * limits,
+                           struct scgi_multipart_parser * parser,
+                           const char * boundary, size_t size);
+
+/*!
+ * @brief Feed body data to the parser.
+ * @param data Pointer to first byte of data.
+ * @param size Size of @a data, in bytes.
+ * @return Number of bytes consumed.  Less than @a size only on error.
+ */
+size_t scgi_multipart_consume (struct scgi_multipart_parser * parser,
+                               const char * data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_multipart_h__ */
@@ -0,0 +1,323 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Handler thread pool decoupled from I/O loops (UNIX only).
+ */
+
+#include "scgi-pool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+# include <sys/eventfd.h>
+# define SCGI_POOL_EVENTFD 1
+#endif
+
+/* Context passed to each handler thread. */
+struct scgi_pool_context
+{
+    struct scgi_pool * pool;
+    size_t index;
+};
+
+static struct scgi_task * scgi_pool_pop (struct scgi_pool_queue * queue)
+{
+    struct scgi_task * task = 0;
+    pthread_mutex_lock(&queue->lock);
+    task = queue->head;
+    if (task != 0)
+    {
+        queue->head = task->next;
+        if (queue->head == 0) {
+            queue->tail = 0;
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return (task);
+}
+
+/* Take a task from our own queue, else steal one from another thread. */
+static struct scgi_task * scgi_pool_take (struct scgi_pool * pool,
+                                          size_t index)
+{
+    struct scgi_task * task = 0;
+    size_t i = 0;
+    for (i = 0; (i < pool->threads) && (task == 0); ++i) {
+        task = scgi_pool_pop(&pool->queues[(index+i) % pool->threads]);
+    }
+    if (task != 0) {
+        __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+    }
+    return (task);
+}
+
+static void * scgi_pool_thread (void * object)
+{
+    struct scgi_pool_context *const context =
+        (struct scgi_pool_context*)object;
+    struct scgi_pool *const pool = context->pool;
+    const size_t index = context->index;
+    struct scgi_task * task = 0;
+    free(context);
+    for (;;)
+    {
+        task = scgi_pool_take(pool, index);
+        if (task != 0)
+        {
+            task->run(task);
+            if (task->owner) {
+                scgi_mailbox_post(task->owner, task);
+            }
+            continue;
+        }
+        pthread_mutex_lock(&pool->lock);
+        while ((__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) == 0) &&
+               !pool->stopped)
+        {
+            ++pool->sleeping;
+            pthread_cond_wait(&pool->ready, &pool->lock);
+            --pool->sleeping;
+        }
+        if (pool->stopped &&
+            (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) == 0))
+        {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return (0);
+}
+
+int scgi_pool_setup (struct scgi_pool * pool, size_t threads)
+{
+    struct scgi_pool_context * context = 0;
+    size_t i = 0;
+    int error = 0;
+    if (threads == 0) {
+        errno = EINVAL;
+        return (-1);
+    }
+    pool->threads = 0;
+    pool->pending = 0;
+    pool->sleeping = 0;
+    pool->next = 0;
+    pool->stopped = 0;
+    pool->handles = (pthread_t*)malloc(threads*sizeof(pthread_t));
+    pool->queues = (struct scgi_pool_queue*)malloc(
+        threads*sizeof(struct scgi_pool_queue));
+    if ((pool->handles == 0) || (pool->queues == 0)) {
+        free(pool->handles), free(pool->queues);
+        errno = ENOMEM;
+        return (-1);
+    }
+    pthread_mutex_init(&pool->lock, 0);
+    pthread_cond_init(&pool->ready, 0);
+    for (i = 0; i < threads; ++i)
+    {
+        pthread_mutex_init(&pool->queues[i].lock, 0);
+        pool->queues[i].head = 0;
+        pool->queues[i].tail = 0;
+    }
+    for (i = 0; i < threads; ++i)
+    {
+        context = (struct scgi_pool_context*)malloc(sizeof(*context));
+        if (context == 0) {
+            error = ENOMEM;
+            break;
+        }
+        context->pool = pool;
+        context->index = i;
+        error = pthread_create(&pool->handles[i], 0,
+                               &scgi_pool_thread, context);
+        if (error != 0) {
+            free(context);
+            break;
+        }
+        ++pool->threads;
+    }
+    if (error != 0) {
+        scgi_pool_release(pool);
+        errno = error;
+        return (-1);
+    }
+    return (0);
+}
+
+void scgi_pool_submit (struct scgi_pool * pool, struct scgi_task * task)
+{
+    const size_t index =
+        __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED) % pool->threads;
+    struct scgi_pool_queue *const queue = &pool->queues[index];
+    task->next = 0;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail != 0) {
+        queue->tail->next = task;
+    }
+    else {
+        queue->head = task;
+    }
+    queue->tail = task;
+    pthread_mutex_unlock(&queue->lock);
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+    /* wake up a sleeping thread, if any. */
+    pthread_mutex_lock(&pool->lock);
+    if (pool->sleeping > 0) {
+        pthread_cond_signal(&pool->ready);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void scgi_pool_release (struct scgi_pool * pool)
+{
+    size_t i = 0;
+    pthread_mutex_lock(&pool->lock);
+    pool->stopped = 1;
+    pthread_cond_broadcast(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->threads; ++i) {
+        pthread_join(pool->handles[i], 0);
+    }
+    for (i = 0; i < pool->threads; ++i) {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+    }
+    pthread_cond_destroy(&pool->ready);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->handles), pool->handles = 0;
+    free(pool->queues), pool->queues = 0;
+    pool->threads = 0;
+}
+
+int scgi_mailbox_setup (struct scgi_mailbox * mailbox)
+{
+    mailbox->stub.next = 0;
+    mailbox->head = &mailbox->stub;
+    mailbox->tail = &mailbox->stub;
+    mailbox->signaled = 0;
+#ifdef SCGI_POOL_EVENTFD
+    mailbox->events[0] = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+    mailbox->events[1] = mailbox->events[0];
+    return ((mailbox->events[0] < 0)? -1 : 0);
+#else
+    if (pipe(mailbox->events) < 0) {
+        return (-1);
+    }
+    fcntl(mailbox->events[0], F_SETFL, O_NONBLOCK);
+    fcntl(mailbox->events[1], F_SETFL, O_NONBLOCK);
+    fcntl(mailbox->events[0], F_SETFD, FD_CLOEXEC);
+    fcntl(mailbox->events[1], F_SETFD, FD_CLOEXEC);
+    return (0);
+#endif
+}
+
+int scgi_mailbox_fd (const struct scgi_mailbox * mailbox)
+{
+    return (mailbox->events[0]);
+}
+
+static void scgi_mailbox_push (struct scgi_mailbox * mailbox,
+                               struct scgi_task * task)
+{
+    struct scgi_task * prev = 0;
+    __atomic_store_n(&task->next, 0, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&mailbox->head, task, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, task, __ATOMIC_RELEASE);
+}
+
+/* Intrusive MPSC queue pop (consumer only).  May spuriously return null
+   while a producer is half-way through a push; that producer signals the
+   mailbox afterwards, so the task is picked up on the next dispatch. */
+static struct scgi_task * scgi_mailbox_pop (struct scgi_mailbox * mailbox)
+{
+    struct scgi_task * tail = mailbox->tail;
+    struct scgi_task * next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (tail == &mailbox->stub)
+    {
+        if (next == 0) {
+            return (0);
+        }
+        mailbox->tail = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+    if (next != 0) {
+        mailbox->tail = next;
+        return (tail);
+    }
+    if (tail != __atomic_load_n(&mailbox->head, __ATOMIC_ACQUIRE)) {
+        return (0);
+    }
+    scgi_mailbox_push(mailbox, &mailbox->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next != 0) {
+        mailbox->tail = next;
+        return (tail);
+    }
+    return (0);
+}
+
+void scgi_mailbox_post (struct scgi_mailbox * mailbox,
+                        struct scgi_task * task)
+{
+    static const uint64_t one = 1;
+    ssize_t used = 0;
+    scgi_mailbox_push(mailbox, task);
+    /* only the first post after a dispatch needs to wake up the owner. */
+    if (__atomic_exchange_n(&mailbox->signaled, 1, __ATOMIC_ACQ_REL) == 0) {
+        do {
+            used = write(mailbox->events[1], &one, sizeof(one));
+        }
+        while ((used < 0) && (errno == EINTR));
+    }
+}
+
+size_t scgi_mailbox_dispatch (struct scgi_mailbox * mailbox)
+{
+    uint64_t count = 0;
+    struct scgi_task * task = 0;
+    size_t done = 0;
+    /* reset the wake-up before draining, so later posts signal again. */
+    while (read(mailbox->events[0], &count, sizeof(count)) > 0) {
+    }
+    __atomic_store_n(&mailbox->signaled, 0, __ATOMIC_SEQ_CST);
+    while ((task = scgi_mailbox_pop(mailbox)) != 0)
+    {
+        if (task->done) {
+            task->done(task);
+        }
+        ++done;
+    }
+    return (done);
+}
+
+void scgi_mailbox_release (struct scgi_mailbox * mailbox)
+{
+    close(mailbox->events[0]);
+    if (mailbox->events[1] != mailbox->events[0]) {
+        close(mailbox->events[1]);
+    }
+}
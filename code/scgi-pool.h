@@ -0,0 +1,242 @@
+#ifndef _scgi_pool_h__
+#define _scgi_pool_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Handler thread pool decoupled from I/O loops (UNIX only).
+ *
+ * I/O threads only parse requests.  Once a request is complete, the I/O
+ * thread submits a task to the pool, where handler threads run it.  Each
+ * handler thread has its own queue and steals from other queues when its
+ * own is empty, so a slow handler does not hold up tasks queued behind it.
+ * Completed tasks are posted back to the mailbox of the I/O thread that
+ * owns the connection: a lock-free MPSC queue paired with a file descriptor
+ * that becomes readable when tasks are waiting, for use with @c poll() and
+ * friends.
+ *
+ * Functions in this module return -1 and set @c errno on failure.
+ */
+
+#include <stddef.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct scgi_mailbox;
+
+/*!
+ * @brief Unit of work, usually embedded in a connection object.
+ */
+struct scgi_task
+{
+    /*!
+     * @private
+     * @brief Link to the next task in a queue.
+     */
+    struct scgi_task * next;
+
+    /*!
+     * @public
+     * @brief Mailbox to which the task is posted after it runs.
+     *
+     * When null, the task is not posted back.
+     */
+    struct scgi_mailbox * owner;
+
+    /*!
+     * @brief Callback run by a handler thread.
+     *
+     * Typically runs the request handler and formats the response.
+     */
+    void(*run)(struct scgi_task*);
+
+    /*!
+     * @brief Callback run by the owner's I/O thread after @c run.
+     *
+     * Typically starts sending the response.  May be left unset.
+     */
+    void(*done)(struct scgi_task*);
+};
+
+/*!
+ * @private
+ * @brief Per-thread queue of a handler pool.
+ */
+struct scgi_pool_queue
+{
+    pthread_mutex_t lock;
+    struct scgi_task * head;
+    struct scgi_task * tail;
+};
+
+/*!
+ * @brief Pool of handler threads.
+ */
+struct scgi_pool
+{
+    /*!
+     * @public
+     * @brief Number of handler threads.
+     */
+    size_t threads;
+
+    /*!
+     * @private
+     * @brief Handler thread handles.
+     */
+    pthread_t * handles;
+
+    /*!
+     * @private
+     * @brief Handler thread queues.
+     */
+    struct scgi_pool_queue * queues;
+
+    /*!
+     * @private
+     * @brief Protects sleeping handler threads.
+     */
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+
+    /*!
+     * @private
+     * @brief Number of queued tasks, across all queues.
+     */
+    size_t pending;
+
+    /*!
+     * @private
+     * @brief Number of handler threads waiting for tasks.
+     */
+    size_t sleeping;
+
+    /*!
+     * @private
+     * @brief Queue to which the next task is submitted.
+     */
+    size_t next;
+
+    /*!
+     * @private
+     * @brief Set when the pool is released.
+     */
+    int stopped;
+};
+
+/*!
+ * @brief Lock-free queue of completed tasks for an I/O thread.
+ */
+struct scgi_mailbox
+{
+    /*!
+     * @private
+     * @brief Most recently posted task (producer end).
+     */
+    struct scgi_task * head;
+
+    /*!
+     * @private
+     * @brief Oldest posted task (consumer end).
+     */
+    struct scgi_task * tail;
+
+    /*!
+     * @private
+     * @brief Placeholder that keeps the queue non-empty.
+     */
+    struct scgi_task stub;
+
+    /*!
+     * @private
+     * @brief Non-zero when the wake-up descriptor is readable.
+     */
+    int signaled;
+
+    /*!
+     * @private
+     * @brief Wake-up descriptors (eventfd, or a pipe).
+     */
+    int events[2];
+};
+
+/*!
+ * @brief Start @a threads handler threads.
+ *
+ * Fails with @c EINVAL when @a threads is zero.
+ */
+int scgi_pool_setup (struct scgi_pool * pool, size_t threads);
+
+/*!
+ * @brief Queue a task for execution by a handler thread.
+ *
+ * May be called from any thread, including handler threads.
+ */
+void scgi_pool_submit (struct scgi_pool * pool, struct scgi_task * task);
+
+/*!
+ * @brief Stop handler threads and release resources.
+ *
+ * Tasks already queued are run before threads exit.
+ */
+void scgi_pool_release (struct scgi_pool * pool);
+
+/*!
+ * @brief Prepare a mailbox for an I/O thread.
+ */
+int scgi_mailbox_setup (struct scgi_mailbox * mailbox);
+
+/*!
+ * @brief Get the descriptor to watch for readability in the I/O loop.
+ */
+int scgi_mailbox_fd (const struct scgi_mailbox * mailbox);
+
+/*!
+ * @brief Post a task to a mailbox.  Lock-free, may be called from any
+ *  thread.
+ */
+void scgi_mailbox_post (struct scgi_mailbox * mailbox,
+                        struct scgi_task * task);
+
+/*!
+ * @brief Run the @c done callback of all posted tasks.
+ * @return Number of tasks processed.
+ *
+ * Must only be called from the thread that owns the mailbox, usually when
+ * @c scgi_mailbox_fd() becomes readable.
+ */
+size_t scgi_mailbox_dispatch (struct scgi_mailbox * mailbox);
+
+/*!
+ * @brief Release the mailbox's descriptors.
+ */
+void scgi_mailbox_release (struct scgi_mailbox * mailbox);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_pool_h__ */
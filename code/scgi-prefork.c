@@ -0,0 +1,344 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Pre-forked multi-process SCGI server (UNIX only).
+ */
+
+#include "scgi-prefork.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef MAP_ANONYMOUS
+# define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#ifdef MSG_NOSIGNAL
+# define SCGI_PREFORK_SEND_FLAGS MSG_NOSIGNAL
+#else
+# define SCGI_PREFORK_SEND_FLAGS 0
+#endif
+
+#ifdef MSG_CMSG_CLOEXEC
+# define SCGI_PREFORK_RECV_FLAGS MSG_CMSG_CLOEXEC
+#else
+# define SCGI_PREFORK_RECV_FLAGS 0
+#endif
+
+int scgi_send_socket (int channel, int socket)
+{
+    struct msghdr message;
+    struct iovec vector;
+    struct cmsghdr * header = 0;
+    union {
+        struct cmsghdr header;
+        char data[CMSG_SPACE(sizeof(int))];
+    } control;
+    char byte = 0;
+    memset(&message, 0, sizeof(message));
+    memset(&control, 0, sizeof(control));
+    vector.iov_base = &byte;
+    vector.iov_len = 1;
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data;
+    message.msg_controllen = sizeof(control.data);
+    header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &socket, sizeof(int));
+    while (sendmsg(channel, &message, SCGI_PREFORK_SEND_FLAGS) < 0)
+    {
+        if (errno != EINTR) {
+            return (-1);
+        }
+    }
+    return (0);
+}
+
+int scgi_recv_socket (int channel)
+{
+    struct msghdr message;
+    struct iovec vector;
+    struct cmsghdr * header = 0;
+    union {
+        struct cmsghdr header;
+        char data[CMSG_SPACE(sizeof(int))];
+    } control;
+    char byte = 0;
+    ssize_t used = 0;
+    int socket = -1;
+    memset(&message, 0, sizeof(message));
+    vector.iov_base = &byte;
+    vector.iov_len = 1;
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data;
+    message.msg_controllen = sizeof(control.data);
+    while ((used = recvmsg(channel, &message, SCGI_PREFORK_RECV_FLAGS)) < 0)
+    {
+        if (errno != EINTR) {
+            return (-1);
+        }
+    }
+    if (used == 0) {
+        errno = 0;
+        return (-1);
+    }
+    header = CMSG_FIRSTHDR(&message);
+    if ((header == 0) || (header->cmsg_level != SOL_SOCKET) ||
+        (header->cmsg_type != SCM_RIGHTS)) {
+        errno = EBADMSG;
+        return (-1);
+    }
+    memcpy(&socket, CMSG_DATA(header), sizeof(int));
+    return (socket);
+}
+
+int scgi_prefork_setup (struct scgi_prefork * server,
+                        int listener, size_t workers)
+{
+    size_t i = 0;
+    void * scoreboard = 0;
+    scoreboard = mmap(0, workers*sizeof(struct scgi_prefork_slot),
+                      PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if (scoreboard == MAP_FAILED) {
+        return (-1);
+    }
+    server->channels = (int*)malloc(workers*sizeof(int));
+    if (server->channels == 0) {
+        munmap(scoreboard, workers*sizeof(struct scgi_prefork_slot));
+        errno = ENOMEM;
+        return (-1);
+    }
+    server->scoreboard = (struct scgi_prefork_slot*)scoreboard;
+    for (i = 0; i < workers; ++i)
+    {
+        server->scoreboard[i].pid = 0;
+        server->scoreboard[i].outstanding = 0;
+        server->scoreboard[i].served = 0;
+        server->channels[i] = -1;
+    }
+    server->listener = listener;
+    server->workers = workers;
+    server->stopped = 0;
+    server->object = 0;
+    server->start_worker = 0;
+    server->serve = 0;
+    return (0);
+}
+
+static void scgi_prefork_worker (struct scgi_prefork * server,
+                                 size_t index, int channel)
+{
+    struct scgi_prefork_slot *const slot = &server->scoreboard[index];
+    int socket = -1;
+    if (server->start_worker) {
+        server->start_worker(server);
+    }
+    while ((socket = scgi_recv_socket(channel)) >= 0)
+    {
+        server->serve(server, socket);
+        close(socket);
+        __atomic_add_fetch(&slot->served, 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&slot->outstanding, 1, __ATOMIC_RELEASE);
+    }
+}
+
+/* socket is a connection being dispatched, which the worker must not keep
+   open: the client would never see it closed.  -1 if none. */
+static int scgi_prefork_spawn (struct scgi_prefork * server, size_t index,
+                               int socket)
+{
+    int channels[2];
+    pid_t pid = 0;
+    size_t i = 0;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, channels) < 0) {
+        return (-1);
+    }
+    pid = fork();
+    if (pid < 0) {
+        close(channels[0]), close(channels[1]);
+        return (-1);
+    }
+    if (pid == 0)
+    {
+        /* worker process: keep only our end of our own channel. */
+        for (i = 0; i < server->workers; ++i)
+        {
+            if (server->channels[i] >= 0) {
+                close(server->channels[i]);
+            }
+        }
+        close(server->listener);
+        if (socket >= 0) {
+            close(socket);
+        }
+        close(channels[0]);
+        scgi_prefork_worker(server, index, channels[1]);
+        _exit(EXIT_SUCCESS);
+    }
+    close(channels[1]);
+    if (server->channels[index] >= 0) {
+        close(server->channels[index]);
+    }
+    server->channels[index] = channels[0];
+    __atomic_store_n(&server->scoreboard[index].outstanding,
+                     0, __ATOMIC_RELAXED);
+    server->scoreboard[index].pid = pid;
+    return (0);
+}
+
+/* Re-spawn workers that exited since the last check. */
+static int scgi_prefork_reap (struct scgi_prefork * server, int socket)
+{
+    pid_t pid = 0;
+    size_t i = 0;
+    int status = 0;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        for (i = 0; i < server->workers; ++i)
+        {
+            if (server->scoreboard[i].pid != pid) {
+                continue;
+            }
+            server->scoreboard[i].pid = 0;
+            if (scgi_prefork_spawn(server, i, socket) < 0) {
+                return (-1);
+            }
+        }
+    }
+    return (0);
+}
+
+size_t scgi_prefork_pick (const struct scgi_prefork * server)
+{
+    size_t best = 0;
+    size_t i = 0;
+    long least = __atomic_load_n(&server->scoreboard[0].outstanding,
+                                 __ATOMIC_ACQUIRE);
+    long current = 0;
+    for (i = 1; (i < server->workers) && (least > 0); ++i)
+    {
+        current = __atomic_load_n(&server->scoreboard[i].outstanding,
+                                  __ATOMIC_ACQUIRE);
+        if (current < least) {
+            best = i, least = current;
+        }
+    }
+    return (best);
+}
+
+static int scgi_prefork_dispatch (struct scgi_prefork * server, int socket)
+{
+    size_t index = 0;
+    int attempt = 0;
+    for (attempt = 0; attempt < 2; ++attempt)
+    {
+        index = scgi_prefork_pick(server);
+        __atomic_add_fetch(&server->scoreboard[index].outstanding,
+                           1, __ATOMIC_RELAXED);
+        if (scgi_send_socket(server->channels[index], socket) == 0) {
+            return (0);
+        }
+        /* worker died or its channel broke: kill it (the reaper collects
+           it if it is not gone yet), replace it and try again. */
+        if (server->scoreboard[index].pid != 0)
+        {
+            kill(server->scoreboard[index].pid, SIGKILL);
+            waitpid(server->scoreboard[index].pid, 0, WNOHANG);
+        }
+        server->scoreboard[index].pid = 0;
+        if (scgi_prefork_spawn(server, index, socket) < 0) {
+            return (-1);
+        }
+    }
+    return (-1);
+}
+
+int scgi_prefork_run (struct scgi_prefork * server)
+{
+    size_t i = 0;
+    int socket = -1;
+    for (i = 0; i < server->workers; ++i)
+    {
+        if (scgi_prefork_spawn(server, i, -1) < 0) {
+            return (-1);
+        }
+    }
+    while (!server->stopped)
+    {
+        socket = accept(server->listener, 0, 0);
+        if (socket < 0)
+        {
+            if ((errno == EINTR) || (errno == ECONNABORTED) ||
+                (errno == EAGAIN)) {
+                continue;
+            }
+            return (-1);
+        }
+        if (scgi_prefork_reap(server, socket) < 0) {
+            close(socket);
+            return (-1);
+        }
+        /* the connection is dropped if no worker can take it. */
+        scgi_prefork_dispatch(server, socket);
+        close(socket);
+    }
+    return (0);
+}
+
+void scgi_prefork_stop (struct scgi_prefork * server)
+{
+    server->stopped = 1;
+}
+
+void scgi_prefork_release (struct scgi_prefork * server)
+{
+    size_t i = 0;
+    /* closing the channels lets workers exit after their current request. */
+    for (i = 0; i < server->workers; ++i)
+    {
+        if (server->channels[i] >= 0) {
+            close(server->channels[i]);
+        }
+    }
+    for (i = 0; i < server->workers; ++i)
+    {
+        if (server->scoreboard[i].pid != 0) {
+            waitpid(server->scoreboard[i].pid, 0, 0);
+        }
+    }
+    munmap(server->scoreboard,
+           server->workers*sizeof(struct scgi_prefork_slot));
+    free(server->channels);
+    server->scoreboard = 0;
+    server->channels = 0;
+}
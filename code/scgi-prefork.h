@@ -0,0 +1,184 @@
+#ifndef _scgi_prefork_h__
+#define _scgi_prefork_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Pre-forked multi-process SCGI server (UNIX only).
+ *
+ * A single acceptor process accepts connections and hands each socket to
+ * one of N worker processes over a UNIX domain socket pair (using @c
+ * SCM_RIGHTS).  The acceptor picks the worker with the fewest outstanding
+ * connections, as recorded in a scoreboard shared with all workers.  Each
+ * worker serves one connection at a time, so handler code never needs to be
+ * thread-safe.
+ *
+ * Functions in this module return -1 and set @c errno on failure.
+ */
+
+#include <stddef.h>
+#include <signal.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Scoreboard entry for a worker process, in shared memory.
+ */
+struct scgi_prefork_slot
+{
+    /*!
+     * @brief Worker process ID, 0 when not running.
+     */
+    pid_t pid;
+
+    /*!
+     * @brief Connections handed to the worker and not yet closed.
+     *
+     * Incremented by the acceptor, decremented by the worker.
+     */
+    long outstanding;
+
+    /*!
+     * @brief Total number of connections served by the worker.
+     */
+    unsigned long served;
+};
+
+/*!
+ * @brief Pre-forked server state.
+ */
+struct scgi_prefork
+{
+    /*!
+     * @public
+     * @brief Listening socket, owned by the application.
+     */
+    int listener;
+
+    /*!
+     * @public
+     * @brief Number of worker processes.
+     */
+    size_t workers;
+
+    /*!
+     * @public
+     * @brief Scoreboard, shared by the acceptor and all workers.
+     *
+     * May be inspected by the application (e.g. for monitoring).
+     */
+    struct scgi_prefork_slot * scoreboard;
+
+    /*!
+     * @private
+     * @brief Acceptor end of the socket pair of each worker.
+     */
+    int * channels;
+
+    /*!
+     * @private
+     * @brief Set by @c scgi_prefork_stop().
+     */
+    volatile sig_atomic_t stopped;
+
+    /*!
+     * @public
+     * @brief Extra field for client code's use.
+     */
+    void * object;
+
+    /*!
+     * @brief Callback run in a worker process when it starts.
+     *
+     * Use this to initialize libraries that should not be shared across
+     * processes.  May be left unset.
+     */
+    void(*start_worker)(struct scgi_prefork*);
+
+    /*!
+     * @brief Callback serving a connection, in a worker process.
+     * @param server The server itself.  Useful for accessing the @c object
+     *  field.
+     * @param socket Connected socket.  It is closed by the server when the
+     *  callback returns.
+     *
+     * This is where the application runs its @c scgi_parser loop.
+     */
+    void(*serve)(struct scgi_prefork*, int);
+};
+
+/*!
+ * @brief Initialize the server and allocate the shared scoreboard.
+ * @param server Server state.
+ * @param listener Listening socket.
+ * @param workers Number of worker processes to spawn.
+ *
+ * Callbacks are cleared.  Register them before calling @c scgi_prefork_run().
+ */
+int scgi_prefork_setup (struct scgi_prefork * server,
+                        int listener, size_t workers);
+
+/*!
+ * @brief Spawn workers and run the acceptor loop.
+ *
+ * Returns 0 after @c scgi_prefork_stop() is called (e.g. from a signal
+ * handler), or -1 if accepting connections fails.  Workers that exit are
+ * re-spawned.
+ */
+int scgi_prefork_run (struct scgi_prefork * server);
+
+/*!
+ * @brief Ask the acceptor loop to return.  Async-signal-safe.
+ */
+void scgi_prefork_stop (struct scgi_prefork * server);
+
+/*!
+ * @brief Terminate workers and release the scoreboard.
+ */
+void scgi_prefork_release (struct scgi_prefork * server);
+
+/*!
+ * @brief Pick the worker with the fewest outstanding connections.
+ */
+size_t scgi_prefork_pick (const struct scgi_prefork * server);
+
+/*!
+ * @brief Send a file descriptor over a UNIX domain socket.
+ */
+int scgi_send_socket (int channel, int socket);
+
+/*!
+ * @brief Receive a file descriptor sent with @c scgi_send_socket().
+ * @return The received descriptor, or -1 (with @c errno set to 0 when the
+ *  peer closed the channel).
+ */
+int scgi_recv_socket (int channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_prefork_h__ */
@@ -0,0 +1,353 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Shared-memory rings between a front process and workers (UNIX only).
+ */
+
+#include "scgi-ring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+# include <limits.h>
+# include <linux/futex.h>
+# include <sys/syscall.h>
+# define SCGI_RING_FUTEX 1
+# ifndef MFD_CLOEXEC
+#  define MFD_CLOEXEC 1
+# endif
+#endif
+
+/* Size of the region header, padded to a cache line. */
+#define SCGI_RING_HEADER 64
+
+static const char scgi_ring_magic[8] = "SCGIRNG";
+
+static size_t scgi_ring_align (size_t size)
+{
+    return ((size + 15) & ~(size_t)15);
+}
+
+static size_t scgi_ring_offset (size_t index, uint32_t capacity)
+{
+    return (SCGI_RING_HEADER +
+            index*(sizeof(struct scgi_ring_shared) + capacity));
+}
+
+/* Block while *word == value, or until woken up. */
+static void scgi_ring_sleep (uint32_t * word, uint32_t value, int timeout)
+{
+    struct timespec delay;
+#ifdef SCGI_RING_FUTEX
+    delay.tv_sec = timeout / 1000;
+    delay.tv_nsec = (timeout % 1000) * 1000000L;
+    syscall(SYS_futex, word, FUTEX_WAIT, value,
+            (timeout < 0)? 0 : &delay, 0, 0);
+#else
+    /* poll, without a futex. */
+    (void)word, (void)value;
+    delay.tv_sec = 0;
+    delay.tv_nsec = ((timeout < 0) || (timeout > 1))? 1000000L : 0;
+    nanosleep(&delay, 0);
+#endif
+}
+
+static void scgi_ring_wake (uint32_t * word)
+{
+#ifdef SCGI_RING_FUTEX
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+#else
+    (void)word;
+#endif
+}
+
+/* Publish the producer position, waking the consumer if it sleeps. */
+static void scgi_ring_publish (struct scgi_ring * ring, uint32_t head)
+{
+    __atomic_store_n(&ring->shared->head, head, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->shared->readers, __ATOMIC_SEQ_CST)) {
+        scgi_ring_wake(&ring->shared->head);
+    }
+}
+
+int scgi_ring_region_create (struct scgi_ring_region * region,
+                             size_t count, size_t capacity)
+{
+    struct scgi_ring_region_header * header = 0;
+    uint32_t size = 4096;
+    void * data = 0;
+#ifndef SCGI_RING_FUTEX
+    char name[64];
+#endif
+    while ((size < capacity) && (size < (1u << 30))) {
+        size *= 2;
+    }
+    if ((capacity > size) || (count == 0)) {
+        errno = EINVAL;
+        return (-1);
+    }
+    region->size = scgi_ring_offset(count, size);
+#ifdef SCGI_RING_FUTEX
+    region->file = (int)syscall(SYS_memfd_create, "scgi-ring", MFD_CLOEXEC);
+#else
+    snprintf(name, sizeof(name), "/scgi-ring-%ld", (long)getpid());
+    region->file = shm_open(name, O_RDWR|O_CREAT|O_EXCL, 0600);
+    if (region->file >= 0) {
+        shm_unlink(name);
+    }
+#endif
+    if (region->file < 0) {
+        return (-1);
+    }
+    /* the new file is filled with zeros. */
+    if (ftruncate(region->file, (off_t)region->size) < 0) {
+        close(region->file), region->file = -1;
+        return (-1);
+    }
+    data = mmap(0, region->size, PROT_READ|PROT_WRITE,
+                MAP_SHARED, region->file, 0);
+    if (data == MAP_FAILED) {
+        close(region->file), region->file = -1;
+        return (-1);
+    }
+    region->data = (char*)data;
+    header = (struct scgi_ring_region_header*)data;
+    memcpy(header->magic, scgi_ring_magic, sizeof(header->magic));
+    header->version = 1;
+    header->count = (uint32_t)count;
+    header->capacity = size;
+    return (0);
+}
+
+int scgi_ring_region_attach (struct scgi_ring_region * region, int file)
+{
+    const struct scgi_ring_region_header * header = 0;
+    struct stat status;
+    void * data = 0;
+    region->file = file;
+    region->data = 0;
+    region->size = 0;
+    if (fstat(file, &status) < 0) {
+        return (-1);
+    }
+    if ((size_t)status.st_size < SCGI_RING_HEADER) {
+        errno = EINVAL;
+        return (-1);
+    }
+    data = mmap(0, (size_t)status.st_size, PROT_READ|PROT_WRITE,
+                MAP_SHARED, file, 0);
+    if (data == MAP_FAILED) {
+        return (-1);
+    }
+    region->data = (char*)data;
+    region->size = (size_t)status.st_size;
+    header = (const struct scgi_ring_region_header*)data;
+    if ((memcmp(header->magic, scgi_ring_magic, 8) != 0) ||
+        (header->version != 1) || (header->capacity < 4096) ||
+        ((header->capacity & (header->capacity-1)) != 0) ||
+        (scgi_ring_offset(header->count, header->capacity) > region->size))
+    {
+        munmap(data, region->size);
+        region->data = 0;
+        region->size = 0;
+        errno = EINVAL;
+        return (-1);
+    }
+    return (0);
+}
+
+void scgi_ring_region_detach (struct scgi_ring_region * region)
+{
+    if (region->data != 0) {
+        munmap(region->data, region->size);
+    }
+    if (region->file >= 0) {
+        close(region->file);
+    }
+    region->data = 0;
+    region->size = 0;
+    region->file = -1;
+}
+
+int scgi_ring_open (struct scgi_ring * ring,
+                    const struct scgi_ring_region * region, size_t index)
+{
+    const struct scgi_ring_region_header *const header =
+        (const struct scgi_ring_region_header*)region->data;
+    char * base = 0;
+    if (index >= header->count) {
+        errno = EINVAL;
+        return (-1);
+    }
+    base = region->data + scgi_ring_offset(index, header->capacity);
+    ring->shared = (struct scgi_ring_shared*)base;
+    ring->data = base + sizeof(struct scgi_ring_shared);
+    ring->capacity = header->capacity;
+    return (0);
+}
+
+void * scgi_ring_reserve (struct scgi_ring * ring, size_t size)
+{
+    struct scgi_ring_record * record = 0;
+    const size_t need = sizeof(struct scgi_ring_record) + scgi_ring_align(size);
+    uint32_t head = ring->shared->head;
+    const uint32_t tail = __atomic_load_n(&ring->shared->tail,
+                                          __ATOMIC_ACQUIRE);
+    uint32_t position = head & (ring->capacity-1);
+    const uint32_t contiguous = ring->capacity - position;
+    if (need > ring->capacity) {
+        errno = EMSGSIZE;
+        return (0);
+    }
+    /* records never wrap: pad up to the end of the ring. */
+    if (need > contiguous)
+    {
+        if ((ring->capacity - (head - tail)) < contiguous) {
+            errno = EAGAIN;
+            return (0);
+        }
+        record = (struct scgi_ring_record*)(ring->data + position);
+        record->size = contiguous - sizeof(struct scgi_ring_record);
+        record->flags = scgi_ring_skip;
+        record->tag = 0;
+        head += contiguous, position = 0;
+        scgi_ring_publish(ring, head);
+    }
+    if ((ring->capacity - (head - tail)) < need) {
+        errno = EAGAIN;
+        return (0);
+    }
+    return (ring->data + position + sizeof(struct scgi_ring_record));
+}
+
+void scgi_ring_commit (struct scgi_ring * ring, size_t size, uint64_t tag)
+{
+    const uint32_t head = ring->shared->head;
+    struct scgi_ring_record *const record = (struct scgi_ring_record*)
+        (ring->data + (head & (ring->capacity-1)));
+    record->size = (uint32_t)size;
+    record->flags = 0;
+    record->tag = tag;
+    scgi_ring_publish(ring, head + (uint32_t)
+                      (sizeof(struct scgi_ring_record)+scgi_ring_align(size)));
+}
+
+int scgi_ring_write (struct scgi_ring * ring, const void * data,
+                     size_t size, uint64_t tag)
+{
+    void *const slot = scgi_ring_reserve(ring, size);
+    if (slot == 0) {
+        return (-1);
+    }
+    memcpy(slot, data, size);
+    scgi_ring_commit(ring, size, tag);
+    return (0);
+}
+
+/* Drop the oldest record, waking the producer if it sleeps. */
+static void scgi_ring_advance (struct scgi_ring * ring,
+                               const struct scgi_ring_record * record)
+{
+    const uint32_t tail = ring->shared->tail + (uint32_t)
+        (sizeof(struct scgi_ring_record) + scgi_ring_align(record->size));
+    __atomic_store_n(&ring->shared->tail, tail, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->shared->writers, __ATOMIC_SEQ_CST)) {
+        scgi_ring_wake(&ring->shared->tail);
+    }
+}
+
+const struct scgi_ring_record * scgi_ring_peek (struct scgi_ring * ring)
+{
+    const struct scgi_ring_record * record = 0;
+    uint32_t tail = 0;
+    for (;;)
+    {
+        tail = ring->shared->tail;
+        if (__atomic_load_n(&ring->shared->head, __ATOMIC_ACQUIRE) == tail) {
+            return (0);
+        }
+        record = (const struct scgi_ring_record*)
+            (ring->data + (tail & (ring->capacity-1)));
+        if ((record->flags & scgi_ring_skip) == 0) {
+            return (record);
+        }
+        scgi_ring_advance(ring, record);
+    }
+}
+
+void scgi_ring_release (struct scgi_ring * ring)
+{
+    const struct scgi_ring_record *const record = scgi_ring_peek(ring);
+    if (record != 0) {
+        scgi_ring_advance(ring, record);
+    }
+}
+
+void scgi_ring_wait_read (struct scgi_ring * ring, int timeout)
+{
+    const uint32_t tail = ring->shared->tail;
+    uint32_t head = __atomic_load_n(&ring->shared->head, __ATOMIC_ACQUIRE);
+    if (head != tail) {
+        return;
+    }
+    __atomic_store_n(&ring->shared->readers, 1, __ATOMIC_SEQ_CST);
+    head = __atomic_load_n(&ring->shared->head, __ATOMIC_SEQ_CST);
+    if (head == tail) {
+        scgi_ring_sleep(&ring->shared->head, head, timeout);
+    }
+    __atomic_store_n(&ring->shared->readers, 0, __ATOMIC_RELAXED);
+}
+
+/* Check for room, accounting for padding up to the end of the ring. */
+static int scgi_ring_fits (const struct scgi_ring * ring, size_t need,
+                           uint32_t head, uint32_t tail)
+{
+    const uint32_t contiguous =
+        ring->capacity - (head & (ring->capacity-1));
+    const size_t room = ring->capacity - (head - tail);
+    return ((need <= contiguous)? (need <= room) : (contiguous+need <= room));
+}
+
+void scgi_ring_wait_write (struct scgi_ring * ring, size_t size,
+                           int timeout)
+{
+    const size_t need = sizeof(struct scgi_ring_record) + scgi_ring_align(size);
+    const uint32_t head = ring->shared->head;
+    uint32_t tail = __atomic_load_n(&ring->shared->tail, __ATOMIC_ACQUIRE);
+    if (scgi_ring_fits(ring, need, head, tail)) {
+        return;
+    }
+    __atomic_store_n(&ring->shared->writers, 1, __ATOMIC_SEQ_CST);
+    tail = __atomic_load_n(&ring->shared->tail, __ATOMIC_SEQ_CST);
+    if (!scgi_ring_fits(ring, need, head, tail)) {
+        scgi_ring_sleep(&ring->shared->tail, tail, timeout);
+    }
+    __atomic_store_n(&ring->shared->writers, 0, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,276 @@
+#ifndef _scgi_ring_h__
+#define _scgi_ring_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Shared-memory rings between a front process and workers (UNIX only).
+ *
+ * A front process does all socket I/O and parsing, and ships each request to
+ * a worker process as a record in a ring in shared memory.  The worker
+ * answers with a record in a second ring.  Workers never touch sockets,
+ * re-parse requests or read from pipes.  Requests are typically written as
+ * blobs (see scgi-blob.h) by the parser's callbacks, straight into a slot
+ * reserved in the ring.
+ *
+ * A region holds several rings, usually two per worker.  It is created by
+ * the front process in a file descriptor (a @c memfd on Linux) that workers
+ * inherit with @c fork() or receive over a UNIX socket (see @c
+ * scgi_send_socket()), so they may be written in any language.  The layout
+ * is:
+ *
+ * - a @c scgi_ring_region_header, padded to 64 bytes; then
+ * - for each ring, a @c scgi_ring_shared followed by @c capacity bytes of
+ *   records.
+ *
+ * Each record is a @c scgi_ring_record followed by its data, padded to a
+ * multiple of 16 bytes.  A record never wraps around the end of a ring.
+ * Positions are free-running 32-bit byte counters.
+ *
+ * Each ring has one producer and one consumer.  Waiting is done with futexes
+ * on Linux, and by polling elsewhere.
+ *
+ * Functions in this module that can fail return -1 and set @c errno.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Header at the start of a region.
+ */
+struct scgi_ring_region_header
+{
+    /*!
+     * @brief Always "SCGIRNG" (null-terminated).
+     */
+    char magic[8];
+
+    /*!
+     * @brief Format version, currently 1.
+     */
+    uint32_t version;
+
+    /*!
+     * @brief Number of rings in the region.
+     */
+    uint32_t count;
+
+    /*!
+     * @brief Size of each ring's records area, in bytes (a power of 2).
+     */
+    uint32_t capacity;
+};
+
+/*!
+ * @brief Ring positions, in shared memory.
+ *
+ * The producer and consumer positions sit on separate cache lines.
+ */
+struct scgi_ring_shared
+{
+    /*!
+     * @brief Bytes written by the producer.  Futex word for the consumer.
+     */
+    uint32_t head;
+
+    /*!
+     * @brief Non-zero while the consumer waits for records.
+     */
+    uint32_t readers;
+
+    char padding1[56];
+
+    /*!
+     * @brief Bytes released by the consumer.  Futex word for the producer.
+     */
+    uint32_t tail;
+
+    /*!
+     * @brief Non-zero while the producer waits for space.
+     */
+    uint32_t writers;
+
+    char padding2[56];
+};
+
+/*!
+ * @brief Record flags.
+ */
+enum scgi_ring_flags
+{
+    /*!
+     * @brief Padding up to the end of the ring.  Consumers skip it.
+     */
+    scgi_ring_skip = 1,
+};
+
+/*!
+ * @brief Record header, followed by @c size bytes of data.
+ */
+struct scgi_ring_record
+{
+    /*!
+     * @brief Size of the data, in bytes, excluding padding.
+     */
+    uint32_t size;
+
+    /*!
+     * @brief Combination of @c scgi_ring_flags values.
+     */
+    uint32_t flags;
+
+    /*!
+     * @brief Identifier chosen by the producer, e.g. a connection number.
+     *
+     * Workers copy it from requests to their responses.
+     */
+    uint64_t tag;
+};
+
+/*!
+ * @brief Mapping of a region of shared memory.
+ */
+struct scgi_ring_region
+{
+    /*!
+     * @public
+     * @brief File descriptor of the shared memory, to pass to workers.
+     */
+    int file;
+
+    /*!
+     * @private
+     * @brief Mapped region.
+     */
+    char * data;
+    size_t size;
+};
+
+/*!
+ * @brief One side of a ring.
+ */
+struct scgi_ring
+{
+    /*!
+     * @private
+     * @brief Positions and records, in the region.
+     */
+    struct scgi_ring_shared * shared;
+    char * data;
+    uint32_t capacity;
+};
+
+/*!
+ * @brief Create a region of shared memory.
+ * @param region Region mapping.
+ * @param count Number of rings.
+ * @param capacity Size of each ring's records, in bytes.  Rounded up to a
+ *  power of 2, and at least 4 KB.
+ */
+int scgi_ring_region_create (struct scgi_ring_region * region,
+                             size_t count, size_t capacity);
+
+/*!
+ * @brief Map a region created by another process.
+ * @param region Region mapping.
+ * @param file File descriptor of the region.  The region takes ownership.
+ */
+int scgi_ring_region_attach (struct scgi_ring_region * region, int file);
+
+/*!
+ * @brief Unmap a region and close its file descriptor.
+ */
+void scgi_ring_region_detach (struct scgi_ring_region * region);
+
+/*!
+ * @brief Get one of the rings in a region.
+ */
+int scgi_ring_open (struct scgi_ring * ring,
+                    const struct scgi_ring_region * region, size_t index);
+
+/*!
+ * @brief Reserve a contiguous slot for the next record (producer).
+ * @param ring Ring.
+ * @param size Maximum size of the record, in bytes.
+ * @return A pointer to the slot, or null with @c errno set to @c EAGAIN if
+ *  the ring is full, or @c EMSGSIZE if the record can never fit.
+ *
+ * Fill the slot, e.g. with a @c scgi_blob_writer, then publish it with @c
+ * scgi_ring_commit().  Only the committed size is used up.
+ */
+void * scgi_ring_reserve (struct scgi_ring * ring, size_t size);
+
+/*!
+ * @brief Publish the record in the reserved slot and wake the consumer.
+ * @param ring Ring.
+ * @param size Actual size of the record, no larger than the reserved size.
+ * @param tag Identifier for the record.
+ */
+void scgi_ring_commit (struct scgi_ring * ring, size_t size, uint64_t tag);
+
+/*!
+ * @brief Copy a record into the ring (producer).
+ */
+int scgi_ring_write (struct scgi_ring * ring, const void * data,
+                     size_t size, uint64_t tag);
+
+/*!
+ * @brief Get the oldest record without removing it (consumer).
+ * @return The record, followed by its data, or null if the ring is empty.
+ *
+ * The record stays valid until @c scgi_ring_release() is called.
+ */
+const struct scgi_ring_record * scgi_ring_peek (struct scgi_ring * ring);
+
+/*!
+ * @brief Remove the record returned by @c scgi_ring_peek() (consumer).
+ */
+void scgi_ring_release (struct scgi_ring * ring);
+
+/*!
+ * @brief Wait for a record (consumer).
+ * @param ring Ring.
+ * @param timeout Maximum delay, in milliseconds, or -1 to wait forever.
+ *
+ * This may return early (e.g. on signals), so check with @c
+ * scgi_ring_peek() afterwards.
+ */
+void scgi_ring_wait_read (struct scgi_ring * ring, int timeout);
+
+/*!
+ * @brief Wait for room for a record of up to @a size bytes (producer).
+ * @see scgi_ring_wait_read()
+ */
+void scgi_ring_wait_write (struct scgi_ring * ring, size_t size,
+                           int timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_ring_h__ */
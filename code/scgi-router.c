@@ -0,0 +1,283 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Early request routing, while the head is still being parsed.
+ */
+
+#include "scgi-router.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int scgi_router_equal (const char * name,
+                              const char * data, size_t size)
+{
+    return ((strlen(name) == size) && (memcmp(name, data, size) == 0));
+}
+
+static size_t scgi_router_common (const char * lhs, size_t lhs_size,
+                                  const char * rhs, size_t rhs_size)
+{
+    size_t i = 0;
+    while ((i < lhs_size) && (i < rhs_size) && (lhs[i] == rhs[i])) {
+        ++i;
+    }
+    return (i);
+}
+
+static struct scgi_router_node * scgi_router_child
+    (const struct scgi_router_node * node, char first)
+{
+    struct scgi_router_node * child = node->child;
+    while ((child != 0) && (child->label[0] != first)) {
+        child = child->sibling;
+    }
+    return (child);
+}
+
+static void scgi_router_append (struct scgi_route ** list,
+                                struct scgi_route * route)
+{
+    while (*list != 0) {
+        list = &(*list)->next;
+    }
+    route->next = 0;
+    *list = route;
+}
+
+static void scgi_router_free (struct scgi_router_node * node)
+{
+    struct scgi_router_node * child = node->child;
+    struct scgi_router_node * next = 0;
+    for (; child != 0; child = next) {
+        next = child->sibling;
+        scgi_router_free(child), free(child);
+    }
+    node->child = 0;
+}
+
+void scgi_router_setup (struct scgi_router * router)
+{
+    router->field = "REQUEST_URI";
+    memset(&router->root, 0, sizeof(router->root));
+}
+
+int scgi_router_add (struct scgi_router * router, struct scgi_route * route)
+{
+    struct scgi_router_node * node = &router->root;
+    struct scgi_router_node * child = 0;
+    struct scgi_router_node * split = 0;
+    const char * path = route->path;
+    size_t size = strlen(path);
+    size_t used = 0;
+    int prefix = 0;
+    if ((size > 0) && (path[size-1] == '*')) {
+        prefix = 1, --size;
+    }
+    while (size > 0)
+    {
+        child = scgi_router_child(node, path[0]);
+        if (child == 0)
+        {
+            /* new leaf for the rest of the path. */
+            child = (struct scgi_router_node*)calloc(1, sizeof(*child));
+            if (child == 0) {
+                return (-1);
+            }
+            child->label = path;
+            child->label_size = size;
+            child->sibling = node->child;
+            node->child = child;
+            node = child;
+            break;
+        }
+        used = scgi_router_common(child->label, child->label_size,
+                                  path, size);
+        if (used < child->label_size)
+        {
+            /* split the edge where the paths diverge. */
+            split = (struct scgi_router_node*)calloc(1, sizeof(*split));
+            if (split == 0) {
+                return (-1);
+            }
+            *split = *child;
+            split->label += used;
+            split->label_size -= used;
+            split->sibling = 0;
+            child->label_size = used;
+            child->child = split;
+            child->exact = 0;
+            child->prefix = 0;
+        }
+        node = child;
+        path += used;
+        size -= used;
+    }
+    scgi_router_append(prefix? &node->prefix : &node->exact, route);
+    return (0);
+}
+
+void scgi_router_release (struct scgi_router * router)
+{
+    scgi_router_free(&router->root);
+}
+
+unsigned int scgi_router_method (const char * data, size_t size)
+{
+    static const struct {
+        const char * name;
+        unsigned int method;
+    } methods[] = {
+        { "GET",     scgi_method_get     },
+        { "HEAD",    scgi_method_head    },
+        { "POST",    scgi_method_post    },
+        { "PUT",     scgi_method_put     },
+        { "DELETE",  scgi_method_delete  },
+        { "PATCH",   scgi_method_patch   },
+        { "OPTIONS", scgi_method_options },
+    };
+    size_t i = 0;
+    for (i = 0; i < sizeof(methods)/sizeof(methods[0]); ++i)
+    {
+        if (scgi_router_equal(methods[i].name, data, size)) {
+            return (methods[i].method);
+        }
+    }
+    return (scgi_method_other);
+}
+
+void scgi_router_reset (struct scgi_router_match * match)
+{
+    match->status = scgi_router_pending;
+    match->route = 0;
+    match->method = 0;
+    match->routed = 0;
+    match->exact = 0;
+    match->prefix = 0;
+}
+
+/* Find the exact routes and the longest prefix routes for a path. */
+static void scgi_router_find (const struct scgi_router * router,
+                              struct scgi_router_match * match,
+                              const char * path, size_t size)
+{
+    const struct scgi_router_node * node = &router->root;
+    const struct scgi_router_node * child = 0;
+    for (;;)
+    {
+        if (node->prefix != 0) {
+            match->prefix = node->prefix;
+        }
+        if (size == 0) {
+            match->exact = node->exact;
+            break;
+        }
+        child = scgi_router_child(node, path[0]);
+        if ((child == 0) || (child->label_size > size) ||
+            (memcmp(child->label, path, child->label_size) != 0))
+        {
+            break;
+        }
+        path += child->label_size;
+        size -= child->label_size;
+        node = child;
+    }
+    match->routed = 1;
+}
+
+static const struct scgi_route * scgi_router_select
+    (const struct scgi_route * route, unsigned int method)
+{
+    while ((route != 0) && ((route->methods & method) == 0)) {
+        route = route->next;
+    }
+    return (route);
+}
+
+int scgi_router_feed (const struct scgi_router * router,
+                      struct scgi_router_match * match,
+                      const char * field, size_t field_size,
+                      const char * value, size_t value_size)
+{
+    const char * query = 0;
+    if (match->status != scgi_router_pending) {
+        return (0);
+    }
+    if (scgi_router_equal("REQUEST_METHOD", field, field_size)) {
+        match->method = scgi_router_method(value, value_size);
+    }
+    else if (scgi_router_equal(router->field, field, field_size))
+    {
+        if (scgi_router_equal("REQUEST_URI", field, field_size) &&
+            ((query = (const char*)memchr(value, '?', value_size)) != 0))
+        {
+            value_size = query - value;
+        }
+        scgi_router_find(router, match, value, value_size);
+    }
+    else {
+        return (0);
+    }
+    if ((match->method == 0) || !match->routed) {
+        return (0);
+    }
+    if ((match->exact == 0) && (match->prefix == 0)) {
+        match->status = scgi_router_not_found;
+        return (1);
+    }
+    match->route = scgi_router_select(match->exact, match->method);
+    if (match->route == 0) {
+        match->route = scgi_router_select(match->prefix, match->method);
+    }
+    match->status = (match->route != 0)?
+        scgi_router_found : scgi_router_method_not_allowed;
+    return (1);
+}
+
+int scgi_router_needs (const struct scgi_router * router,
+                       const struct scgi_router_match * match,
+                       const char * field, size_t size)
+{
+    const char *const * header = 0;
+    if (scgi_router_equal("CONTENT_LENGTH", field, size) ||
+        scgi_router_equal("REQUEST_METHOD", field, size) ||
+        scgi_router_equal(router->field, field, size))
+    {
+        return (1);
+    }
+    if (match->status == scgi_router_pending) {
+        return (1);
+    }
+    if ((match->status != scgi_router_found) ||
+        (match->route->headers == 0))
+    {
+        return (match->status == scgi_router_found);
+    }
+    for (header = match->route->headers; *header != 0; ++header)
+    {
+        if (scgi_router_equal(*header, field, size)) {
+            return (1);
+        }
+    }
+    return (0);
+}
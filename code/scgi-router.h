@@ -0,0 +1,270 @@
+#ifndef _scgi_router_h__
+#define _scgi_router_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Early request routing, while the head is still being parsed.
+ *
+ * Routes are stored in a compressed radix tree over the request path
+ * ("REQUEST_URI" without the query string, or "PATH_INFO").  The router is
+ * fed each header from the @c finish_value callback and picks a route as
+ * soon as both the path and "REQUEST_METHOD" are known, so the application
+ * can start work (e.g. open a backend connection) while the rest of the
+ * request is still arriving.  Once routed, the application can ask whether
+ * a remaining header is used by the route and skip buffering it if not.
+ *
+ * Building the router allocates memory, matching does not.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Request methods, as bits of a route's method mask.
+ */
+enum scgi_method
+{
+    scgi_method_get     = 0x01,
+    scgi_method_head    = 0x02,
+    scgi_method_post    = 0x04,
+    scgi_method_put     = 0x08,
+    scgi_method_delete  = 0x10,
+    scgi_method_patch   = 0x20,
+    scgi_method_options = 0x40,
+    scgi_method_other   = 0x80,
+    scgi_method_any     = 0xff,
+};
+
+/*!
+ * @brief Application-defined route.
+ *
+ * Routes are referenced, not copied, by the router, so they must outlive it.
+ */
+struct scgi_route
+{
+    /*!
+     * @public
+     * @brief Path to match.
+     *
+     * A trailing '*' matches any suffix, e.g. "/static/" followed by '*'
+     * matches "/static/app.js".  Otherwise, the path must match exactly.
+     * The longest matching path wins.
+     */
+    const char * path;
+
+    /*!
+     * @public
+     * @brief Combination of @c scgi_method values.
+     */
+    unsigned int methods;
+
+    /*!
+     * @public
+     * @brief Null-terminated list of headers used by the handler.
+     *
+     * When null, the handler uses all headers.
+     */
+    const char *const * headers;
+
+    /*!
+     * @public
+     * @brief Application data, usually the handler.
+     */
+    void * object;
+
+    /*!
+     * @private
+     * @brief Next route for the same path.
+     */
+    struct scgi_route * next;
+};
+
+/*!
+ * @private
+ * @brief Radix tree node.
+ */
+struct scgi_router_node
+{
+    /*!
+     * @brief Path bytes between the parent and this node.
+     *
+     * Points into a route's path.
+     */
+    const char * label;
+    size_t label_size;
+
+    /*!
+     * @brief First child, and next child of the same parent.
+     */
+    struct scgi_router_node * child;
+    struct scgi_router_node * sibling;
+
+    /*!
+     * @brief Routes that end exactly at this node.
+     */
+    struct scgi_route * exact;
+
+    /*!
+     * @brief Routes that match any path below this node.
+     */
+    struct scgi_route * prefix;
+};
+
+/*!
+ * @brief Route table.
+ */
+struct scgi_router
+{
+    /*!
+     * @public
+     * @brief Name of the header holding the path.
+     *
+     * Defaults to "REQUEST_URI", from which the query string is stripped.
+     * Set to "PATH_INFO" when the application is mounted below a prefix.
+     */
+    const char * field;
+
+    /*!
+     * @private
+     * @brief Radix tree root, for the empty path.
+     */
+    struct scgi_router_node root;
+};
+
+/*!
+ * @brief Outcome of routing a request.
+ */
+enum scgi_router_status
+{
+    /*!
+     * @brief The path or the method is still missing.
+     */
+    scgi_router_pending,
+
+    /*!
+     * @brief A route was found (see @c scgi_router_match::route).
+     */
+    scgi_router_found,
+
+    /*!
+     * @brief No route for the path.
+     */
+    scgi_router_not_found,
+
+    /*!
+     * @brief Routes exist for the path, but not for the method.
+     */
+    scgi_router_method_not_allowed,
+};
+
+/*!
+ * @brief Routing state for one request, usually in a connection object.
+ */
+struct scgi_router_match
+{
+    /*!
+     * @public
+     * @brief Routing progress.
+     */
+    enum scgi_router_status status;
+
+    /*!
+     * @public
+     * @brief Selected route, when @c status is @c scgi_router_found.
+     */
+    const struct scgi_route * route;
+
+    /*!
+     * @public
+     * @brief Request method, as a @c scgi_method value (0 until known).
+     */
+    unsigned int method;
+
+    /*!
+     * @private
+     * @brief Routes matching the path, once known.
+     */
+    int routed;
+    const struct scgi_route * exact;
+    const struct scgi_route * prefix;
+};
+
+/*!
+ * @brief Initialize an empty router.
+ */
+void scgi_router_setup (struct scgi_router * router);
+
+/*!
+ * @brief Add a route.
+ * @return 0 on success, -1 if out of memory.
+ */
+int scgi_router_add (struct scgi_router * router, struct scgi_route * route);
+
+/*!
+ * @brief Release the radix tree (routes themselves are not touched).
+ */
+void scgi_router_release (struct scgi_router * router);
+
+/*!
+ * @brief Parse a "REQUEST_METHOD" value.
+ * @return A single @c scgi_method bit.
+ */
+unsigned int scgi_router_method (const char * data, size_t size);
+
+/*!
+ * @brief Prepare to route a new request.
+ */
+void scgi_router_reset (struct scgi_router_match * match);
+
+/*!
+ * @brief Feed a complete header to the router.
+ * @return Non-zero if this header completed routing.
+ *
+ * Call this from the @c finish_value callback.  Headers other than the
+ * method and path are ignored.
+ */
+int scgi_router_feed (const struct scgi_router * router,
+                      struct scgi_router_match * match,
+                      const char * field, size_t field_size,
+                      const char * value, size_t value_size);
+
+/*!
+ * @brief Check whether the application needs a header's value.
+ *
+ * Call this from the @c finish_field callback to decide whether to buffer
+ * the value.  Until routing is done, all headers are needed.
+ * "CONTENT_LENGTH" and the routing headers are always needed.
+ */
+int scgi_router_needs (const struct scgi_router * router,
+                       const struct scgi_router_match * match,
+                       const char * field, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_router_h__ */
@@ -0,0 +1,214 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Per-client rate limiting (UNIX only).
+ */
+
+#include "scgi-throttle.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Buckets per set: one cache line. */
+#define SCGI_THROTTLE_WAYS 4
+
+/* Bucket state: refill time above, tokens (1/256ths) below. */
+#define SCGI_THROTTLE_TOKEN 256u
+#define SCGI_THROTTLE_SHIFT 24
+#define SCGI_THROTTLE_TOKENS(state) ((state) & ((1u << SCGI_THROTTLE_SHIFT)-1))
+#define SCGI_THROTTLE_TIME(state) ((state) >> SCGI_THROTTLE_SHIFT)
+#define SCGI_THROTTLE_STATE(time, tokens) \
+    (((time) << SCGI_THROTTLE_SHIFT) | (tokens))
+
+#if defined(CLOCK_MONOTONIC_COARSE)
+# define SCGI_THROTTLE_CLOCK CLOCK_MONOTONIC_COARSE
+#else
+# define SCGI_THROTTLE_CLOCK CLOCK_MONOTONIC
+#endif
+
+static const char scgi_throttle_response[] =
+    "Status: 429 Too Many Requests\r\n"
+    "Content-Type: text/plain\r\n"
+    "Retry-After: 1\r\n"
+    "Content-Length: 18\r\n"
+    "\r\n"
+    "Too many requests\n";
+
+/* milliseconds on the monotonic clock. */
+static uint64_t scgi_throttle_now ()
+{
+    struct timespec now;
+    clock_gettime(SCGI_THROTTLE_CLOCK, &now);
+    return ((uint64_t)now.tv_sec*1000u + (uint64_t)now.tv_nsec/1000000u);
+}
+
+/* FNV-1a. */
+static uint64_t scgi_throttle_hash (const char * data, size_t size)
+{
+    uint64_t hash = 14695981039346656037u;
+    size_t i = 0;
+    for (i = 0; i < size; ++i) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211u;
+    }
+    return ((hash == 0)? 1 : hash);
+}
+
+int scgi_throttle_setup (struct scgi_throttle * throttle, size_t clients,
+                         unsigned int rate, unsigned int burst)
+{
+    const size_t size = sizeof(struct scgi_throttle_slot)*SCGI_THROTTLE_WAYS;
+    size_t sets = 1;
+    void * slots = 0;
+    if ((clients == 0) || (rate == 0) || (burst == 0) || (burst > 65535)) {
+        errno = EINVAL;
+        return (-1);
+    }
+    while (sets*SCGI_THROTTLE_WAYS < clients) {
+        sets *= 2;
+    }
+    if (posix_memalign(&slots, size, sets*size) != 0) {
+        errno = ENOMEM;
+        return (-1);
+    }
+    memset(slots, 0, sets*size);
+    throttle->field = "REMOTE_ADDR";
+    throttle->response = scgi_throttle_response;
+    throttle->response_size = sizeof(scgi_throttle_response)-1;
+    throttle->rate = (uint64_t)rate * SCGI_THROTTLE_TOKEN;
+    throttle->burst = (uint64_t)burst * SCGI_THROTTLE_TOKEN;
+    throttle->fill = (throttle->burst*1000 + throttle->rate-1) /
+        throttle->rate;
+    throttle->epoch = scgi_throttle_now();
+    throttle->slots = (struct scgi_throttle_slot*)slots;
+    throttle->mask = sets - 1;
+    return (0);
+}
+
+void scgi_throttle_release (struct scgi_throttle * throttle)
+{
+    free(throttle->slots);
+    throttle->slots = 0;
+}
+
+int scgi_throttle_is_field (const struct scgi_throttle * throttle,
+                            const char * field, size_t size)
+{
+    return ((strlen(throttle->field) == size) &&
+            (memcmp(throttle->field, field, size) == 0));
+}
+
+static int scgi_throttle_take (struct scgi_throttle * throttle,
+                               struct scgi_throttle_slot * slot, uint64_t now)
+{
+    uint64_t state = __atomic_load_n(&slot->state, __ATOMIC_RELAXED);
+    uint64_t time = 0;
+    uint64_t tokens = 0;
+    uint64_t added = 0;
+    int admitted = 0;
+    do {
+        time = SCGI_THROTTLE_TIME(state);
+        tokens = SCGI_THROTTLE_TOKENS(state);
+        if (now > time)
+        {
+            if ((now - time) >= throttle->fill) {
+                tokens = throttle->burst, time = now;
+            }
+            else
+            {
+                /* move the time to this access, keeping the part of a
+                   token still pending (to the millisecond). */
+                added = (now - time)*throttle->rate;
+                tokens += added / 1000;
+                time = now - (added % 1000) / throttle->rate;
+                if (tokens > throttle->burst) {
+                    tokens = throttle->burst;
+                }
+            }
+        }
+        /* refused requests count as an access too. */
+        admitted = (tokens >= SCGI_THROTTLE_TOKEN);
+        if (admitted) {
+            tokens -= SCGI_THROTTLE_TOKEN;
+        }
+    }
+    while (!__atomic_compare_exchange_n(
+               &slot->state, &state, SCGI_THROTTLE_STATE(time, tokens),
+               1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return (admitted);
+}
+
+int scgi_throttle_admit (struct scgi_throttle * throttle,
+                         const char * key, size_t size)
+{
+    return (scgi_throttle_admit_at(throttle, key, size,
+                                   scgi_throttle_now() - throttle->epoch));
+}
+
+int scgi_throttle_admit_at (struct scgi_throttle * throttle,
+                            const char * key, size_t size, uint64_t now)
+{
+    const uint64_t hash = scgi_throttle_hash(key, size);
+    struct scgi_throttle_slot *const set =
+        &throttle->slots[(hash & throttle->mask)*SCGI_THROTTLE_WAYS];
+    uint64_t victim_key = 0;
+    uint64_t victim_time = 0;
+    uint64_t current = 0;
+    uint64_t time = 0;
+    size_t victim = 0;
+    size_t attempt = 0;
+    size_t i = 0;
+    /* time 0 is reserved for unused buckets. */
+    ++now;
+    for (attempt = 0; attempt < SCGI_THROTTLE_WAYS; ++attempt)
+    {
+        victim_time = (uint64_t)-1;
+        for (i = 0; i < SCGI_THROTTLE_WAYS; ++i)
+        {
+            current = __atomic_load_n(&set[i].key, __ATOMIC_ACQUIRE);
+            if (current == hash) {
+                return (scgi_throttle_take(throttle, &set[i], now));
+            }
+            /* approximate LRU: the least recently accessed bucket. */
+            time = SCGI_THROTTLE_TIME(
+                __atomic_load_n(&set[i].state, __ATOMIC_RELAXED));
+            if (time < victim_time) {
+                victim = i, victim_key = current, victim_time = time;
+            }
+        }
+        /* new client: start with a full bucket, minus this request. */
+        if (__atomic_compare_exchange_n(&set[victim].key, &victim_key, hash,
+                                        0, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_RELAXED))
+        {
+            __atomic_store_n(&set[victim].state,
+                             SCGI_THROTTLE_STATE(now, throttle->burst -
+                                                 SCGI_THROTTLE_TOKEN),
+                             __ATOMIC_RELEASE);
+            return (1);
+        }
+    }
+    /* heavy contention on the set: let the request through. */
+    return (1);
+}
@@ -0,0 +1,169 @@
+#ifndef _scgi_throttle_h__
+#define _scgi_throttle_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Per-client rate limiting (UNIX only).
+ *
+ * Each client, identified by the value of a header ("REMOTE_ADDR" unless
+ * configured otherwise), gets a token bucket: requests take one token and
+ * tokens come back at a fixed rate, up to a burst size.  Check the client
+ * from the @c finish_value callback, as soon as its header is parsed, and
+ * answer limited requests with the pre-serialized response without reading
+ * the body or running a handler.
+ *
+ * Buckets live in a fixed-size table of cache-line sized sets.  A client
+ * only ever touches its own set, and each bucket is a single word updated
+ * with compare-and-swap, so checks never take a lock.  Every check, admitted
+ * or not, counts as an access.  When a set is full, the least recently
+ * accessed bucket is reused: a client that was evicted comes back with a
+ * full bucket, but a client that keeps sending refused requests is not
+ * evicted.
+ *
+ * Functions in this module that can fail return -1 and set @c errno.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @private
+ * @brief Token bucket of one client.
+ */
+struct scgi_throttle_slot
+{
+    /*!
+     * @brief Hash of the client's key, 0 if unused.
+     */
+    uint64_t key;
+
+    /*!
+     * @brief Time of the last access (milliseconds, less any refill still
+     *  pending) and tokens left (1/256ths), packed for compare-and-swap.
+     */
+    uint64_t state;
+};
+
+/*!
+ * @brief Per-client rate limiter.
+ */
+struct scgi_throttle
+{
+    /*!
+     * @public
+     * @brief Name of the header that identifies clients.
+     */
+    const char * field;
+
+    /*!
+     * @public
+     * @brief Response sent to limited clients, in full.
+     *
+     * Defaults to "429 Too Many Requests", with a "Retry-After" header.
+     */
+    const char * response;
+    size_t response_size;
+
+    /*!
+     * @private
+     * @brief Tokens added per second, in 1/256ths.
+     */
+    uint64_t rate;
+
+    /*!
+     * @private
+     * @brief Time to fill an empty bucket, in milliseconds.
+     */
+    uint64_t fill;
+
+    /*!
+     * @private
+     * @brief Maximum number of tokens, in 1/256ths.
+     */
+    uint64_t burst;
+
+    /*!
+     * @private
+     * @brief Start of the throttle's clock, on the monotonic clock.
+     */
+    uint64_t epoch;
+
+    /*!
+     * @private
+     * @brief Bucket sets, and the number of sets minus one.
+     */
+    struct scgi_throttle_slot * slots;
+    size_t mask;
+};
+
+/*!
+ * @brief Initialize a rate limiter.
+ * @param throttle Rate limiter.
+ * @param clients Number of clients to keep track of.
+ * @param rate Requests allowed per second, on average.
+ * @param burst Requests allowed at once, at most 65535.
+ */
+int scgi_throttle_setup (struct scgi_throttle * throttle, size_t clients,
+                         unsigned int rate, unsigned int burst);
+
+/*!
+ * @brief Release the table.  No other thread may use the rate limiter.
+ */
+void scgi_throttle_release (struct scgi_throttle * throttle);
+
+/*!
+ * @brief Check if a header identifies clients.
+ */
+int scgi_throttle_is_field (const struct scgi_throttle * throttle,
+                            const char * field, size_t size);
+
+/*!
+ * @brief Take a token from a client's bucket.  Never blocks.
+ * @param throttle Rate limiter.
+ * @param key Value of the header that identifies the client.
+ * @param size Size of @a key, in bytes.
+ * @return 1 if the request may proceed, 0 if it should be refused.
+ */
+int scgi_throttle_admit (struct scgi_throttle * throttle,
+                         const char * key, size_t size);
+
+/*!
+ * @brief Take a token from a client's bucket, at a given time.
+ * @param now Milliseconds since the rate limiter was set up.
+ *
+ * Same as @c scgi_throttle_admit(), for callers that keep their own clock.
+ * Times must not go backwards by more than a few milliseconds.
+ */
+int scgi_throttle_admit_at (struct scgi_throttle * throttle,
+                            const char * key, size_t size, uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_throttle_h__ */
@@ -0,0 +1,155 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Hierarchical timer wheel for connection deadlines.
+ */
+
+#include "scgi-timer.h"
+#include <string.h>
+
+#define SCGI_TIMER_BITS 6
+#define SCGI_TIMER_MASK (SCGI_TIMER_SLOTS-1)
+#define SCGI_TIMER_RANGE \
+    ((uint64_t)1 << (SCGI_TIMER_BITS*SCGI_TIMER_LEVELS))
+
+/* Link a timer into the slot for its deadline, relative to the wheel. */
+static void scgi_timer_place (struct scgi_timer_wheel * wheel,
+                              struct scgi_timer * timer)
+{
+    uint64_t expires = timer->expires;
+    uint64_t delta = expires - wheel->now;
+    struct scgi_timer ** slot = 0;
+    size_t level = 0;
+    /* far deadlines wait in the last level and are placed again later. */
+    if (delta >= SCGI_TIMER_RANGE) {
+        expires = wheel->now + SCGI_TIMER_RANGE - 1;
+        delta = SCGI_TIMER_RANGE - 1;
+    }
+    while (delta >= ((uint64_t)1 << (SCGI_TIMER_BITS*(level+1)))) {
+        ++level;
+    }
+    slot = &wheel->slots[level]
+        [(expires >> (SCGI_TIMER_BITS*level)) & SCGI_TIMER_MASK];
+    timer->next = *slot;
+    if (timer->next != 0) {
+        timer->next->link = &timer->next;
+    }
+    timer->link = slot;
+    *slot = timer;
+}
+
+static void scgi_timer_unlink (struct scgi_timer * timer)
+{
+    *timer->link = timer->next;
+    if (timer->next != 0) {
+        timer->next->link = timer->link;
+    }
+    timer->next = 0;
+    timer->link = 0;
+}
+
+/* Move the timers of a coarse slot down to finer levels. */
+static void scgi_timer_cascade (struct scgi_timer_wheel * wheel,
+                                size_t level, size_t index)
+{
+    struct scgi_timer * timer = wheel->slots[level][index];
+    struct scgi_timer * next = 0;
+    wheel->slots[level][index] = 0;
+    for (; timer != 0; timer = next) {
+        next = timer->next;
+        scgi_timer_place(wheel, timer);
+    }
+}
+
+void scgi_timer_wheel_setup (struct scgi_timer_wheel * wheel, uint64_t now)
+{
+    wheel->now = now;
+    wheel->count = 0;
+    memset(wheel->slots, 0, sizeof(wheel->slots));
+}
+
+size_t scgi_timer_wheel_advance (struct scgi_timer_wheel * wheel,
+                                 uint64_t now)
+{
+    struct scgi_timer * timer = 0;
+    size_t expired = 0;
+    size_t level = 0;
+    size_t index = 0;
+    while (wheel->now < now)
+    {
+        /* nothing to expire: jump ahead. */
+        if (wheel->count == 0) {
+            wheel->now = now;
+            break;
+        }
+        ++wheel->now;
+        index = wheel->now & SCGI_TIMER_MASK;
+        for (level = 1; (index == 0) && (level < SCGI_TIMER_LEVELS); ++level)
+        {
+            index = (wheel->now >> (SCGI_TIMER_BITS*level)) & SCGI_TIMER_MASK;
+            scgi_timer_cascade(wheel, level, index);
+        }
+        index = wheel->now & SCGI_TIMER_MASK;
+        while ((timer = wheel->slots[0][index]) != 0)
+        {
+            scgi_timer_unlink(timer);
+            --wheel->count;
+            ++expired;
+            timer->expire(timer);
+        }
+    }
+    return (expired);
+}
+
+void scgi_timer_setup (struct scgi_timer * timer,
+                       void(*expire)(struct scgi_timer*))
+{
+    timer->next = 0;
+    timer->link = 0;
+    timer->expires = 0;
+    timer->expire = expire;
+}
+
+void scgi_timer_start (struct scgi_timer_wheel * wheel,
+                       struct scgi_timer * timer, uint64_t delay)
+{
+    scgi_timer_stop(wheel, timer);
+    timer->expires = wheel->now + ((delay > 0)? delay : 1);
+    scgi_timer_place(wheel, timer);
+    ++wheel->count;
+}
+
+void scgi_timer_stop (struct scgi_timer_wheel * wheel,
+                      struct scgi_timer * timer)
+{
+    if (timer->link != 0) {
+        scgi_timer_unlink(timer);
+        --wheel->count;
+    }
+}
+
+int scgi_timer_running (const struct scgi_timer * timer)
+{
+    return (timer->link != 0);
+}
@@ -0,0 +1,149 @@
+#ifndef _scgi_timer_h__
+#define _scgi_timer_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Hierarchical timer wheel for connection deadlines.
+ *
+ * Timers are embedded in connection objects, so arming and stopping them
+ * never allocates, and both are O(1).  The wheel has four levels of 64
+ * slots: timers due within 64 ticks sit in the first level, later ones in
+ * coarser levels and move down as their deadline approaches.  The I/O loop
+ * advances the wheel once per iteration, and no kernel timer is used.
+ *
+ * Time is measured in ticks, whose length is chosen by the application
+ * (e.g. 100 ms).  Deadlines beyond 2^24 ticks are supported, but are
+ * re-examined every 2^24 ticks.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Number of wheel levels.
+ */
+#define SCGI_TIMER_LEVELS 4
+
+/*!
+ * @brief Number of slots per level (a power of 2).
+ */
+#define SCGI_TIMER_SLOTS 64
+
+/*!
+ * @brief Deadline, usually embedded in a connection object.
+ */
+struct scgi_timer
+{
+    /*!
+     * @private
+     * @brief Links in the wheel slot.  @c link is null when stopped.
+     */
+    struct scgi_timer * next;
+    struct scgi_timer ** link;
+
+    /*!
+     * @public
+     * @brief Tick at which the timer expires.
+     */
+    uint64_t expires;
+
+    /*!
+     * @brief Callback run by @c scgi_timer_wheel_advance() on expiry.
+     *
+     * The timer is stopped before the callback runs, which may restart it.
+     */
+    void(*expire)(struct scgi_timer*);
+};
+
+/*!
+ * @brief Timer wheel, one per I/O thread.
+ */
+struct scgi_timer_wheel
+{
+    /*!
+     * @public
+     * @brief Current tick.
+     */
+    uint64_t now;
+
+    /*!
+     * @public
+     * @brief Number of running timers.
+     */
+    size_t count;
+
+    /*!
+     * @private
+     * @brief Running timers, by level and by slot.
+     */
+    struct scgi_timer * slots[SCGI_TIMER_LEVELS][SCGI_TIMER_SLOTS];
+};
+
+/*!
+ * @brief Initialize an empty wheel, starting at tick @a now.
+ */
+void scgi_timer_wheel_setup (struct scgi_timer_wheel * wheel, uint64_t now);
+
+/*!
+ * @brief Run the @c expire callback of all timers due up to tick @a now.
+ * @return Number of expired timers.
+ */
+size_t scgi_timer_wheel_advance (struct scgi_timer_wheel * wheel,
+                                 uint64_t now);
+
+/*!
+ * @brief Prepare a timer, stopped.
+ */
+void scgi_timer_setup (struct scgi_timer * timer,
+                       void(*expire)(struct scgi_timer*));
+
+/*!
+ * @brief (Re)start a timer to expire @a delay ticks from now.
+ *
+ * A running timer is moved to its new deadline.  A zero delay expires on
+ * the next tick.
+ */
+void scgi_timer_start (struct scgi_timer_wheel * wheel,
+                       struct scgi_timer * timer, uint64_t delay);
+
+/*!
+ * @brief Stop a timer.  Has no effect if the timer is not running.
+ */
+void scgi_timer_stop (struct scgi_timer_wheel * wheel,
+                      struct scgi_timer * timer);
+
+/*!
+ * @brief Check whether a timer is running.
+ */
+int scgi_timer_running (const struct scgi_timer * timer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_timer_h__ */
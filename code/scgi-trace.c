@@ -0,0 +1,198 @@
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @internal
+ * @file
+ * @brief Sampled request tracing (UNIX only).
+ */
+
+#include "scgi-trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Events recorded by one thread.  Rings outlive their thread, so that its
+   events can still be saved. */
+struct scgi_trace_ring
+{
+    struct scgi_trace_ring * next;
+    uint32_t thread;
+    uint64_t written;
+    size_t mask;
+    struct scgi_trace_entry * records;
+};
+
+static const char scgi_trace_magic[8] = "SCGITRC";
+
+static const char * scgi_trace_names[] =
+{
+    "consume",
+    "field",
+    "value",
+    "head",
+    "body",
+    "error",
+    "handler",
+    "handler",
+};
+
+static unsigned int scgi_trace_rate = 0;
+static size_t scgi_trace_capacity = 0;
+static uint64_t scgi_trace_requests = 0;
+static uint32_t scgi_trace_threads = 0;
+static struct scgi_trace_ring * scgi_trace_rings = 0;
+
+static __thread struct scgi_trace_ring * scgi_trace_local = 0;
+static __thread unsigned int scgi_trace_skipped = 0;
+
+void scgi_trace_setup (unsigned int rate, size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+    scgi_trace_capacity = size;
+    __atomic_store_n(&scgi_trace_rate, rate, __ATOMIC_RELEASE);
+}
+
+uint64_t scgi_trace_sample (void)
+{
+    const unsigned int rate =
+        __atomic_load_n(&scgi_trace_rate, __ATOMIC_RELAXED);
+    if ((rate == 0) || (++scgi_trace_skipped < rate)) {
+        return (0);
+    }
+    scgi_trace_skipped = 0;
+    return (__atomic_add_fetch(&scgi_trace_requests, 1, __ATOMIC_RELAXED));
+}
+
+/* Create the calling thread's ring and publish it. */
+static struct scgi_trace_ring * scgi_trace_attach (void)
+{
+    struct scgi_trace_ring * ring =
+        (struct scgi_trace_ring*)malloc(sizeof(struct scgi_trace_ring));
+    if (ring == 0) {
+        return (0);
+    }
+    ring->records = (struct scgi_trace_entry*)malloc(
+        scgi_trace_capacity*sizeof(struct scgi_trace_entry));
+    if (ring->records == 0) {
+        free(ring);
+        return (0);
+    }
+    ring->thread = __atomic_add_fetch(&scgi_trace_threads, 1,
+                                      __ATOMIC_RELAXED);
+    ring->written = 0;
+    ring->mask = scgi_trace_capacity - 1;
+    ring->next = __atomic_load_n(&scgi_trace_rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&scgi_trace_rings, &ring->next, ring,
+                                        1, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED)) {
+    }
+    scgi_trace_local = ring;
+    return (ring);
+}
+
+void scgi_trace_record (uint64_t request, enum scgi_trace_event event,
+                        uint64_t size)
+{
+    struct scgi_trace_ring * ring = scgi_trace_local;
+    struct scgi_trace_entry * record = 0;
+    struct timespec now;
+    if (request == 0) {
+        return;
+    }
+    if ((ring == 0) && ((ring = scgi_trace_attach()) == 0)) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    record = &ring->records[ring->written & ring->mask];
+    record->time = (uint64_t)now.tv_sec*1000000000u + (uint64_t)now.tv_nsec;
+    record->request = request;
+    record->thread = ring->thread;
+    record->event = event;
+    record->size = size;
+    __atomic_store_n(&ring->written, ring->written+1, __ATOMIC_RELEASE);
+}
+
+/* Number of events kept by a ring. */
+static uint64_t scgi_trace_kept (const struct scgi_trace_ring * ring,
+                                 uint64_t written)
+{
+    return ((written > ring->mask)? ring->mask+1 : written);
+}
+
+int scgi_trace_save (const char * path)
+{
+    struct scgi_trace_header header;
+    const struct scgi_trace_ring *const rings =
+        __atomic_load_n(&scgi_trace_rings, __ATOMIC_ACQUIRE);
+    const struct scgi_trace_ring * ring = 0;
+    uint64_t written = 0;
+    uint64_t i = 0;
+    int status = 0;
+    FILE *const file = fopen(path, "wb");
+    if (file == 0) {
+        return (-1);
+    }
+    memcpy(header.magic, scgi_trace_magic, sizeof(header.magic));
+    header.version = 1;
+    header.count = 0;
+    for (ring = rings; ring != 0; ring = ring->next) {
+        written = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE);
+        header.count += (uint32_t)scgi_trace_kept(ring, written);
+    }
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        status = -1;
+    }
+    /* oldest events first.  A ring may have moved on since it was counted,
+       so write exactly as many events as announced. */
+    for (ring = rings; (ring != 0) && (status == 0); ring = ring->next)
+    {
+        written = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE);
+        for (i = written-scgi_trace_kept(ring, written); i < written; ++i)
+        {
+            if (header.count-- == 0) {
+                break;
+            }
+            if (fwrite(&ring->records[i & ring->mask],
+                       sizeof(struct scgi_trace_entry), 1, file) != 1) {
+                status = -1;
+                break;
+            }
+        }
+    }
+    if (fclose(file) != 0) {
+        status = -1;
+    }
+    return (status);
+}
+
+const char * scgi_trace_name (enum scgi_trace_event event)
+{
+    if ((size_t)event >=
+        (sizeof(scgi_trace_names) / sizeof(scgi_trace_names[0]))) {
+        return ("unknown");
+    }
+    return (scgi_trace_names[event]);
+}
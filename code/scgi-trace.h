@@ -0,0 +1,156 @@
+#ifndef _scgi_trace_h__
+#define _scgi_trace_h__
+
+/* Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+** THE SOFTWARE.
+*/
+
+/*!
+ * @file
+ * @brief Sampled request tracing (UNIX only).
+ *
+ * When the library is built with @c SCGI_TRACE defined (the @c CSCGI_TRACE
+ * CMake option), the parser records timestamped events for a sample of
+ * requests: each call to @c scgi_consume(), the end of each header name and
+ * value, the end of the head, body chunks and errors.  Applications may add
+ * their own events, such as the start and end of the handler.
+ *
+ * Events go into a ring buffer owned by the recording thread, so recording
+ * takes no lock.  When a ring is full, the oldest events are overwritten.
+ * Requests that are not sampled cost one thread-local counter update.
+ *
+ * @c scgi_trace_save() writes all rings to a file, which the @c
+ * scgi-trace-dump tool converts to Chrome trace JSON for chrome://tracing or
+ * Perfetto.  Events recorded while the file is being saved may be torn.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * @brief Kinds of trace events.
+ */
+enum scgi_trace_event
+{
+    scgi_trace_consume=0,
+    scgi_trace_field,
+    scgi_trace_value,
+    scgi_trace_head,
+    scgi_trace_body,
+    scgi_trace_error,
+    scgi_trace_handler_begin,
+    scgi_trace_handler_end,
+};
+
+/*!
+ * @brief Trace event, as stored in rings and trace files.
+ */
+struct scgi_trace_entry
+{
+    /*!
+     * @brief Time of the event, on the monotonic clock (nanoseconds).
+     */
+    uint64_t time;
+
+    /*!
+     * @brief Identifier of the request, from @c scgi_trace_sample().
+     */
+    uint64_t request;
+
+    /*!
+     * @brief Identifier of the recording thread (1, 2, 3...).
+     */
+    uint32_t thread;
+
+    /*!
+     * @brief One of the @c scgi_trace_event values.
+     */
+    uint32_t event;
+
+    /*!
+     * @brief Size of the data, or error code, depending on the event.
+     */
+    uint64_t size;
+};
+
+/*!
+ * @brief Trace file header, followed by @c count records.
+ */
+struct scgi_trace_header
+{
+    /*!
+     * @brief Always "SCGITRC" (null-terminated).
+     */
+    char magic[8];
+
+    /*!
+     * @brief Format version, currently 1.
+     */
+    uint32_t version;
+
+    /*!
+     * @brief Number of records.
+     */
+    uint32_t count;
+};
+
+/*!
+ * @brief Start tracing.  Call this before any thread records events.
+ * @param rate Trace one request out of @a rate, or none if 0.
+ * @param capacity Number of events kept by each thread (rounded up to a
+ *  power of 2).
+ */
+void scgi_trace_setup (unsigned int rate, size_t capacity);
+
+/*!
+ * @brief Decide whether to trace a new request.
+ * @return An identifier for the request, or 0 if it is not traced.
+ */
+uint64_t scgi_trace_sample (void);
+
+/*!
+ * @brief Record an event for a traced request.
+ * @param request Identifier from @c scgi_trace_sample(), ignored if 0.
+ * @param event One of the @c scgi_trace_event values.
+ * @param size Size of the data, or error code, depending on the event.
+ */
+void scgi_trace_record (uint64_t request, enum scgi_trace_event event,
+                        uint64_t size);
+
+/*!
+ * @brief Write the events of all threads to a file.
+ */
+int scgi_trace_save (const char * path);
+
+/*!
+ * @brief Get the name of an event, as shown in traces ("unknown" for values
+ *  outside @c scgi_trace_event).
+ */
+const char * scgi_trace_name (enum scgi_trace_event event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _scgi_trace_h__ */
@@ -29,11 +29,53 @@
 #include <ctype.h>
 #include <string.h>
 
+#if defined(__SSE2__) && defined(__GNUC__)
+# include <emmintrin.h>
+# define SCGI_SSE2 1
+#endif
+
+#ifdef SCGI_TRACE
+# include "scgi-trace.h"
+# define SCGI_TRACE_EVENT(parser, event, size)                   \
+    do {                                                         \
+        if ((parser)->trace != 0) {                              \
+            scgi_trace_record((parser)->trace, (event), (size)); \
+        }                                                        \
+    } while (0)
+#else
+# define SCGI_TRACE_EVENT(parser, event, size) do {} while (0)
+#endif
+
+/* strict mode checks (see scgi_parser::checks). */
+#define SCGI_CHECK_START 1 /* first call to scgi_consume() seen. */
+#define SCGI_CHECK_WHOLE 2 /* head validated in a single pass. */
+#define SCGI_CHECK_MATCH 4 /* current header is the one we look for. */
+#define SCGI_CHECK_SCGI  8 /* found "SCGI" with value "1". */
+#define SCGI_CHECK_LENGTH 16 /* content_length is known. */
+#define SCGI_CHECK_DONE  32 /* scgi_event_done was returned. */
+#define SCGI_CHECK_TRACE 64 /* request was sampled for tracing. */
+
+/* netstring framing stages (see scgi_parser::frame). */
+#define SCGI_FRAME_SIZE 0
+#define SCGI_FRAME_DATA 1
+#define SCGI_FRAME_END  2
+
 static size_t scgi_min (size_t lhs, size_t rhs)
 {
     return ((lhs < rhs)? lhs : rhs);
 }
 
+/* Append a decimal digit to a number, unless it would exceed limit. */
+static int scgi_push_digit (size_t * value, char digit, size_t limit)
+{
+    const size_t next = (size_t)(digit-'0');
+    if (*value > ((limit-next) / 10)) {
+        return (0);
+    }
+    *value = (*value * 10) + next;
+    return (1);
+}
+
 static const char * scgi_error_messages[] =
 {
     "so far, so good",
@@ -56,6 +98,244 @@ static size_t scgi_seek (const char * data, size_t size)
     return (peek);
 }
 
+/* Running state of the single pass validation. */
+struct scgi_scan
+{
+    size_t count;
+    size_t start;
+    size_t field;
+    size_t field_size;
+    int scgi;
+};
+
+/* Check the header name or value ending at the null byte at @a end. */
+static int scgi_scan_token (struct scgi_scan * scan,
+                            const char * data, size_t end)
+{
+    const char *const token = data + scan->start;
+    const size_t size = end - scan->start;
+    if ((scan->count % 2) == 0)
+    {
+        /* names can't be empty and the first one is fixed. */
+        if ((size == 0) || ((scan->count == 0) &&
+                            !scgi_is_content_length(token, size))) {
+            return (0);
+        }
+        scan->field = scan->start;
+        scan->field_size = size;
+    }
+    else if (scan->count == 1)
+    {
+        if ((size == 0) || (scgi_parse_content_length(token, size) < 0)) {
+            return (0);
+        }
+    }
+    else if ((scan->field_size == 4) &&
+             (memcmp(data+scan->field, "SCGI", 4) == 0))
+    {
+        if ((size != 1) || (token[0] != '1')) {
+            return (0);
+        }
+        scan->scgi = 1;
+    }
+    ++scan->count, scan->start = end + 1;
+    return (1);
+}
+
+/* Validate the netstring payload in a single pass over its null bytes. */
+static int scgi_scan_head (const char * data, size_t size)
+{
+    struct scgi_scan scan = { 0, 0, 0, 0, 0 };
+    size_t used = 0;
+#ifdef SCGI_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    unsigned int mask = 0;
+    for (; (used+16) <= size; used += 16)
+    {
+        mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i*)(data+used)), zero));
+        for (; mask != 0; mask &= mask-1)
+        {
+            if (!scgi_scan_token(&scan, data, used+__builtin_ctz(mask))) {
+                return (-1);
+            }
+        }
+    }
+#endif
+    for (; used < size; ++used)
+    {
+        if ((data[used] == '\0') && !scgi_scan_token(&scan, data, used)) {
+            return (-1);
+        }
+    }
+    /* each name has a value and the last value is terminated. */
+    if ((scan.count == 0) || ((scan.count % 2) != 0) ||
+        (scan.start != size) || !scan.scgi)
+    {
+        return (-1);
+    }
+    return (1);
+}
+
+/* Validate the whole head, if available.  Returns 0 when it isn't. */
+static int scgi_check_head (const char * data, size_t size)
+{
+    size_t used = 0;
+    size_t head = 0;
+    while ((used < size) && isdigit((unsigned char)data[used]))
+    {
+        head *= 10, head += (data[used++]-'0');
+        if (head > size) {
+            return (0);
+        }
+    }
+    if (used == size) {
+        return (0);
+    }
+    if ((used == 0) || (data[used] != ':')) {
+        return (-1);
+    }
+    if ((size - ++used) <= head) {
+        return (0);
+    }
+    if (data[used+head] != ',') {
+        return (-1);
+    }
+    return (scgi_scan_head(data+used, head));
+}
+
+/* Track a piece of the current header name or value, checking it in strict
+   mode.  The first header's value is the content length if it is named
+   "CONTENT_LENGTH", and other header names are compared to "SCGI". */
+static int scgi_track_accept
+    (struct scgi_parser * parser, const char * data, size_t size)
+{
+    const int strict =
+        parser->strict && !(parser->checks & SCGI_CHECK_WHOLE);
+    const char *const name =
+        (parser->header_count == 0)? "CONTENT_LENGTH" : "SCGI";
+    size_t i = 0;
+    if (parser->state == scgi_parser_field)
+    {
+        if ((parser->token_size+size > strlen(name)) ||
+            (memcmp(name+parser->token_size, data, size) != 0))
+        {
+            parser->checks &= ~SCGI_CHECK_MATCH;
+        }
+    }
+    else if (parser->header_count == 0)
+    {
+        for (i = 0; i < size; ++i)
+        {
+            if (!isdigit((unsigned char)data[i]))
+            {
+                if (strict) {
+                    parser->error = scgi_error_head_syntax;
+                    return (0);
+                }
+                parser->checks &= ~SCGI_CHECK_MATCH;
+            }
+            if ((parser->checks & SCGI_CHECK_MATCH) &&
+                !scgi_push_digit(&parser->content_length, data[i],
+                                 (size_t)-1))
+            {
+                parser->error = scgi_error_head_syntax;
+                return (0);
+            }
+        }
+    }
+    else if (strict && (parser->checks & SCGI_CHECK_MATCH))
+    {
+        if ((parser->token_size+size > 1) || ((size > 0) && (*data != '1')))
+        {
+            parser->error = scgi_error_head_syntax;
+            return (0);
+        }
+    }
+    parser->token_size += size;
+    return (1);
+}
+
+/* Track the end of the current header name or value. */
+static int scgi_track_finish (struct scgi_parser * parser)
+{
+    const int strict =
+        parser->strict && !(parser->checks & SCGI_CHECK_WHOLE);
+    const size_t size = (parser->header_count == 0)? 14 : 4;
+    if (parser->state == scgi_parser_field)
+    {
+        if (parser->token_size != size) {
+            parser->checks &= ~SCGI_CHECK_MATCH;
+        }
+        if (strict && ((parser->token_size == 0) ||
+                       ((parser->header_count == 0) &&
+                        !(parser->checks & SCGI_CHECK_MATCH))))
+        {
+            parser->error = scgi_error_head_syntax;
+            return (0);
+        }
+    }
+    else
+    {
+        if (parser->header_count == 0)
+        {
+            if ((parser->checks & SCGI_CHECK_MATCH) &&
+                (parser->token_size > 0)) {
+                parser->checks |= SCGI_CHECK_LENGTH;
+            }
+            else if (strict) {
+                parser->error = scgi_error_head_syntax;
+                return (0);
+            }
+        }
+        else if (strict && (parser->checks & SCGI_CHECK_MATCH))
+        {
+            if (parser->token_size != 1) {
+                parser->error = scgi_error_head_syntax;
+                return (0);
+            }
+            parser->checks |= SCGI_CHECK_SCGI;
+        }
+        ++parser->header_count;
+        parser->checks |= SCGI_CHECK_MATCH;
+    }
+    parser->token_size = 0;
+    return (1);
+}
+
+/* In strict mode, the last value must be complete and "SCGI" present. */
+static int scgi_strict_head (struct scgi_parser * parser)
+{
+    if (parser->strict && !(parser->checks & SCGI_CHECK_WHOLE) &&
+        ((parser->state != scgi_parser_field) || (parser->token_size > 0) ||
+         !(parser->checks & SCGI_CHECK_SCGI)))
+    {
+        parser->error = scgi_error_head_syntax;
+        return (0);
+    }
+    return (1);
+}
+
+/* In strict mode, reject malformed heads before any callback, if we can. */
+static int scgi_strict_start
+    (struct scgi_parser * parser, const char * data, size_t size)
+{
+    if (parser->strict && !(parser->checks & SCGI_CHECK_START))
+    {
+        parser->checks |= SCGI_CHECK_START;
+        switch (scgi_check_head(data, size))
+        {
+        case -1:
+            parser->error = scgi_error_head_syntax;
+            return (0);
+        case 1:
+            parser->checks |= SCGI_CHECK_WHOLE;
+            break;
+        }
+    }
+    return (1);
+}
+
 static void scgi_accept_head
     (struct scgi_parser * parser, const char * data, size_t size)
 {
@@ -66,9 +346,17 @@ static void scgi_accept_head
         if (parser->state == scgi_parser_field)
         {
             peek = scgi_seek(data+used, size-used);
+            if (parser->strict &&
+                !scgi_track_accept(parser, data+used, peek)) {
+                return;
+            }
             parser->accept_field(parser, data+used, peek);
             used += peek;
             if ((used < size) && (data[used] == '\0')) {
+                if (parser->strict && !scgi_track_finish(parser)) {
+                    return;
+                }
+                SCGI_TRACE_EVENT(parser, scgi_trace_field, 0);
                 ++used;
                 parser->state = scgi_parser_value;
                 /* let the owner know they can stop buffering. */
@@ -80,9 +368,17 @@ static void scgi_accept_head
         if (parser->state == scgi_parser_value)
         {
             peek = scgi_seek(data+used, size-used);
+            if (parser->strict &&
+                !scgi_track_accept(parser, data+used, peek)) {
+                return;
+            }
             parser->accept_value(parser, data+used, peek);
             used += peek;
             if ((used < size) && (data[used] == '\0')) {
+                if (parser->strict && !scgi_track_finish(parser)) {
+                    return;
+                }
+                SCGI_TRACE_EVENT(parser, scgi_trace_value, 0);
                 ++used;
                 parser->state = scgi_parser_field;
                 /* let the owner know they can stop buffering. */
@@ -96,6 +392,10 @@ static void scgi_accept_head
 
 static void scgi_finish_head (struct scgi_parser * parser)
 {
+    if ((parser->error != scgi_error_ok) || !scgi_strict_head(parser)) {
+        return;
+    }
+    SCGI_TRACE_EVENT(parser, scgi_trace_head, 0);
     parser->finish_head(parser);
 }
 
@@ -140,21 +440,49 @@ void scgi_setup (struct scgi_limits * limits, struct scgi_parser * parser)
     parser->state = scgi_parser_field;
     parser->error = scgi_error_ok;
     parser->body_size = 0;
+    parser->strict = 0;
+    parser->header_count = 0;
+    parser->token_size = 0;
+    parser->checks = SCGI_CHECK_MATCH;
+    parser->content_length = 0;
+    parser->frame = SCGI_FRAME_SIZE;
+    parser->head_size = 0;
+    parser->head_used = 0;
+    parser->trace = 0;
     parser->finish_field = 0;
     parser->finish_value = 0;
 }
 
 void scgi_clear (struct scgi_parser * parser)
 {
+    netstring_clear(&parser->header_parser);
     parser->state = scgi_parser_field;
     parser->error = scgi_error_ok;
+    parser->body_size = 0;
+    parser->header_count = 0;
+    parser->token_size = 0;
+    parser->checks = SCGI_CHECK_MATCH;
+    parser->content_length = 0;
+    parser->frame = SCGI_FRAME_SIZE;
+    parser->head_size = 0;
+    parser->head_used = 0;
+    parser->trace = 0;
 }
 
-size_t scgi_consume (struct scgi_parser * parser,
-                     const char * data, size_t size)
+void scgi_relocate (struct scgi_parser * parser)
+{
+    parser->header_parser.object = parser;
+}
+
+static size_t scgi_parse (struct scgi_parser * parser,
+                          const char * data, size_t size)
 {
     size_t used = 0;
     size_t pass = 0;
+    if ((parser->error != scgi_error_ok) ||
+        !scgi_strict_start(parser, data, size)) {
+        return (0);
+    }
     if ((parser->state == scgi_parser_field) ||
         (parser->state == scgi_parser_value))
     {
@@ -167,10 +495,13 @@ size_t scgi_consume (struct scgi_parser * parser,
                 parser->error = scgi_error_head_overflow;
             }
             if (parser->header_parser.error == netstring_error_syntax) {
-                /* TODO: handle this. */
+                parser->error = scgi_error_head_syntax;
             }
             return (used);
         }
+        if (parser->error != scgi_error_ok) {
+            return (used);
+        }
         if (parser->header_parser.state == netstring_parser_done)
         {
             parser->state = scgi_parser_body;
@@ -187,6 +518,7 @@ size_t scgi_consume (struct scgi_parser * parser,
         /* try to consume the chunk. */
         pass = parser->accept_body(parser, data+used, pass);
         used += pass, parser->body_size += pass;
+        SCGI_TRACE_EVENT(parser, scgi_trace_body, pass);
         /* overflow if:
            - there is data left to consume; and
            - we have an upper bound on the body size; and
@@ -201,20 +533,176 @@ size_t scgi_consume (struct scgi_parser * parser,
     return (used);
 }
 
+size_t scgi_consume (struct scgi_parser * parser,
+                     const char * data, size_t size)
+{
+#ifdef SCGI_TRACE
+    size_t used = 0;
+    const enum scgi_parser_error error = parser->error;
+    if (!(parser->checks & SCGI_CHECK_TRACE)) {
+        parser->checks |= SCGI_CHECK_TRACE;
+        parser->trace = scgi_trace_sample();
+    }
+    SCGI_TRACE_EVENT(parser, scgi_trace_consume, size);
+    used = scgi_parse(parser, data, size);
+    if ((parser->error != scgi_error_ok) && (error == scgi_error_ok)) {
+        SCGI_TRACE_EVENT(parser, scgi_trace_error, parser->error);
+    }
+    return (used);
+#else
+    return (scgi_parse(parser, data, size));
+#endif
+}
+
+enum scgi_event_type scgi_next (struct scgi_parser * parser,
+                                struct scgi_cursor * cursor,
+                                struct scgi_event * event)
+{
+    size_t peek = 0;
+    size_t used = 0;
+    char next = 0;
+    event->type = scgi_event_none;
+    event->data = cursor->data;
+    event->size = 0;
+    event->complete = 0;
+    if ((parser->error != scgi_error_ok) ||
+        !scgi_strict_start(parser, cursor->data, cursor->size)) {
+        return (scgi_event_none);
+    }
+    if (parser->state == scgi_parser_body)
+    {
+        peek = cursor->size;
+        if (parser->checks & SCGI_CHECK_LENGTH)
+        {
+            if (parser->body_size == parser->content_length)
+            {
+                if (parser->checks & SCGI_CHECK_DONE) {
+                    return (scgi_event_none);
+                }
+                parser->checks |= SCGI_CHECK_DONE;
+                return (event->type = scgi_event_done);
+            }
+            peek = scgi_min(peek, parser->content_length-parser->body_size);
+        }
+        if (parser->limits.max_body_size > 0)
+        {
+            if ((peek > 0) &&
+                (parser->body_size == parser->limits.max_body_size)) {
+                parser->error = scgi_error_body_overflow;
+                return (scgi_event_none);
+            }
+            peek = scgi_min(peek,
+                            parser->limits.max_body_size-parser->body_size);
+        }
+        if (peek == 0) {
+            return (scgi_event_none);
+        }
+        cursor->data += peek, cursor->size -= peek;
+        parser->body_size += peek;
+        event->size = peek;
+        event->complete = (parser->checks & SCGI_CHECK_LENGTH) &&
+            (parser->body_size == parser->content_length);
+        return (event->type = scgi_event_body);
+    }
+    /* netstring length prefix (head_used counts digits). */
+    while ((parser->frame == SCGI_FRAME_SIZE) && (cursor->size > 0))
+    {
+        next = *cursor->data;
+        if (isdigit((unsigned char)next))
+        {
+            if (!scgi_push_digit(&parser->head_size, next, (size_t)-1)) {
+                parser->error = scgi_error_head_overflow;
+                return (scgi_event_none);
+            }
+            ++parser->head_used;
+            if (scgi_head_overflow(&parser->limits, parser->head_size)) {
+                parser->error = scgi_error_head_overflow;
+                return (scgi_event_none);
+            }
+        }
+        else if ((next == ':') && (parser->head_used > 0)) {
+            parser->frame = SCGI_FRAME_DATA;
+            parser->head_used = 0;
+        }
+        else {
+            parser->error = scgi_error_head_syntax;
+            return (scgi_event_none);
+        }
+        ++cursor->data, --cursor->size;
+    }
+    if ((parser->frame == SCGI_FRAME_DATA) &&
+        (parser->head_used == parser->head_size)) {
+        parser->frame = SCGI_FRAME_END;
+    }
+    if (cursor->size == 0) {
+        return (scgi_event_none);
+    }
+    /* one piece of a name or value. */
+    if (parser->frame == SCGI_FRAME_DATA)
+    {
+        used = scgi_min(cursor->size, parser->head_size-parser->head_used);
+        peek = scgi_seek(cursor->data, used);
+        if (!scgi_track_accept(parser, cursor->data, peek)) {
+            return (scgi_event_none);
+        }
+        event->type = (parser->state == scgi_parser_field)?
+            scgi_event_field : scgi_event_value;
+        event->data = cursor->data;
+        event->size = peek;
+        if (peek < used)
+        {
+            if (!scgi_track_finish(parser)) {
+                return (event->type = scgi_event_none);
+            }
+            parser->state = (parser->state == scgi_parser_field)?
+                scgi_parser_value : scgi_parser_field;
+            event->complete = 1;
+            ++peek;
+        }
+        cursor->data += peek, cursor->size -= peek;
+        parser->head_used += peek;
+        return (event->type);
+    }
+    /* netstring terminator. */
+    if (*cursor->data != ',') {
+        parser->error = scgi_error_head_syntax;
+        return (scgi_event_none);
+    }
+    ++cursor->data, --cursor->size;
+    if (!scgi_strict_head(parser)) {
+        return (scgi_event_none);
+    }
+    if ((parser->checks & SCGI_CHECK_LENGTH) &&
+        scgi_body_overflow(&parser->limits, parser->content_length))
+    {
+        parser->error = scgi_error_body_overflow;
+        return (scgi_event_none);
+    }
+    parser->state = scgi_parser_body;
+    event->data = cursor->data;
+    return (event->type = scgi_event_head);
+}
+
 int scgi_is_content_length (const char * data, size_t size)
 {
-    return (strncmp("CONTENT_LENGTH", data, size) == 0);
+    return ((size == 14) && (memcmp("CONTENT_LENGTH", data, 14) == 0));
 }
 
 ssize_t scgi_parse_content_length (const char * data, size_t size)
 {
     size_t used = 0;
-    ssize_t content_length = 0;
-    while ((used < size) && isdigit(data[used])) {
-        content_length *= 10, content_length += (data[used++]-'0');
+    size_t content_length = 0;
+    while ((used < size) && isdigit((unsigned char)data[used]))
+    {
+        /* values that don't fit in the result are invalid. */
+        if (!scgi_push_digit(&content_length, data[used++],
+                             ((size_t)-1) >> 1))
+        {
+            return (-1);
+        }
     }
     if (used < size) {
         return (-1);
     }
-    return (content_length);
+    return ((ssize_t)content_length);
 }
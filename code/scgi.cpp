@@ -25,26 +25,212 @@
  */
 
 #include "scgi.hpp"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
 namespace scgi {
 
+    int View::compare (View other) const
+    {
+        const int result = std::memcmp(myData, other.myData,
+                                       std::min(mySize, other.mySize));
+        if (result != 0) {
+            return (result);
+        }
+        return ((mySize < other.mySize)? -1 : (mySize > other.mySize)? 1 : 0);
+    }
+
+    bool operator== (View lhs, View rhs)
+    {
+        return ((lhs.size() == rhs.size()) && (lhs.compare(rhs) == 0));
+    }
+
+    bool operator!= (View lhs, View rhs)
+    {
+        return (!(lhs == rhs));
+    }
+
+    bool operator< (View lhs, View rhs)
+    {
+        return (lhs.compare(rhs) < 0);
+    }
+
+    std::ostream& operator<< (std::ostream& stream, View view)
+    {
+        return (stream.write(view.data(), view.size()));
+    }
+
+    Form::Form (const std::string& data)
+        : myData(data.data()),
+          mySize(data.size()),
+          myUsed(0),
+          myKey(0),
+          myKeySize(0),
+          myValue(0),
+          myValueSize(0)
+    {
+    }
+
+    Form::Form (const char * data, std::size_t size)
+        : myData(data),
+          mySize(size),
+          myUsed(0),
+          myKey(0),
+          myKeySize(0),
+          myValue(0),
+          myValueSize(0)
+    {
+    }
+
+    bool Form::next ()
+    {
+        return (::scgi_form_next(myData, mySize, &myUsed,
+                                 &myKey, &myKeySize,
+                                 &myValue, &myValueSize) != 0);
+    }
+
+    const char * Form::key_data () const
+    {
+        return (myKey);
+    }
+
+    std::size_t Form::key_size () const
+    {
+        return (myKeySize);
+    }
+
+    const char * Form::value_data () const
+    {
+        return (myValue);
+    }
+
+    std::size_t Form::value_size () const
+    {
+        return (myValueSize);
+    }
+
+    namespace {
+
+        void decode (const char * data, std::size_t size,
+                     std::string& buffer)
+        {
+            buffer.resize(size);
+            if (size > 0) {
+                buffer.resize(::scgi_form_decode(data, size, &buffer[0]));
+            }
+        }
+
+    }
+
+    void Form::key (std::string& buffer) const
+    {
+        decode(myKey, myKeySize, buffer);
+    }
+
+    std::string Form::key () const
+    {
+        std::string buffer;
+        key(buffer);
+        return (buffer);
+    }
+
+    void Form::value (std::string& buffer) const
+    {
+        decode(myValue, myValueSize, buffer);
+    }
+
+    std::string Form::value () const
+    {
+        std::string buffer;
+        value(buffer);
+        return (buffer);
+    }
+
     Request::Request ()
         : myState(Null),
-          myContentLength(0)
+          myContentLength(0),
+          mySelective(false),
+          mySkipping(false)
     {
         myLimits.max_head_size = 0;
         myLimits.max_body_size = 0;
         ::scgi_setup(&myLimits, &myParser);
         myParser.object = this;
         myParser.accept_field = &Request::accept_field;
+        myParser.finish_field = &Request::finish_field;
         myParser.accept_value = &Request::accept_value;
         myParser.finish_value = &Request::finish_value;
         myParser.finish_head = &Request::finish_head;
         myParser.accept_body = &Request::accept_body;
     }
 
+    Request::Request (const Request& other)
+        : myLimits(other.myLimits),
+          myParser(other.myParser),
+          myField(other.myField),
+          myValue(other.myValue),
+          myHeaders(other.myHeaders),
+          myContent(other.myContent),
+          myState(other.myState),
+          myContentLength(other.myContentLength),
+          mySelection(other.mySelection),
+          mySelective(other.mySelective),
+          mySkipping(other.mySkipping)
+    {
+        myParser.object = this;
+        ::scgi_relocate(&myParser);
+    }
+
+    Request& Request::operator= (const Request& other)
+    {
+        Request copy(other);
+        swap(copy);
+        return (*this);
+    }
+
+#if __cplusplus >= 201103L
+    Request::Request (Request&& other)
+        : Request()
+    {
+        swap(other);
+    }
+
+    Request& Request::operator= (Request&& other)
+    {
+        Request empty;
+        swap(other);
+        other.swap(empty);
+        return (*this);
+    }
+#endif
+
+    void Request::swap (Request& other)
+    {
+        std::swap(myLimits, other.myLimits);
+        std::swap(myParser, other.myParser);
+        myField.swap(other.myField);
+        myValue.swap(other.myValue);
+        myHeaders.swap(other.myHeaders);
+        myContent.swap(other.myContent);
+        std::swap(myState, other.myState);
+        std::swap(myContentLength, other.myContentLength);
+        mySelection.swap(other.mySelection);
+        std::swap(mySelective, other.mySelective);
+        std::swap(mySkipping, other.mySkipping);
+        // Parsers point back to their owner and to themselves.
+        myParser.object = this;
+        ::scgi_relocate(&myParser);
+        other.myParser.object = &other;
+        ::scgi_relocate(&other.myParser);
+    }
+
+    void swap (Request& lhs, Request& rhs)
+    {
+        lhs.swap(rhs);
+    }
+
     void Request::clear ()
     {
         myContent.clear();
@@ -63,31 +249,135 @@ namespace scgi {
         return (used);
     }
 
+    void Request::select (const char *const * fields)
+    {
+        select_all();
+        for (; (fields != 0) && (*fields != 0); ++fields) {
+            select(*fields);
+        }
+    }
+
+    void Request::select (const std::string& field)
+    {
+        mySelection.push_back(field);
+        mySelective = true;
+    }
+
+    void Request::strict (bool enabled)
+    {
+        myParser.strict = enabled? 1 : 0;
+    }
+
+    void Request::select_all ()
+    {
+        mySelection.clear();
+        mySelective = false;
+    }
+
+    namespace {
+
+        bool same_name (const std::string& name,
+                        const char * field, std::size_t size)
+        {
+            // Compare sizes first, most names are rejected without a scan.
+            return ((name.size() == size) &&
+                    (name.compare(0, size, field, size) == 0));
+        }
+
+    }
+
+    bool Request::selected (const char * field, std::size_t size) const
+    {
+        static const std::string content_length("CONTENT_LENGTH");
+        if (!mySelective || same_name(content_length, field, size)) {
+            return (true);
+        }
+        std::vector<std::string>::const_iterator current =
+            mySelection.begin();
+        for (; current != mySelection.end(); ++current)
+        {
+            if (same_name(*current, field, size)) {
+                return (true);
+            }
+        }
+        return (false);
+    }
+
     const Headers& Request::headers () const
     {
         return (myHeaders);
     }
 
-    bool Request::hasheader (const std::string& field) const
+    Headers::const_iterator Request::find (View field) const
+    {
+#ifdef SCGI_HAS_TRANSPARENT_LOOKUP
+        return (myHeaders.find(field));
+#else
+        return (myHeaders.find(field.str()));
+#endif
+    }
+
+    bool Request::hasheader (View field) const
     {
-        const Headers::const_iterator match = myHeaders.find(field);
+        const Headers::const_iterator match = find(field);
         return ((match != myHeaders.end()) && !match->second.empty());
     }
 
-    const std::string Request::header (const std::string& field) const
+    const std::string& Request::header (View field) const
     {
-        const Headers::const_iterator match = myHeaders.find(field);
+        static const std::string none;
+        const Headers::const_iterator match = find(field);
         if (match == myHeaders.end()) {
-            return ("");
+            return (none);
         }
         return (match->second);
     }
 
+    void Request::take_headers (Headers& headers)
+    {
+        headers.clear();
+        headers.swap(myHeaders);
+    }
+
+    Headers Request::take_headers ()
+    {
+        Headers headers;
+        take_headers(headers);
+        return (headers);
+    }
+
     const std::string& Request::body () const
     {
         return (myContent);
     }
 
+    void Request::take_body (std::string& body)
+    {
+        body.clear();
+        body.swap(myContent);
+    }
+
+    std::string Request::take_body ()
+    {
+        std::string body;
+        take_body(body);
+        return (body);
+    }
+
+    Form Request::query () const
+    {
+        const Headers::const_iterator match = find("QUERY_STRING");
+        if (match == myHeaders.end()) {
+            return (Form(0, 0));
+        }
+        return (Form(match->second));
+    }
+
+    Form Request::form () const
+    {
+        return (Form(myContent));
+    }
+
     bool Request::head_complete () const
     {
         return (myState >= Body);
@@ -103,6 +393,20 @@ namespace scgi {
         return (myContentLength);
     }
 
+    std::size_t Request::footprint () const
+    {
+        // Map nodes hold three pointers and a color besides the pair.
+        static const std::size_t node = 4*sizeof(void*);
+        std::size_t size = sizeof(*this) + myField.capacity() +
+            myValue.capacity() + myContent.capacity();
+        Headers::const_iterator current = myHeaders.begin();
+        for (; current != myHeaders.end(); ++current) {
+            size += node + sizeof(*current) +
+                current->first.capacity() + current->second.capacity();
+        }
+        return (size);
+    }
+
     void Request::accept_field
         (::scgi_parser* parser, const char * data, size_t size)
     {
@@ -110,16 +414,30 @@ namespace scgi {
         request.myField.append(data, size);
     }
 
+    void Request::finish_field (::scgi_parser * parser)
+    {
+        Request& request = *static_cast<Request*>(parser->object);
+        request.mySkipping = !request.selected(request.myField.data(),
+                                               request.myField.size());
+    }
+
     void Request::accept_value
         (::scgi_parser* parser, const char * data, size_t size)
     {
         Request& request = *static_cast<Request*>(parser->object);
-        request.myValue.append(data, size);
+        if (!request.mySkipping) {
+            request.myValue.append(data, size);
+        }
     }
 
     void Request::finish_value (::scgi_parser * parser)
     {
         Request& request = *static_cast<Request*>(parser->object);
+        if (request.mySkipping) {
+            request.mySkipping = false;
+            request.myField.clear();
+            return;
+        }
         // Pre-parse content length.
         if (::scgi_is_content_length(request.myField.data(),
                                      request.myField.size()))
@@ -176,4 +494,67 @@ namespace scgi {
         return (stream);
     }
 
+    namespace {
+
+        bool is_mandatory (const std::string& field)
+        {
+            return ((field == "CONTENT_LENGTH") || (field == "SCGI"));
+        }
+
+    }
+
+    Encoder::Encoder ()
+    {
+    }
+
+    Encoder::Encoder (const Headers& fixed)
+    {
+        prepare(fixed);
+        myTemplate.resize(::scgi_encode_pairs(
+            myHeaders.empty()? 0 : &myHeaders[0], myHeaders.size(), 0, 0));
+        if (!myTemplate.empty()) {
+            ::scgi_encode_pairs(&myHeaders[0], myHeaders.size(),
+                                &myTemplate[0], myTemplate.size());
+        }
+    }
+
+    void Encoder::prepare (const Headers& headers)
+    {
+        myHeaders.clear();
+        Headers::const_iterator current = headers.begin();
+        for (; current != headers.end(); ++current)
+        {
+            if (is_mandatory(current->first)) {
+                continue;
+            }
+            ::scgi_header header;
+            header.name = current->first.data();
+            header.name_size = current->first.size();
+            header.value = current->second.data();
+            header.value_size = current->second.size();
+            myHeaders.push_back(header);
+        }
+    }
+
+    void Encoder::head (const Headers& headers, std::size_t body_size,
+                        std::string& head)
+    {
+        prepare(headers);
+        const ::scgi_header *const pairs =
+            myHeaders.empty()? 0 : &myHeaders[0];
+        head.resize(::scgi_encode_head(
+            myTemplate.data(), myTemplate.size(),
+            pairs, myHeaders.size(), body_size, 0, 0));
+        ::scgi_encode_head(myTemplate.data(), myTemplate.size(),
+                           pairs, myHeaders.size(), body_size,
+                           &head[0], head.size());
+    }
+
+    void Encoder::request (const Headers& headers, const std::string& body,
+                           std::string& request)
+    {
+        head(headers, body.size(), request);
+        request.append(body);
+    }
+
 }
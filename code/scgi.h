@@ -29,6 +29,7 @@
 
 #include <netstring.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -189,6 +190,71 @@ struct scgi_parser
      */
     size_t body_size;
 
+    /*!
+     * @public
+     * @brief Non-zero to reject heads that do not conform to the SCGI spec.
+     *
+     * In strict mode, the first header must be "CONTENT_LENGTH" with a
+     * decimal value, a "SCGI" header with value "1" must be present, header
+     * names must not be empty and the head must end with a complete value.
+     * Violations are reported as @c scgi_error_head_syntax.
+     *
+     * When the whole head is passed to @c scgi_consume() in one call, it is
+     * validated in a single pass before any callback is invoked.  Otherwise,
+     * the same rules are enforced as data arrives and the parser stops at the
+     * first violation.
+     *
+     * Set this after @c scgi_setup(), which disables it.
+     */
+    int strict;
+
+    /*!
+     * @private
+     * @brief Number of complete headers seen in strict mode.
+     */
+    size_t header_count;
+
+    /*!
+     * @private
+     * @brief Size of the current header name or value, in strict mode.
+     */
+    size_t token_size;
+
+    /*!
+     * @private
+     * @brief Strict mode checks passed so far.
+     */
+    unsigned int checks;
+
+    /*!
+     * @private
+     * @brief Value of the leading "CONTENT_LENGTH" header, if any.
+     */
+    size_t content_length;
+
+    /*!
+     * @private
+     * @brief Netstring framing stage, for @c scgi_next().
+     */
+    int frame;
+
+    /*!
+     * @private
+     * @brief Size of the head, and amount of it parsed, for @c scgi_next().
+     */
+    size_t head_size;
+    size_t head_used;
+
+    /*!
+     * @public
+     * @brief Trace identifier of the current request, 0 if not traced.
+     *
+     * Only set when the library is built with @c SCGI_TRACE.  Pass it to @c
+     * scgi_trace_record() to add application events to the request's trace.
+     * Read-only.
+     */
+    uint64_t trace;
+
     /*!
      * @brief Callback supplying data for a header field name.
      * @param parser The SCGI parser itself.  Useful for checking the parser
@@ -280,12 +346,21 @@ void scgi_setup (struct scgi_limits * limits, struct scgi_parser * parser);
 /*!
  * @brief Clear errors and reset the parser state.
  *
- * This function does not clear the @c object and callback fields.  You may
- * call it to re-use any parsing context, such as allocated buffers for
- * headers and body data.
+ * This function does not clear the @c object, @c strict and callback fields.
+ * You may call it to re-use any parsing context, such as allocated buffers
+ * for headers and body data.
  */
 void scgi_clear (struct scgi_parser * parser);
 
+/*!
+ * @brief Fix internal pointers after a parser was copied to a new address.
+ *
+ * Parsers may be copied (e.g. with @c memcpy()) or swapped, but they hold a
+ * pointer to themselves.  Call this on the copy before passing it to @c
+ * scgi_consume().  The @c object field is not changed.
+ */
+void scgi_relocate (struct scgi_parser * parser);
+
 /*!
  * @brief Feed data to the parser.
  * @param data Pointer to first byte of data.
@@ -302,6 +377,110 @@ void scgi_clear (struct scgi_parser * parser);
 size_t scgi_consume (struct scgi_parser * parser,
                      const char * data, size_t size);
 
+/*!
+ * @brief Kinds of events returned by @c scgi_next().
+ */
+enum scgi_event_type
+{
+    /*!
+     * @brief No event: the cursor is exhausted, or an error occurred.
+     */
+    scgi_event_none=0,
+
+    /*!
+     * @brief Piece of a header name.
+     */
+    scgi_event_field,
+
+    /*!
+     * @brief Piece of a header value.
+     */
+    scgi_event_value,
+
+    /*!
+     * @brief End of the head.  Header values may now be interpreted.
+     */
+    scgi_event_head,
+
+    /*!
+     * @brief Piece of the body.
+     */
+    scgi_event_body,
+
+    /*!
+     * @brief All "CONTENT_LENGTH" bytes of the body have been returned.
+     */
+    scgi_event_done,
+};
+
+/*!
+ * @brief Event returned by @c scgi_next().
+ */
+struct scgi_event
+{
+    /*!
+     * @brief Kind of event.
+     */
+    enum scgi_event_type type;
+
+    /*!
+     * @brief Span of the current buffer, for names, values and body data.
+     *
+     * The span is empty for other events.
+     */
+    const char * data;
+    size_t size;
+
+    /*!
+     * @brief Non-zero if this span ends the name, value or body.
+     *
+     * Names and values are split into several events when they cross buffer
+     * boundaries.  A complete name or value may also be empty.
+     */
+    int complete;
+};
+
+/*!
+ * @brief Position in a buffer passed to @c scgi_next().
+ */
+struct scgi_cursor
+{
+    /*!
+     * @brief Data not yet parsed.
+     */
+    const char * data;
+
+    /*!
+     * @brief Size of @c data, in bytes.
+     */
+    size_t size;
+};
+
+/*!
+ * @brief Get the next event from a buffer (pull-style parsing).
+ * @param parser Parser, initialized with @c scgi_setup().  Its callbacks are
+ *  not used.
+ * @param cursor Data to parse, advanced past the returned event.
+ * @param event Receives the next event.
+ * @return The type of @a event.  When this is @c scgi_event_none, check the
+ *  parser's @c error field, else refill the cursor with the next buffer.
+ *
+ * This is an alternative to @c scgi_consume() for applications that prefer
+ * to drive parsing from their own loop, e.g. a @c switch on the event type.
+ * Parsing resumes where it left off when a new buffer is passed in.  Do not
+ * mix calls to @c scgi_next() and @c scgi_consume() on the same request.
+ *
+ * The @c scgi_event_done event is only returned when the first header is
+ * "CONTENT_LENGTH", as required by the SCGI spec.  Then, data past the end
+ * of the body is left in the cursor, and a body longer than the parser's @c
+ * max_body_size is reported as @c scgi_error_body_overflow with the head.
+ * Otherwise, the body continues until the connection is closed.  The strict
+ * mode applies as with @c scgi_consume().
+ */
+enum scgi_event_type scgi_next (struct scgi_parser * parser,
+                                struct scgi_cursor * cursor,
+                                struct scgi_event * event);
+
 /*!
  * @brief Check an HTTP header's name for the @c Content-Length header value.
  * @param data Buffered header name data.
@@ -27,9 +27,22 @@
  */
 
 #include "scgi.h"
+#include "scgi-encode.h"
+#include "scgi-form.h"
+#include <algorithm>
 #include <iosfwd>
 #include <string>
 #include <map>
+#include <vector>
+
+// Use standard string views and heterogeneous lookup when available.
+#if __cplusplus >= 201703L
+# define SCGI_HAS_STRING_VIEW 1
+# include <string_view>
+#endif
+#if __cplusplus >= 201402L
+# define SCGI_HAS_TRANSPARENT_LOOKUP 1
+#endif
 
 namespace scgi {
 
@@ -53,15 +66,180 @@ namespace scgi {
         }
     };
 
+    /*!
+     * @brief Non-owning reference to a string.
+     *
+     * Built from @c std::string objects and string literals without copying,
+     * and converts to @c std::string_view in C++17.  The referenced data must
+     * outlive the view.
+     */
+    class View
+    {
+        /* data. */
+    private:
+        const char * myData;
+        std::size_t mySize;
+
+        /* construction. */
+    public:
+        View ()
+          : myData(""), mySize(0)
+        {}
+
+        View (const char * data)
+          : myData(data), mySize(std::char_traits<char>::length(data))
+        {}
+
+        View (const char * data, std::size_t size)
+          : myData(data), mySize(size)
+        {}
+
+        View (const std::string& data)
+          : myData(data.data()), mySize(data.size())
+        {}
+
+#ifdef SCGI_HAS_STRING_VIEW
+        View (std::string_view data)
+          : myData(data.data()), mySize(data.size())
+        {}
+#endif
+
+        /* methods. */
+    public:
+        const char * data () const {
+            return (myData);
+        }
+
+        std::size_t size () const {
+            return (mySize);
+        }
+
+        bool empty () const {
+            return (mySize == 0);
+        }
+
+        const char * begin () const {
+            return (myData);
+        }
+
+        const char * end () const {
+            return (myData + mySize);
+        }
+
+        /*!
+         * @brief Copy the referenced data.
+         */
+        std::string str () const {
+            return (std::string(myData, mySize));
+        }
+
+        /*!
+         * @brief Compare contents, like @c std::string::compare().
+         */
+        int compare (View other) const;
+
+#ifdef SCGI_HAS_STRING_VIEW
+        operator std::string_view () const {
+            return (std::string_view(myData, mySize));
+        }
+#endif
+    };
+
+    bool operator== (View lhs, View rhs);
+    bool operator!= (View lhs, View rhs);
+    bool operator< (View lhs, View rhs);
+    std::ostream& operator<< (std::ostream& stream, View view);
+
+    /*!
+     * @brief Header name ordering, allowing lookup without a @c std::string
+     *  key in C++14 and later.
+     */
+    struct HeaderLess
+    {
+#ifdef SCGI_HAS_TRANSPARENT_LOOKUP
+        typedef void is_transparent;
+#endif
+        bool operator() (View lhs, View rhs) const {
+            return (lhs.compare(rhs) < 0);
+        }
+    };
+
     /*!
      * @brief Representation of SCGI request headers.
      */
-    typedef std::map<std::string, std::string> Headers;
+    typedef std::map<std::string, std::string, HeaderLess> Headers;
+
+    /*!
+     * @brief Tokenizer for "QUERY_STRING" and URL-encoded form data.
+     *
+     * Keys and values are spans over the tokenized data, which must outlive
+     * the tokenizer.  Nothing is copied or decoded until requested, and
+     * decoding can reuse the caller's buffers.
+     */
+    class Form
+    {
+        /* data. */
+    private:
+        const char * myData;
+        std::size_t mySize;
+        std::size_t myUsed;
+        const char * myKey;
+        std::size_t myKeySize;
+        const char * myValue;
+        std::size_t myValueSize;
+
+        /* construction. */
+    public:
+        /*!
+         * @brief Tokenize the contents of @a data, which is not copied.
+         */
+        explicit Form (const std::string& data);
+
+        /*!
+         * @brief Tokenize @a size bytes at @a data, which are not copied.
+         */
+        Form (const char * data, std::size_t size);
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Move to the next key/value pair.
+         * @return @c false when all pairs have been visited.
+         */
+        bool next ();
+
+        /*!
+         * @brief Get the current key, still encoded.
+         */
+        const char * key_data () const;
+        std::size_t key_size () const;
+
+        /*!
+         * @brief Get the current value, still encoded.
+         */
+        const char * value_data () const;
+        std::size_t value_size () const;
+
+        /*!
+         * @brief Decode the current key into @a buffer.
+         *
+         * @note Passing the same buffer for each pair avoids allocations
+         *  once the buffer has grown to the size of the largest key.
+         */
+        void key (std::string& buffer) const;
+        std::string key () const;
+
+        /*!
+         * @brief Decode the current value into @a buffer.
+         */
+        void value (std::string& buffer) const;
+        std::string value () const;
+    };
 
     /*!
      * @brief Streaming parser for SCGI requests.
      *
-     * @note This class is a request @e parser.  It cannot be used to format
+     * @note This class is a request @e parser.  Use an @c Encoder to format
      *  outgoing requests.
      */
     class Request
@@ -82,6 +260,9 @@ namespace scgi {
         std::string myContent;
         State myState;
         std::size_t myContentLength;
+        std::vector<std::string> mySelection;
+        bool mySelective;
+        bool mySkipping;
 
         /* construction. */
     public:
@@ -94,8 +275,32 @@ namespace scgi {
          */
         Request ();
 
+        /*!
+         * @brief Copy a request, including its parsing progress.
+         */
+        Request (const Request& other);
+        Request& operator= (const Request& other);
+
+#if __cplusplus >= 201103L
+        /*!
+         * @brief Move a request, including its parsing progress.
+         *
+         * The moved-from request is left empty, ready for a new request.
+         */
+        Request (Request&& other);
+        Request& operator= (Request&& other);
+#endif
+
         /* methods. */
     public:
+        /*!
+         * @brief Exchange contents and parsing progress with @a other.
+         *
+         * Parsing may continue on both requests afterwards.  Nothing is
+         * copied or allocated.
+         */
+        void swap (Request& other);
+
         /*!
          * @brief Prepare to start parsing a new request.
          *
@@ -119,6 +324,45 @@ namespace scgi {
          */
         size_t feed (const char * data, size_t size);
 
+        /*!
+         * @brief Reject heads that do not conform to the SCGI spec.
+         *
+         * Off by default.  The setting persists across requests.
+         *
+         * @see scgi_parser::strict
+         */
+        void strict (bool enabled=true);
+
+        /*!
+         * @brief Only store the listed headers (and "CONTENT_LENGTH").
+         * @param fields Null-terminated list of header names, such as a
+         *  route's @c headers.  A null list selects all headers.
+         *
+         * Other headers are skipped as they are parsed: their values are
+         * never buffered or copied.  The selection persists across requests
+         * and may be changed while parsing the head (e.g. once the request
+         * is routed).  It applies to headers that follow.
+         */
+        void select (const char *const * fields);
+
+        /*!
+         * @brief Add a header to the selection.
+         *
+         * The first call switches from storing all headers to storing only
+         * selected headers.
+         */
+        void select (const std::string& field);
+
+        /*!
+         * @brief Store all headers (the default).
+         */
+        void select_all ();
+
+        /*!
+         * @brief Check whether a header is stored.
+         */
+        bool selected (const char * field, std::size_t size) const;
+
         /*!
          * @brief Get the all headers defined in the request.
          * @return A string to string mapping containing headers and their
@@ -132,15 +376,26 @@ namespace scgi {
          * @return @c true if the header is defined and non-empty, @c false
          *  otherwise.
          */
-        bool hasheader (const std::string& field) const;
+        bool hasheader (View field) const;
 
         /*!
          * @brief Lookup a specific header's value.
          * @param field Header name.
          * @return An empty string if the header is not defined or empty,
          *  the header's value otherwise.
+         *
+         * @note No copy is made, and in C++14 and later the lookup does not
+         *  allocate a temporary key.
          */
-        const std::string header (const std::string& field) const;
+        const std::string& header (View field) const;
+
+        /*!
+         * @brief Move all headers out of the request.
+         *
+         * Headers are no longer available from the request afterwards.
+         */
+        void take_headers (Headers& headers);
+        Headers take_headers ();
 
         /*!
          * @brief Access the parsed request body.
@@ -148,15 +403,52 @@ namespace scgi {
          */
         const std::string& body () const;
 
+        /*!
+         * @brief Move the body out of the request, without copying.
+         *
+         * The body is no longer available from the request afterwards.
+         */
+        void take_body (std::string& body);
+        std::string take_body ();
+
+        /*!
+         * @brief Tokenize the "QUERY_STRING" header in place.
+         *
+         * @note The tokenizer refers to the header storage and is
+         *  invalidated by @c clear() or further parsing.
+         */
+        Form query () const;
+
+        /*!
+         * @brief Tokenize an URL-encoded request body in place.
+         *
+         * @note The tokenizer refers to the body storage and is invalidated
+         *  by @c clear() or further parsing.  The "CONTENT_TYPE" header is
+         *  not checked.
+         */
+        Form form () const;
+
         bool head_complete () const;
         bool body_complete () const;
 
         std::size_t body_size () const;
 
+        /*!
+         * @brief Estimate the memory held by the request, in bytes.
+         *
+         * Includes buffers kept by @c clear() for re-use.  Use this to
+         * charge a @c scgi_budget after each call to @c feed().
+         */
+        std::size_t footprint () const;
+
+    private:
+        Headers::const_iterator find (View field) const;
+
         /* class methods. */
     private:
         static void accept_field
             (::scgi_parser* parser, const char * data, size_t size);
+        static void finish_field (::scgi_parser * parser);
         static void accept_value
             (::scgi_parser* parser, const char * data, size_t size);
         static void finish_value (::scgi_parser * parser);
@@ -165,8 +457,489 @@ namespace scgi {
             (::scgi_parser* parser, const char * data, size_t size);
     };
 
+    void swap (Request& lhs, Request& rhs);
+
     std::istream& operator>> (std::istream& stream, Request& request);
 
+    /*!
+     * @internal
+     * @brief Smallest offset type for a head of a given capacity.
+     */
+    template<bool Small> struct FixedOffset {
+        typedef unsigned short type;
+    };
+    template<> struct FixedOffset<false> {
+        typedef unsigned int type;
+    };
+
+    /*!
+     * @brief Streaming parser for small SCGI requests, without heap memory.
+     *
+     * The raw head and body are stored in arrays inside the object, and
+     * headers are indexed by offset into the head.  The parser's limits are
+     * derived from the template arguments, so a request that does not fit is
+     * rejected as it arrives.  Instances can be stored in flat arrays, and
+     * copied or swapped like plain values.
+     *
+     * @tparam HeadCap Maximum size of the head, in bytes.
+     * @tparam BodyCap Maximum size of the body, in bytes.
+     * @tparam MaxHeaders Maximum number of headers.
+     *
+     * @note Unlike @c Request, @c feed() does not throw: check @c error().
+     */
+    template<std::size_t HeadCap, std::size_t BodyCap,
+             std::size_t MaxHeaders = 32>
+    class FixedRequest
+    {
+        /* constants. */
+    public:
+        static const std::size_t head_capacity = HeadCap;
+        static const std::size_t body_capacity = BodyCap;
+        static const std::size_t header_capacity = MaxHeaders;
+
+        /* data. */
+    private:
+        typedef typename FixedOffset<(HeadCap < 65535)>::type Offset;
+        struct Entry {
+            Offset field;
+            Offset value;
+        };
+        ::scgi_limits myLimits;
+        ::scgi_parser myParser;
+        ::scgi_parser_error myError;
+        bool myHeadComplete;
+        std::size_t myContentLength;
+        std::size_t myHeadSize;
+        std::size_t myBodySize;
+        std::size_t myHeaderCount;
+        std::size_t myHeadersDone;
+        Entry myHeaders[MaxHeaders];
+        char myHead[HeadCap];
+        char myBody[(BodyCap > 0)? BodyCap : 1];
+
+        /* construction. */
+    public:
+        FixedRequest ();
+        FixedRequest (const FixedRequest& other);
+        FixedRequest& operator= (const FixedRequest& other);
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Prepare to start parsing a new request.
+         */
+        void clear ();
+
+        /*!
+         * @brief Feed the parser some data.
+         * @return Number of bytes processed.  Stops early on errors.
+         */
+        std::size_t feed (const char * data, std::size_t size);
+
+        /*!
+         * @brief Reject heads that do not conform to the SCGI spec.
+         *
+         * Off by default.  The setting persists across requests.
+         *
+         * @see scgi_parser::strict
+         */
+        void strict (bool enabled=true);
+
+        /*!
+         * @brief Get the first error, if any.
+         *
+         * A head larger than @c head_capacity, or with more than @c
+         * header_capacity headers, is reported as @c
+         * scgi_error_head_overflow.  A "CONTENT_LENGTH" above @c
+         * body_capacity is reported as @c scgi_error_body_overflow as soon
+         * as the header is parsed.
+         */
+        ::scgi_parser_error error () const;
+
+        bool head_complete () const;
+        bool body_complete () const;
+
+        /*!
+         * @brief Get the number of headers parsed so far.
+         *
+         * A header is only counted once its value is complete.
+         */
+        std::size_t header_count () const;
+
+        /*!
+         * @brief Get the name and value of the @a i-th header.
+         * @pre @a i is less than @c header_count().
+         */
+        View field (std::size_t i) const;
+        View value (std::size_t i) const;
+
+        /*!
+         * @brief Check for presence of a specific header.
+         */
+        bool hasheader (View field) const;
+
+        /*!
+         * @brief Lookup a specific header's value.
+         * @return An empty view if the header is not defined.
+         */
+        View header (View field) const;
+
+        /*!
+         * @brief Access the raw head, as "NAME\0VALUE\0" pairs.
+         *
+         * The head may be modified in place (e.g. by @c scgi_cgi_environ()):
+         * views returned by @c field() and @c value() remain valid.
+         */
+        char * head ();
+        std::size_t head_size () const;
+
+        /*!
+         * @brief Access the body received so far.
+         */
+        View body () const;
+
+        /*!
+         * @brief Get the size of the body, from "CONTENT_LENGTH".
+         */
+        std::size_t body_size () const;
+
+        /* class methods. */
+    private:
+        static void accept_field
+            (::scgi_parser* parser, const char * data, size_t size);
+        static void finish_field (::scgi_parser * parser);
+        static void accept_value
+            (::scgi_parser* parser, const char * data, size_t size);
+        static void finish_value (::scgi_parser * parser);
+        static void finish_head (::scgi_parser* parser);
+        static size_t accept_body
+            (::scgi_parser* parser, const char * data, size_t size);
+    };
+
+    /*!
+     * @brief Formatter for outgoing SCGI requests.
+     *
+     * The "CONTENT_LENGTH" and "SCGI" headers are always written first and
+     * are skipped if present in the headers supplied by the application, so
+     * the headers of a parsed @c Request can be forwarded as-is.
+     */
+    class Encoder
+    {
+        /* data. */
+    private:
+        std::string myTemplate;
+        std::vector< ::scgi_header > myHeaders;
+
+        /* construction. */
+    public:
+        /*!
+         * @brief Create an encoder without any fixed headers.
+         */
+        Encoder ();
+
+        /*!
+         * @brief Create an encoder that includes @a fixed in all requests.
+         *
+         * The fixed headers are encoded only once, here.
+         */
+        explicit Encoder (const Headers& fixed);
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Format a request head.
+         * @param headers Headers specific to this request.
+         * @param body_size Size of the body that will follow the head.
+         * @param head Receives the formatted head.
+         *
+         * @note Both @a head and the encoder's internal storage keep their
+         *  capacity, so re-using them avoids memory allocation.
+         */
+        void head (const Headers& headers, std::size_t body_size,
+                   std::string& head);
+
+        /*!
+         * @brief Format a complete request.
+         * @param headers Headers specific to this request.
+         * @param body Request body.
+         * @param request Receives the formatted head, followed by the body.
+         */
+        void request (const Headers& headers, const std::string& body,
+                      std::string& request);
+
+    private:
+        void prepare (const Headers& headers);
+    };
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    FixedRequest<H,B,M>::FixedRequest ()
+    {
+        myParser.strict = 0;
+        clear();
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    FixedRequest<H,B,M>::FixedRequest (const FixedRequest& other)
+    {
+        *this = other;
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    FixedRequest<H,B,M>& FixedRequest<H,B,M>::operator=
+        (const FixedRequest& other)
+    {
+        // Only copy the parts of the buffers in use.
+        myLimits = other.myLimits;
+        myParser = other.myParser;
+        myParser.object = this;
+        ::scgi_relocate(&myParser);
+        myError = other.myError;
+        myHeadComplete = other.myHeadComplete;
+        myContentLength = other.myContentLength;
+        myHeadSize = other.myHeadSize;
+        myBodySize = other.myBodySize;
+        myHeaderCount = other.myHeaderCount;
+        myHeadersDone = other.myHeadersDone;
+        std::copy(other.myHeaders, other.myHeaders+myHeaderCount, myHeaders);
+        std::copy(other.myHead, other.myHead+myHeadSize, myHead);
+        std::copy(other.myBody, other.myBody+myBodySize, myBody);
+        return (*this);
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    void FixedRequest<H,B,M>::clear ()
+    {
+        const int strict = myParser.strict;
+        myLimits.max_head_size = H;
+        myLimits.max_body_size = B;
+        ::scgi_setup(&myLimits, &myParser);
+        myParser.strict = strict;
+        myParser.object = this;
+        myParser.accept_field = &FixedRequest::accept_field;
+        myParser.finish_field = &FixedRequest::finish_field;
+        myParser.accept_value = &FixedRequest::accept_value;
+        myParser.finish_value = &FixedRequest::finish_value;
+        myParser.finish_head = &FixedRequest::finish_head;
+        myParser.accept_body = &FixedRequest::accept_body;
+        myError = scgi_error_ok;
+        myHeadComplete = false;
+        myContentLength = 0;
+        myHeadSize = 0;
+        myBodySize = 0;
+        myHeaderCount = 0;
+        myHeadersDone = 0;
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    std::size_t FixedRequest<H,B,M>::feed
+        (const char * data, std::size_t size)
+    {
+        if (myError != scgi_error_ok) {
+            return (0);
+        }
+        const std::size_t used = ::scgi_consume(&myParser, data, size);
+        if (myError == scgi_error_ok) {
+            myError = myParser.error;
+        }
+        return (used);
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    void FixedRequest<H,B,M>::strict (bool enabled)
+    {
+        myParser.strict = enabled? 1 : 0;
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    ::scgi_parser_error FixedRequest<H,B,M>::error () const
+    {
+        return (myError);
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    bool FixedRequest<H,B,M>::head_complete () const
+    {
+        return (myHeadComplete);
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    bool FixedRequest<H,B,M>::body_complete () const
+    {
+        return (myHeadComplete && (myBodySize == myContentLength));
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    std::size_t FixedRequest<H,B,M>::header_count () const
+    {
+        return (myHeadersDone);
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    View FixedRequest<H,B,M>::field (std::size_t i) const
+    {
+        const Entry& entry = myHeaders[i];
+        return (View(myHead+entry.field, entry.value-entry.field-1));
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    View FixedRequest<H,B,M>::value (std::size_t i) const
+    {
+        const Entry& entry = myHeaders[i];
+        const std::size_t end =
+            (i+1 < myHeaderCount)? myHeaders[i+1].field : myHeadSize;
+        return (View(myHead+entry.value, end-entry.value-1));
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    bool FixedRequest<H,B,M>::hasheader (View field) const
+    {
+        for (std::size_t i = 0; i < myHeadersDone; ++i)
+        {
+            if (this->field(i) == field) {
+                return (true);
+            }
+        }
+        return (false);
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    View FixedRequest<H,B,M>::header (View field) const
+    {
+        for (std::size_t i = 0; i < myHeadersDone; ++i)
+        {
+            if (this->field(i) == field) {
+                return (value(i));
+            }
+        }
+        return (View());
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    char * FixedRequest<H,B,M>::head ()
+    {
+        return (myHead);
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    std::size_t FixedRequest<H,B,M>::head_size () const
+    {
+        return (myHeadSize);
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    View FixedRequest<H,B,M>::body () const
+    {
+        return (View(myBody, myBodySize));
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    std::size_t FixedRequest<H,B,M>::body_size () const
+    {
+        return (myContentLength);
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    void FixedRequest<H,B,M>::accept_field
+        (::scgi_parser* parser, const char * data, size_t size)
+    {
+        FixedRequest& request = *static_cast<FixedRequest*>(parser->object);
+        if (request.myError != scgi_error_ok) {
+            return;
+        }
+        // Open a new entry at the start of each field.
+        if ((request.myHeaderCount == 0) ||
+            (request.myHeaders[request.myHeaderCount-1].value
+             < request.myHeadSize))
+        {
+            if (request.myHeaderCount == M) {
+                request.myError = scgi_error_head_overflow;
+                return;
+            }
+            request.myHeaders[request.myHeaderCount].field =
+                static_cast<Offset>(request.myHeadSize);
+            // Mark the value as not started yet.
+            request.myHeaders[request.myHeaderCount++].value =
+                static_cast<Offset>(H);
+        }
+        // The parser's limits guarantee the head fits.
+        std::copy(data, data+size, request.myHead+request.myHeadSize);
+        request.myHeadSize += size;
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    void FixedRequest<H,B,M>::finish_field (::scgi_parser * parser)
+    {
+        FixedRequest& request = *static_cast<FixedRequest*>(parser->object);
+        if (request.myError != scgi_error_ok) {
+            return;
+        }
+        request.myHead[request.myHeadSize++] = '\0';
+        request.myHeaders[request.myHeaderCount-1].value =
+            static_cast<Offset>(request.myHeadSize);
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    void FixedRequest<H,B,M>::accept_value
+        (::scgi_parser* parser, const char * data, size_t size)
+    {
+        FixedRequest& request = *static_cast<FixedRequest*>(parser->object);
+        if (request.myError != scgi_error_ok) {
+            return;
+        }
+        std::copy(data, data+size, request.myHead+request.myHeadSize);
+        request.myHeadSize += size;
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    void FixedRequest<H,B,M>::finish_value (::scgi_parser * parser)
+    {
+        FixedRequest& request = *static_cast<FixedRequest*>(parser->object);
+        if (request.myError != scgi_error_ok) {
+            return;
+        }
+        request.myHead[request.myHeadSize++] = '\0';
+        const std::size_t i = request.myHeaderCount-1;
+        request.myHeadersDone = request.myHeaderCount;
+        const View field = request.field(i);
+        if (::scgi_is_content_length(field.data(), field.size()))
+        {
+            const View value = request.value(i);
+            const ::ssize_t content_length =
+                ::scgi_parse_content_length(value.data(), value.size());
+            if (content_length < 0) {
+                request.myError = scgi_error_head_syntax;
+            }
+            else if (static_cast<std::size_t>(content_length) > B) {
+                request.myError = scgi_error_body_overflow;
+            }
+            else {
+                request.myContentLength = content_length;
+            }
+        }
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    void FixedRequest<H,B,M>::finish_head (::scgi_parser* parser)
+    {
+        FixedRequest& request = *static_cast<FixedRequest*>(parser->object);
+        request.myHeadComplete = true;
+    }
+
+    template<std::size_t H, std::size_t B, std::size_t M>
+    size_t FixedRequest<H,B,M>::accept_body
+        (::scgi_parser* parser, const char * data, size_t size)
+    {
+        FixedRequest& request = *static_cast<FixedRequest*>(parser->object);
+        if (request.myError != scgi_error_ok) {
+            return (0);
+        }
+        const std::size_t used = std::min
+            (size, request.myContentLength-request.myBodySize);
+        std::copy(data, data+used, request.myBody+request.myBodySize);
+        request.myBodySize += used;
+        return (used);
+    }
+
 }
 
 #endif /* _scgi_hpp__ */
@@ -0,0 +1,906 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Evented SCGI server: the I/O thread only parses requests, handlers run
+// in a pool of threads and responses come back through a mailbox.  GET
+// responses are cached for a few seconds and cache hits are sent straight
+// from the I/O thread.  Identical GETs that miss the cache while one of
+// them is being handled wait for its response instead of running the
+// handler again.  All connections share a memory budget: under pressure
+// the server stops accepting, then stops reading requests.  Each
+// connection has a deadline for each phase, kept in a timer wheel.  Each
+// client (by "REMOTE_ADDR") gets 100 requests per second, and requests over
+// the limit get a 429 response as soon as the header is parsed.  When
+// built with SCGI_TRACE, 1% of requests are traced to "scgi-epoll.trace".
+//
+// Usage: scgi-epoll [-l address] [capture-file].  The address defaults to
+// "*:9000" and may be a Unix-domain socket path.  Connections are accepted
+// in batches and read right away: with TCP_DEFER_ACCEPT the head is usually
+// there already, and the socket is only watched if it isn't.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <scgi.h>
+#include <scgi-budget.h>
+#include <scgi-cache.h>
+#include <scgi-capture.h>
+#include <scgi-coalesce.h>
+#include <scgi-listener.h>
+#include <scgi-pool.h>
+#include <scgi-throttle.h>
+#include <scgi-timer.h>
+#include <scgi-trace.h>
+
+// Timer wheel resolution, and deadlines for each phase (in ticks).
+#define TICK_MS 100
+#define HEAD_TIMEOUT 100
+#define BODY_TIMEOUT 300
+#define HANDLER_TIMEOUT 600
+#define WRITE_TIMEOUT 100
+
+// Maximum number of connections accepted at once.
+#define ACCEPT_BATCH 64
+
+// Bookkeeping for each connection.
+struct connection_t
+{
+    // SCGI request parser.
+    struct scgi_limits limits;
+    struct scgi_parser parser;
+
+    // Connected socket.
+    int socket;
+
+    // Identifier in the capture file.
+    uint64_t serial;
+    int captured;
+
+    // Buffered header name and value.
+    char field[64];
+    size_t field_size;
+    char value[256];
+    size_t value_size;
+
+    // Headers that make up the cache key.
+    char method[8];
+    size_t method_size;
+    char uri[256];
+    size_t uri_size;
+    char query[256];
+    size_t query_size;
+    int uncacheable;
+
+    // Client is over its rate limit.
+    int limited;
+
+    // Response cache key, and the cached response on a hit.
+    struct scgi_cache_key key;
+    int cacheable;
+    const struct scgi_cache_entry * cached;
+
+    // Identical request being handled, and its response once shared.
+    struct scgi_coalesce_waiter flight;
+    const struct scgi_coalesce_response * shared;
+
+    // Memory charged to the budget: the connection, its head and body.
+    size_t charged;
+
+    // Link in the list of connections whose reads are paused.
+    struct connection_t * paused;
+
+    // Deadline for the current phase.
+    struct scgi_timer deadline;
+    int handling;
+    int timed_out;
+
+    // Request body size, from "CONTENT_LENGTH".
+    size_t content_length;
+    int head_complete;
+
+    // Request body, buffered for the handler.
+    char * body;
+    size_t body_size;
+
+    // Request can't be served (body too large, out of memory).
+    int rejected;
+
+    // Handler task, runs in the pool once the request is complete.
+    struct scgi_task task;
+
+    // Response, formatted by the handler.
+    char response[256];
+    size_t response_size;
+    size_t response_sent;
+    int sending;
+
+    // Refused request whose body is being discarded.
+    int draining;
+
+    // custom data...
+};
+
+// Server state (single I/O thread).
+static int poller = -1;
+static struct scgi_listener listener;
+static struct scgi_pool pool;
+static struct scgi_mailbox mailbox;
+static volatile sig_atomic_t stopped = 0;
+
+// Optional capture of all requests, for offline replay.
+static struct scgi_capture capture;
+static int capturing = 0;
+static uint64_t serial = 0;
+
+// Cache of serialized responses (the I/O thread is the only reader).
+static struct scgi_cache cache;
+
+// Requests whose handler is running, by cache key.
+static struct scgi_coalesce coalesce;
+
+// Memory held by all connections, and the load shedding state.
+static struct scgi_budget budget;
+static int listening = 1;
+static struct connection_t * paused = NULL;
+
+// Per-client rate limits.
+static struct scgi_throttle throttle;
+
+// Deadlines of all connections.
+static struct scgi_timer_wheel timers;
+
+// Tags for non-connection descriptors registered with the poller.
+static char listener_tag;
+static char mailbox_tag;
+
+// SCGI callback functions.
+static void accept_field (struct scgi_parser * parser,
+                          const char * data, size_t size);
+static void accept_value (struct scgi_parser * parser,
+                          const char * data, size_t size);
+static void finish_value (struct scgi_parser * parser);
+static void finish_head (struct scgi_parser * parser);
+static size_t accept_body (struct scgi_parser * parser,
+                           const char * data, size_t size);
+
+// Handler task callbacks.
+static void run_handler (struct scgi_task * task);
+static void send_response (struct scgi_task * task);
+static void deliver_response (struct scgi_coalesce_waiter * waiter,
+                              const struct scgi_coalesce_response * response);
+
+// Deadline callback.
+static void expire_deadline (struct scgi_timer * timer);
+
+static uint64_t current_tick ()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (((uint64_t)now.tv_sec*1000 + now.tv_nsec/1000000) / TICK_MS);
+}
+
+static struct connection_t * prepare_connection (int socket)
+{
+    // Allocate memory for bookkeeping.
+    struct connection_t * connection = NULL;
+    if (scgi_budget_charge(&budget, sizeof(struct connection_t)) < 0) {
+        return (NULL);
+    }
+    connection = malloc(sizeof(struct connection_t));
+    if (connection == NULL) {
+        scgi_budget_credit(&budget, sizeof(struct connection_t));
+        return (NULL);
+    }
+    memset(connection, 0, sizeof(struct connection_t));
+    connection->charged = sizeof(struct connection_t);
+
+    // Prepare the SCGI connection parser.
+    connection->limits.max_head_size =  2*1024;
+    connection->limits.max_body_size = 64*1024;
+    scgi_setup(&connection->limits, &connection->parser);
+    connection->parser.accept_field = accept_field;
+    connection->parser.accept_value = accept_value;
+    connection->parser.finish_value = finish_value;
+    connection->parser.finish_head = finish_head;
+    connection->parser.accept_body = accept_body;
+    connection->parser.object = connection;
+
+    // Handler runs in the pool, response is sent from the I/O thread.
+    connection->task.owner = &mailbox;
+    connection->task.run = run_handler;
+    connection->task.done = send_response;
+    connection->flight.deliver = deliver_response;
+    connection->flight.object = connection;
+
+    // Slow clients get a limited time to send the head.
+    scgi_timer_setup(&connection->deadline, expire_deadline);
+    scgi_timer_start(&timers, &connection->deadline, HEAD_TIMEOUT);
+
+    connection->socket = socket;
+    connection->serial = ++serial;
+    return (connection);
+}
+
+static void release_connection (struct connection_t * connection)
+{
+    struct connection_t ** link = &paused;
+
+    if (capturing) {
+        scgi_capture_write(&capture, connection->serial,
+                           scgi_capture_end, NULL, 0);
+    }
+    if (connection->cached) {
+        scgi_cache_unref(connection->cached);
+    }
+    if (connection->shared) {
+        scgi_coalesce_unref(connection->shared);
+    }
+    scgi_timer_stop(&timers, &connection->deadline);
+
+    // Forget paused reads.
+    while ((*link != NULL) && (*link != connection)) {
+        link = &(*link)->paused;
+    }
+    if (*link != NULL) {
+        *link = connection->paused;
+    }
+
+    // Closing the socket also removes it from the poller.
+    close(connection->socket);
+    free(connection->body);
+    scgi_budget_credit(&budget, connection->charged);
+    free(connection);
+}
+
+static void append (char * buffer, size_t * used, size_t capacity,
+                    const char * data, size_t size)
+{
+    // Truncate values we don't care about.
+    if (size > (capacity-*used)) {
+        size = capacity-*used;
+    }
+    memcpy(buffer+*used, data, size), *used += size;
+}
+
+static void accept_field (struct scgi_parser * parser,
+                          const char * data, size_t size)
+{
+    struct connection_t * connection = parser->object;
+    append(connection->field, &connection->field_size,
+           sizeof(connection->field), data, size);
+}
+
+static void accept_value (struct scgi_parser * parser,
+                          const char * data, size_t size)
+{
+    struct connection_t * connection = parser->object;
+    append(connection->value, &connection->value_size,
+           sizeof(connection->value), data, size);
+}
+
+// Keep a header value that is part of the cache key.
+static void keep (struct connection_t * connection,
+                  char * buffer, size_t * used, size_t capacity)
+{
+    // A full buffer may hold a truncated value: don't cache.
+    if ((connection->value_size >= sizeof(connection->value)) ||
+        (connection->value_size >= capacity))
+    {
+        connection->uncacheable = 1;
+        return;
+    }
+    memcpy(buffer, connection->value, connection->value_size);
+    *used = connection->value_size;
+}
+
+static int is_field (const struct connection_t * connection,
+                     const char * name)
+{
+    return ((connection->field_size == strlen(name)) &&
+            (memcmp(connection->field, name, connection->field_size) == 0));
+}
+
+static void finish_value (struct scgi_parser * parser)
+{
+    struct connection_t * connection = parser->object;
+    ssize_t content_length = 0;
+
+    if (scgi_is_content_length(connection->field, connection->field_size))
+    {
+        content_length = scgi_parse_content_length(connection->value,
+                                                   connection->value_size);
+        if (content_length > 0) {
+            connection->content_length = content_length;
+        }
+    }
+    else if (is_field(connection, "REQUEST_METHOD")) {
+        keep(connection, connection->method, &connection->method_size,
+             sizeof(connection->method));
+    }
+    else if (is_field(connection, "REQUEST_URI")) {
+        keep(connection, connection->uri, &connection->uri_size,
+             sizeof(connection->uri));
+    }
+    else if (is_field(connection, "QUERY_STRING")) {
+        keep(connection, connection->query, &connection->query_size,
+             sizeof(connection->query));
+    }
+    else if (scgi_throttle_is_field(&throttle, connection->field,
+                                    connection->field_size))
+    {
+        connection->limited = !scgi_throttle_admit(
+            &throttle, connection->value, connection->value_size);
+    }
+    connection->field_size = 0;
+    connection->value_size = 0;
+}
+
+static void finish_head (struct scgi_parser * parser)
+{
+    struct connection_t * connection = parser->object;
+    connection->head_complete = 1;
+    if ((connection->content_length > 0) && !connection->limited)
+    {
+        // The whole body is buffered for the handler.
+        if (connection->content_length > connection->limits.max_body_size) {
+            connection->rejected = 1;
+            return;
+        }
+        if (scgi_budget_charge(&budget, connection->content_length) < 0) {
+            connection->rejected = 1;
+            return;
+        }
+        connection->charged += connection->content_length;
+        connection->body = malloc(connection->content_length);
+        if (connection->body == NULL) {
+            connection->rejected = 1;
+            return;
+        }
+        scgi_timer_start(&timers, &connection->deadline, BODY_TIMEOUT);
+    }
+
+    // Only cache GET requests without a body.
+    if (connection->limited || connection->uncacheable ||
+        (connection->content_length > 0) || (connection->method_size != 3) ||
+        (memcmp(connection->method, "GET", 3) != 0))
+    {
+        return;
+    }
+    scgi_cache_key_clear(&connection->key);
+    scgi_cache_key_append(&connection->key,
+                          connection->method, connection->method_size);
+    scgi_cache_key_append(&connection->key,
+                          connection->uri, connection->uri_size);
+    scgi_cache_key_append(&connection->key,
+                          connection->query, connection->query_size);
+    connection->cacheable = !connection->key.overflow;
+
+    // Check the cache before the handler is even scheduled.
+    if (connection->cacheable) {
+        connection->cached = scgi_cache_lookup(&cache, 0, &connection->key);
+    }
+}
+
+static size_t accept_body (struct scgi_parser * parser,
+                           const char * data, size_t size)
+{
+    struct connection_t * connection = parser->object;
+
+    // Nowhere to put the body: stop parsing.
+    if (connection->body == NULL) {
+        return (0);
+    }
+
+    // Never read past the request body.
+    if (size > (connection->content_length-connection->body_size)) {
+        size = connection->content_length-connection->body_size;
+    }
+    memcpy(connection->body+connection->body_size, data, size);
+    connection->body_size += size;
+    return (size);
+}
+
+static int request_complete (const struct connection_t * connection)
+{
+    return (connection->head_complete &&
+            (connection->parser.body_size >= connection->content_length));
+}
+
+// Runs in a handler thread: never touches the socket.
+static void run_handler (struct scgi_task * task)
+{
+    struct connection_t * connection = (struct connection_t*)
+        ((char*)task - offsetof(struct connection_t, task));
+    const char head[] =
+        "Status: 200 OK" "\r\n"
+        "Content-Type: text/plain" "\r\n"
+        "\r\n"
+        ;
+    int used = 0;
+    scgi_trace_record(connection->parser.trace, scgi_trace_handler_begin, 0);
+
+    // Greet, or report what was posted.
+    if (connection->body_size == 0) {
+        used = snprintf(connection->response, sizeof(connection->response),
+                        "%shello world\n", head);
+    }
+    else {
+        used = snprintf(connection->response, sizeof(connection->response),
+                        "%sreceived %zu bytes\n", head, connection->body_size);
+    }
+    connection->response_size = used;
+
+    // Later identical requests are served from the cache.
+    if (connection->cacheable) {
+        scgi_cache_insert(&cache, &connection->key,
+                          connection->response, connection->response_size);
+    }
+    scgi_trace_record(connection->parser.trace, scgi_trace_handler_end, 0);
+}
+
+// Change the events a connection is watched for.
+static int rewatch (struct connection_t * connection, uint32_t events)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.ptr = connection;
+
+    // Cache hits and 429s are sent while the socket is watched for input.
+    if (epoll_ctl(poller, EPOLL_CTL_MOD, connection->socket, &event) == 0) {
+        return (0);
+    }
+    if (errno != ENOENT) {
+        return (-1);
+    }
+    return (epoll_ctl(poller, EPOLL_CTL_ADD, connection->socket, &event));
+}
+
+// Discard input until the client closes its end.
+static void drain_request (struct connection_t * connection)
+{
+    char data[4096];
+    ssize_t size = 0;
+
+    for (;;)
+    {
+        size = read(connection->socket, data, sizeof(data));
+        if ((size < 0) && (errno == EINTR)) {
+            continue;
+        }
+        if ((size < 0) && (errno == EAGAIN) &&
+            (rewatch(connection, EPOLLIN) == 0))
+        {
+            return;
+        }
+        if (size <= 0) {
+            break;
+        }
+    }
+    release_connection(connection);
+}
+
+// Runs in the I/O thread once the handler completes.
+static void send_response (struct scgi_task * task)
+{
+    struct connection_t * connection = (struct connection_t*)
+        ((char*)task - offsetof(struct connection_t, task));
+    const char * response = connection->response;
+    ssize_t used = 0;
+
+    // Requests waiting for this one get the response, even if this
+    // client is gone (does nothing for other requests).
+    scgi_coalesce_finish(&coalesce, &connection->flight,
+                         connection->response, connection->response_size);
+
+    // The client is gone if the handler took too long.
+    connection->handling = 0;
+    if (connection->timed_out) {
+        release_connection(connection);
+        return;
+    }
+    if (connection->cached) {
+        response = connection->cached->data;
+    }
+    if (connection->shared) {
+        response = connection->shared->data;
+    }
+    if (connection->limited) {
+        response = throttle.response;
+    }
+    while (connection->response_sent < connection->response_size)
+    {
+        used = write(connection->socket,
+                     response+connection->response_sent,
+                     connection->response_size-connection->response_sent);
+        if (used < 0)
+        {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN) && (rewatch(connection, EPOLLOUT) == 0))
+            {
+                // Finish sending when the socket becomes writable.
+                connection->sending = 1;
+                scgi_timer_start(&timers, &connection->deadline,
+                                 WRITE_TIMEOUT);
+                return;
+            }
+            break;
+        }
+        connection->response_sent += used;
+    }
+
+    // Don't close on an unread body: that would reset the connection and
+    // the client could lose the 429.
+    if (connection->limited &&
+        (connection->response_sent == connection->response_size))
+    {
+        connection->sending = 0;
+        connection->draining = 1;
+        shutdown(connection->socket, SHUT_WR);
+        scgi_timer_start(&timers, &connection->deadline, WRITE_TIMEOUT);
+        drain_request(connection);
+        return;
+    }
+    release_connection(connection);
+}
+
+// Returns 1 if the socket must be watched for more input.
+static int read_request (struct connection_t * connection)
+{
+    char data[4096];
+    ssize_t size = 0;
+    size_t used = 0;
+    size_t body_size = 0;
+
+    while (!request_complete(connection))
+    {
+        // Under memory pressure, leave the rest in the socket buffer.
+        if (scgi_budget_state(&budget) == scgi_budget_pause)
+        {
+            epoll_ctl(poller, EPOLL_CTL_DEL, connection->socket, NULL);
+            connection->paused = paused;
+            paused = connection;
+            return (0);
+        }
+        size = read(connection->socket, data, sizeof(data));
+        if ((size < 0) && (errno == EINTR)) {
+            continue;
+        }
+        if ((size < 0) && (errno == EAGAIN)) {
+            return (1);
+        }
+        if (size <= 0) {
+            release_connection(connection);
+            return (0);
+        }
+
+        // Record the read, with its boundaries, before parsing it.
+        if (capturing)
+        {
+            scgi_capture_write(&capture, connection->serial,
+                               connection->captured? 0 : scgi_capture_begin,
+                               data, size);
+            connection->captured = 1;
+        }
+
+        // Feed the input data to the SCGI request parser.
+        body_size = connection->parser.body_size;
+        used = scgi_consume(&connection->parser, data, size);
+
+        // The body buffer is charged when allocated, charge the head as it
+        // arrives (the request can't make progress without it).
+        used -= connection->parser.body_size - body_size;
+        scgi_budget_force(&budget, used);
+        connection->charged += used;
+        if (connection->parser.error != scgi_error_ok)
+        {
+            fprintf(stderr, "SCGI request error: \"%s\".\n",
+                    scgi_error_message(connection->parser.error));
+            release_connection(connection);
+            return (0);
+        }
+        if (connection->rejected)
+        {
+            fprintf(stderr, "Request body can't be buffered.\n");
+            release_connection(connection);
+            return (0);
+        }
+
+        // Over the limit: skip the body and the handler.
+        if (connection->limited)
+        {
+            connection->response_size = throttle.response_size;
+            send_response(&connection->task);
+            return (0);
+        }
+    }
+
+    // Cache hit: no handler needed.
+    if (connection->cached)
+    {
+        connection->response_size = connection->cached->size;
+        send_response(&connection->task);
+        return (0);
+    }
+
+    // Stop watching the socket until the response is ready.
+    epoll_ctl(poller, EPOLL_CTL_DEL, connection->socket, NULL);
+    connection->handling = 1;
+    scgi_timer_start(&timers, &connection->deadline, HANDLER_TIMEOUT);
+
+    // Cache miss: wait if an identical request is already being handled.
+    if (connection->cacheable &&
+        (scgi_coalesce_join(&coalesce, &connection->key,
+                            &connection->flight) == 0))
+    {
+        return (0);
+    }
+    scgi_pool_submit(&pool, &connection->task);
+    return (0);
+}
+
+// Runs in the I/O thread, when the request this one waited for is done.
+static void deliver_response (struct scgi_coalesce_waiter * waiter,
+                              const struct scgi_coalesce_response * response)
+{
+    struct connection_t * connection = waiter->object;
+
+    // That handler failed: run this request's own.
+    if (response == NULL) {
+        scgi_pool_submit(&pool, &connection->task);
+        return;
+    }
+    connection->shared = response;
+    connection->response_size = response->size;
+    send_response(&connection->task);
+}
+
+static void expire_deadline (struct scgi_timer * timer)
+{
+    struct connection_t * connection = (struct connection_t*)
+        ((char*)timer - offsetof(struct connection_t, deadline));
+
+    // The handler still owns the connection: drop the client now and
+    // release the connection when the handler is done.
+    if (connection->handling)
+    {
+        connection->timed_out = 1;
+        shutdown(connection->socket, SHUT_RDWR);
+        return;
+    }
+    release_connection(connection);
+}
+
+static int watch (int socket, void * tag)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = tag;
+    return (epoll_ctl(poller, EPOLL_CTL_ADD, socket, &event));
+}
+
+static void accept_connections ()
+{
+    int sockets[ACCEPT_BATCH];
+    int count = ACCEPT_BATCH;
+    int i = 0;
+    struct connection_t * connection = NULL;
+
+    while (listening && (count == ACCEPT_BATCH))
+    {
+        // Leave new connections in the backlog until memory is freed.
+        if (scgi_budget_state(&budget) != scgi_budget_normal)
+        {
+            epoll_ctl(poller, EPOLL_CTL_DEL, listener.socket, NULL);
+            listening = 0;
+            break;
+        }
+        count = scgi_listener_accept(&listener, sockets, ACCEPT_BATCH);
+        for (i = 0; i < count; ++i)
+        {
+            connection = prepare_connection(sockets[i]);
+            if (connection == NULL) {
+                close(sockets[i]);
+                continue;
+            }
+            // Parse what has already arrived before involving the poller.
+            if (read_request(connection) &&
+                (watch(sockets[i], connection) < 0))
+            {
+                release_connection(connection);
+            }
+        }
+    }
+}
+
+// Resume accepting and reading once memory pressure drops.
+static void shed_load ()
+{
+    struct connection_t * connection = NULL;
+    const enum scgi_budget_state state = scgi_budget_state(&budget);
+
+    if (!listening && (state == scgi_budget_normal))
+    {
+        watch(listener.socket, &listener_tag);
+        listening = 1;
+    }
+    while ((paused != NULL) && (state != scgi_budget_pause))
+    {
+        connection = paused, paused = connection->paused;
+        connection->paused = NULL;
+        watch(connection->socket, connection);
+    }
+}
+
+static void stop (int signal)
+{
+    (void)signal;
+    stopped = 1;
+}
+
+int main (int argc, char ** argv)
+{
+    struct epoll_event events[64];
+    int count = 0;
+    int i = 0;
+    long threads = 0;
+    const char * address = "*:9000";
+    int option = 0;
+
+    while ((option = getopt(argc, argv, "l:")) != -1)
+    {
+        if (option != 'l')
+        {
+            fprintf(stderr, "Usage: scgi-epoll [-l address] [capture]\n");
+            return (EXIT_FAILURE);
+        }
+        address = optarg;
+    }
+
+    // Only wake up once the client has sent its request.
+    scgi_listener_setup(&listener);
+    listener.defer = 1;
+    if (scgi_listener_open(&listener, address) < 0)
+    {
+        perror("Couldn't create listener");
+        return (EXIT_FAILURE);
+    }
+
+    // Capture all requests, if asked to.
+    if (optind < argc)
+    {
+        if (scgi_capture_open(&capture, argv[optind]) < 0)
+        {
+            perror("Couldn't open capture file");
+            return (EXIT_FAILURE);
+        }
+        capturing = 1;
+    }
+
+    // One handler thread per core.
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) {
+        threads = 1;
+    }
+#ifdef SCGI_TRACE
+    scgi_trace_setup(100, 64*1024);
+#endif
+    scgi_budget_setup(&budget, 64*1024*1024);
+    scgi_timer_wheel_setup(&timers, current_tick());
+    if (scgi_cache_setup(&cache, 1, 16*1024*1024, 5000) < 0)
+    {
+        perror("Couldn't create response cache");
+        return (EXIT_FAILURE);
+    }
+    if (scgi_coalesce_setup(&coalesce, 1024) < 0)
+    {
+        perror("Couldn't create request coalescing table");
+        return (EXIT_FAILURE);
+    }
+    if (scgi_throttle_setup(&throttle, 64*1024, 100, 200) < 0)
+    {
+        perror("Couldn't create rate limiter");
+        return (EXIT_FAILURE);
+    }
+    if ((scgi_mailbox_setup(&mailbox) < 0) ||
+        (scgi_pool_setup(&pool, threads) < 0))
+    {
+        perror("Couldn't start handler pool");
+        return (EXIT_FAILURE);
+    }
+
+    poller = epoll_create1(EPOLL_CLOEXEC);
+    if ((poller < 0) ||
+        (watch(listener.socket, &listener_tag) < 0) ||
+        (watch(scgi_mailbox_fd(&mailbox), &mailbox_tag) < 0))
+    {
+        perror("Couldn't create poller");
+        return (EXIT_FAILURE);
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop;
+    sigaction(SIGINT, &action, 0);
+    sigaction(SIGTERM, &action, 0);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Process event notifications until stopped.
+    while (!stopped)
+    {
+        // Cached responses removed since the last pass may be reclaimed.
+        scgi_cache_quiescent(&cache, 0);
+        shed_load();
+
+        count = epoll_wait(poller, events, 64,
+                           (timers.count > 0)? TICK_MS : -1);
+        for (i = 0; i < count; ++i)
+        {
+            if (events[i].data.ptr == &listener_tag) {
+                accept_connections();
+            }
+            else if (events[i].data.ptr == &mailbox_tag) {
+                scgi_mailbox_dispatch(&mailbox);
+            }
+            else if (((struct connection_t*)events[i].data.ptr)->draining) {
+                drain_request(events[i].data.ptr);
+            }
+            else if (((struct connection_t*)events[i].data.ptr)->sending) {
+                send_response(&((struct connection_t*)
+                                events[i].data.ptr)->task);
+            }
+            else {
+                read_request(events[i].data.ptr);
+            }
+        }
+        scgi_timer_wheel_advance(&timers, current_tick());
+    }
+
+    scgi_pool_release(&pool);
+    scgi_mailbox_dispatch(&mailbox);
+    scgi_mailbox_release(&mailbox);
+    scgi_cache_release(&cache);
+    scgi_coalesce_release(&coalesce);
+    scgi_throttle_release(&throttle);
+    close(poller);
+    scgi_listener_close(&listener);
+    if (capturing) {
+        scgi_capture_close(&capture);
+    }
+#ifdef SCGI_TRACE
+    if (scgi_trace_save("scgi-epoll.trace") < 0) {
+        perror("Couldn't save trace");
+    }
+#endif
+    return (EXIT_SUCCESS);
+}
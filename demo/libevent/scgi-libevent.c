@@ -18,16 +18,23 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
-#include <arpa/inet.h>
 #include <errno.h>
 #include <event2/buffer.h>
 #include <event2/bufferevent.h>
-#include <event2/listener.h>
+#include <event2/event.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <scgi.h>
+#include <scgi-listener.h>
+
+// Maximum number of connections accepted at once.
+#define ACCEPT_BATCH 64
+
+// Listening socket (TCP or Unix-domain).
+static struct scgi_listener listener;
 
 // Bookkeeping for each connection.
 struct connection_t
@@ -131,6 +138,9 @@ static void finish_head (struct scgi_parser * parser)
         "hello world\n"
         ;
     evbuffer_add(output, response, sizeof(response)-1);
+
+    // Write callback closes the connection once the response is sent.
+    bufferevent_enable(connection->stream, EV_WRITE);
 }
 
 static size_t accept_body (struct scgi_parser * parser,
@@ -143,6 +153,28 @@ static size_t accept_body (struct scgi_parser * parser,
     return (size);
 }
 
+// Returns -1 if the connection was dropped.
+static int feed (struct connection_t * connection,
+                 const char * data, size_t size)
+{
+    // Feed the input data to the SCGI request parser.
+    //   All actual processing is done inside the SCGI callbacks
+    //   registered by our application.  Callbacks are always
+    //   invoked by a call to "scgi_consume()".
+    scgi_consume(&connection->parser, data, size);
+    if (connection->parser.error != scgi_error_ok)
+    {
+        // Log the error.
+        fprintf(stderr, "SCGI request error: \"%s\".\n",
+                scgi_error_message(connection->parser.error));
+
+        // Drop connection.
+        release_connection(connection);
+        return (-1);
+    }
+    return (0);
+}
+
 static void read_cb (struct bufferevent * stream, void * context)
 {
     struct connection_t * connection = context;
@@ -165,22 +197,7 @@ static void read_cb (struct bufferevent * stream, void * context)
         // Exit
         return;
     }
- 
-    // Feed the input data to the SCGI request parser.
-    //   All actual processing is done inside the SCGI callbacks
-    //   registered by our application.  Callbacks are always
-    //   invoked by a call to "scgi_consume()".
-    size_t used = scgi_consume(&connection->limits,
-                               &connection->parser, data, size);
-    if (connection->parser.error != scgi_error_ok)
-    {
-        // Log the error.
-        fprintf(stderr, "SCGI request error: \"%s\".\n",
-                scgi_error_message(connection->parser.error));
-
-        // Drop connection.
-        release_connection(connection);
-    }
+    feed(connection, data, size);
 
     // Release our copy of the input data.
     free(data), data = 0;
@@ -211,39 +228,61 @@ static void echo_event_cb (struct bufferevent * stream,
     }
 }
 
-static void accept_conn_cb (struct evconnlistener * listener,
-                            evutil_socket_t socket,
-                            struct sockaddr * peer, int size, void * context)
+static void open_connection (struct event_base * base, int socket)
 {
+    char data[4096];
+    ssize_t size = 0;
+
     // Prepare an SCGI request parser for the new connection.
     struct connection_t * connection = prepare_connection();
     if (connection == NULL) {
-        // TOOD: handle memory allocation failure (close socket?).
+        close(socket);
+        return;
     }
 
     // Prepare to read and write over the connected socket.
-    struct event_base * base = evconnlistener_get_base(listener);
     struct bufferevent * stream = bufferevent_socket_new(base, socket,
                                                          BEV_OPT_CLOSE_ON_FREE);
     if (stream == NULL) {
-        // TODO: handle initialization failure.
+        close(socket);
+        free(connection);
+        return;
     }
     connection->stream = stream;
     bufferevent_setcb(stream, read_cb, write_cb, echo_event_cb, connection);
-    bufferevent_enable(stream, EV_READ|EV_WRITE);
+
+    // The head has usually arrived by now (deferred accept): parse it
+    // before handing the socket to the event loop.
+    size = read(socket, data, sizeof(data));
+    if ((size == 0) || ((size < 0) && (errno != EAGAIN))) {
+        release_connection(connection);
+        return;
+    }
+    if ((size > 0) && (feed(connection, data, size) < 0)) {
+        return;
+    }
+    bufferevent_enable(stream, EV_READ);
 }
 
-static void accept_error_cb (struct evconnlistener * listener, void * context)
+static void accept_cb (evutil_socket_t socket, short events, void * context)
 {
-    struct event_base * base = evconnlistener_get_base(listener);
+    struct event_base * base = context;
+    int sockets[ACCEPT_BATCH];
+    int count = ACCEPT_BATCH;
+    int i = 0;
 
-    // Log the error.
-    const int error = EVUTIL_SOCKET_ERROR();
-    fprintf(stderr, "Got an error %d (%s) on the listener. "
-            "Shutting down.\n", error, evutil_socket_error_to_string(error));
+    (void)socket;
+    (void)events;
 
-    // Kill the application's main event loop.
-    event_base_loopexit(base, NULL);
+    // Drain the accept queue.  On errors (e.g. out of descriptors), leave
+    // the rest in the backlog until the next notification.
+    while (count == ACCEPT_BATCH)
+    {
+        count = scgi_listener_accept(&listener, sockets, ACCEPT_BATCH);
+        for (i = 0; i < count; ++i) {
+            open_connection(base, sockets[i]);
+        }
+    }
 }
 
 int main (int argc, char ** argv)
@@ -254,26 +293,22 @@ int main (int argc, char ** argv)
         return EXIT_FAILURE;
     }
 
-    // Configure to listen on *:9000.
-    struct sockaddr_in host;
-    memset(&host, 0, sizeof(host));
-    host.sin_family      = AF_INET;
-    host.sin_addr.s_addr = htonl(0);
-    host.sin_port        = htons(9000);
-
-    // Start listening for incomming connections.
-    struct evconnlistener * listener = evconnlistener_new_bind(
-        base, accept_conn_cb, NULL,
-        LEV_OPT_CLOSE_ON_FREE|LEV_OPT_REUSEABLE,
-        -1,
-        (struct sockaddr*)&host, sizeof(host));
-    if (!listener) {
+    // Listen on *:9000 unless told otherwise (e.g. "/run/app.sock").
+    scgi_listener_setup(&listener);
+    listener.defer = 1;
+    if (scgi_listener_open(&listener, (argc > 1)? argv[1] : "*:9000") < 0)
+    {
         perror("Couldn't create listener");
         return 1;
     }
 
-    // Handle errors with the listening socket (e.g. network goes down).
-    evconnlistener_set_error_cb(listener, accept_error_cb);
+    // Start accepting incomming connections.
+    struct event * accepting = event_new(base, listener.socket,
+                                         EV_READ|EV_PERSIST, accept_cb, base);
+    if (!accepting || (event_add(accepting, NULL) < 0)) {
+        puts("Couldn't watch listener");
+        return EXIT_FAILURE;
+    }
 
     // Process event notifications forever.
     event_base_dispatch(base);
@@ -0,0 +1,237 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <arpa/inet.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <scgi.h>
+#include <scgi-prefork.h>
+
+// Bookkeeping for the request being served by this worker.
+struct request_t
+{
+    // SCGI request parser.
+    struct scgi_limits limits;
+    struct scgi_parser parser;
+
+    // Connected socket.
+    int socket;
+
+    // Buffered header name and value.
+    char field[64];
+    size_t field_size;
+    char value[64];
+    size_t value_size;
+
+    // Request body size, from "CONTENT_LENGTH".
+    size_t content_length;
+    int head_complete;
+
+    // Request body, up to the parser's limit.
+    char body[64*1024];
+    size_t body_size;
+
+    // custom data...
+};
+
+static struct scgi_prefork server;
+
+static void append (char * buffer, size_t * used, size_t capacity,
+                    const char * data, size_t size)
+{
+    // Truncate values we don't care about.
+    if (size > (capacity-*used)) {
+        size = capacity-*used;
+    }
+    memcpy(buffer+*used, data, size), *used += size;
+}
+
+static void accept_field (struct scgi_parser * parser,
+                          const char * data, size_t size)
+{
+    struct request_t * request = parser->object;
+    append(request->field, &request->field_size,
+           sizeof(request->field), data, size);
+}
+
+static void accept_value (struct scgi_parser * parser,
+                          const char * data, size_t size)
+{
+    struct request_t * request = parser->object;
+    append(request->value, &request->value_size,
+           sizeof(request->value), data, size);
+}
+
+static void finish_value (struct scgi_parser * parser)
+{
+    struct request_t * request = parser->object;
+    ssize_t content_length = 0;
+
+    if (scgi_is_content_length(request->field, request->field_size))
+    {
+        content_length = scgi_parse_content_length(request->value,
+                                                   request->value_size);
+        if (content_length > 0) {
+            request->content_length = content_length;
+        }
+    }
+    request->field_size = 0;
+    request->value_size = 0;
+}
+
+static void finish_head (struct scgi_parser * parser)
+{
+    struct request_t * request = parser->object;
+    request->head_complete = 1;
+}
+
+static size_t accept_body (struct scgi_parser * parser,
+                           const char * data, size_t size)
+{
+    struct request_t * request = parser->object;
+
+    // Never read past the request body.
+    if (size > (request->content_length-request->body_size)) {
+        size = request->content_length-request->body_size;
+    }
+    append(request->body, &request->body_size,
+           sizeof(request->body), data, size);
+    return (size);
+}
+
+static int request_complete (const struct request_t * request)
+{
+    return (request->head_complete &&
+            (request->parser.body_size >= request->content_length));
+}
+
+// Runs in a worker process, one connection at a time.
+static void serve (struct scgi_prefork * server, int socket)
+{
+    struct request_t request;
+    char data[4096];
+    ssize_t size = 0;
+
+    (void)server;
+
+    // Prepare the SCGI request parser.
+    memset(&request, 0, sizeof(request));
+    request.limits.max_head_size =  2*1024;
+    request.limits.max_body_size = 64*1024;
+    scgi_setup(&request.limits, &request.parser);
+    request.parser.accept_field = accept_field;
+    request.parser.accept_value = accept_value;
+    request.parser.finish_value = finish_value;
+    request.parser.finish_head = finish_head;
+    request.parser.accept_body = accept_body;
+    request.parser.object = &request;
+    request.socket = socket;
+
+    // Parse the request as it arrives.
+    while (!request_complete(&request))
+    {
+        size = read(socket, data, sizeof(data));
+        if (size <= 0) {
+            return;
+        }
+        scgi_consume(&request.parser, data, size);
+        if (request.parser.error != scgi_error_ok)
+        {
+            fprintf(stderr, "SCGI request error: \"%s\".\n",
+                    scgi_error_message(request.parser.error));
+            return;
+        }
+    }
+
+    // Respond, echoing the body if there is one.
+    const char head[] =
+        "Status: 200 OK" "\r\n"
+        "Content-Type: text/plain" "\r\n"
+        "\r\n"
+        ;
+    const char greeting[] = "hello world\n";
+    if ((write(socket, head, sizeof(head)-1) < 0) ||
+        ((request.body_size == 0) &&
+         (write(socket, greeting, sizeof(greeting)-1) < 0)) ||
+        ((request.body_size > 0) &&
+         (write(socket, request.body, request.body_size) < 0)))
+    {
+        perror("Couldn't send response");
+    }
+}
+
+static void stop (int signal)
+{
+    (void)signal;
+    scgi_prefork_stop(&server);
+}
+
+int main ()
+{
+    // Configure to listen on *:9000.
+    struct sockaddr_in host;
+    memset(&host, 0, sizeof(host));
+    host.sin_family      = AF_INET;
+    host.sin_addr.s_addr = htonl(0);
+    host.sin_port        = htons(9000);
+
+    const int listener = socket(AF_INET, SOCK_STREAM, 0);
+    const int enable = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if ((bind(listener, (struct sockaddr*)&host, sizeof(host)) < 0) ||
+        (listen(listener, SOMAXCONN) < 0))
+    {
+        perror("Couldn't create listener");
+        return (EXIT_FAILURE);
+    }
+
+    // One worker per core.
+    long workers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers < 1) {
+        workers = 1;
+    }
+    if (scgi_prefork_setup(&server, listener, workers) < 0)
+    {
+        perror("Couldn't create scoreboard");
+        return (EXIT_FAILURE);
+    }
+    server.serve = serve;
+
+    // Let the accept loop return on SIGINT/SIGTERM.
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop;
+    sigaction(SIGINT, &action, 0);
+    sigaction(SIGTERM, &action, 0);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Accept connections until stopped.
+    if (scgi_prefork_run(&server) < 0) {
+        perror("Couldn't accept connection");
+    }
+    scgi_prefork_release(&server);
+    close(listener);
+    return (EXIT_SUCCESS);
+}
@@ -0,0 +1,201 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.h"
+#include "scgi-archive.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+    // Statistics gathered by each thread, merged at the end.
+    struct Totals
+    {
+        unsigned long requests;
+        unsigned long errors;
+        unsigned long body_bytes;
+        std::map<std::string, unsigned long> headers;
+        std::vector<unsigned long> body_sizes;
+
+        Totals ()
+            : requests(0), errors(0), body_bytes(0), body_sizes(33, 0)
+        {}
+
+        void merge (const Totals& other)
+        {
+            requests += other.requests;
+            errors += other.errors;
+            body_bytes += other.body_bytes;
+            std::map<std::string, unsigned long>::const_iterator current =
+                other.headers.begin();
+            for (; current != other.headers.end(); ++current) {
+                headers[current->first] += current->second;
+            }
+            for (std::size_t i = 0; i < body_sizes.size(); ++i) {
+                body_sizes[i] += other.body_sizes[i];
+            }
+        }
+    };
+
+    // Per-thread parser and results.
+    struct Worker
+    {
+        ::scgi_limits limits;
+        ::scgi_parser parser;
+        std::string field;
+        std::size_t body_size;
+        Totals totals;
+    };
+
+    void accept_field (::scgi_parser * parser, const char * data, size_t size)
+    {
+        static_cast<Worker*>(parser->object)->field.append(data, size);
+    }
+
+    void accept_value (::scgi_parser *, const char *, size_t)
+    {
+    }
+
+    void finish_value (::scgi_parser * parser)
+    {
+        Worker& worker = *static_cast<Worker*>(parser->object);
+        ++worker.totals.headers[worker.field];
+        worker.field.clear();
+    }
+
+    void finish_head (::scgi_parser *)
+    {
+    }
+
+    size_t accept_body (::scgi_parser * parser, const char *, size_t size)
+    {
+        static_cast<Worker*>(parser->object)->body_size += size;
+        return (size);
+    }
+
+    // Power of 2 bucket for a body size: 0, 1, 2-3, 4-7, ...
+    std::size_t bucket (std::size_t size)
+    {
+        std::size_t index = 0;
+        for (; size > 0; size >>= 1) {
+            ++index;
+        }
+        return (index);
+    }
+
+    // Runs in the worker threads.
+    void visit (void * object, size_t thread, const char * data, size_t size)
+    {
+        Worker& worker = (*static_cast<std::vector<Worker>*>(object))[thread];
+        ::scgi_setup(&worker.limits, &worker.parser);
+        worker.parser.object = &worker;
+        worker.parser.accept_field = &accept_field;
+        worker.parser.accept_value = &accept_value;
+        worker.parser.finish_value = &finish_value;
+        worker.parser.finish_head = &finish_head;
+        worker.parser.accept_body = &accept_body;
+        worker.field.clear();
+        worker.body_size = 0;
+        ::scgi_consume(&worker.parser, data, size);
+        ++worker.totals.requests;
+        if (worker.parser.error != scgi_error_ok) {
+            ++worker.totals.errors;
+            return;
+        }
+        worker.totals.body_bytes += worker.body_size;
+        ++worker.totals.body_sizes[bucket(worker.body_size)];
+    }
+
+}
+
+int main (int argc, char ** argv)
+{
+    long threads = ::sysconf(_SC_NPROCESSORS_ONLN);
+    int arg = 1;
+    if ((argc == 4) && (std::strcmp(argv[1], "--threads") == 0)) {
+        threads = std::atol(argv[2]), arg = 3;
+    }
+    if ((arg != argc-1) || (threads < 1))
+    {
+        std::cerr
+            << "Usage: scgi-archive [--threads N] <archive-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    ::scgi_archive archive;
+    if (::scgi_archive_map(&archive, argv[arg]) < 0)
+    {
+        std::cerr
+            << "Could not map archive: " << std::strerror(errno) << "."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+
+    std::vector<Worker> workers(threads);
+    for (std::size_t i = 0; i < workers.size(); ++i) {
+        workers[i].limits.max_head_size = 0;
+        workers[i].limits.max_body_size = 0;
+    }
+    if (::scgi_archive_run(&archive, workers.size(), &visit, &workers) < 0)
+    {
+        std::cerr
+            << "Could not start threads: " << std::strerror(errno) << "."
+            << std::endl;
+        ::scgi_archive_unmap(&archive);
+        return (EXIT_FAILURE);
+    }
+    Totals totals;
+    for (std::size_t i = 0; i < workers.size(); ++i) {
+        totals.merge(workers[i].totals);
+    }
+
+    std::cout
+        << "Requests: " << totals.requests
+        << ", errors: " << totals.errors
+        << ", body bytes: " << totals.body_bytes
+        << ", garbage: " << archive.garbage << "."
+        << std::endl;
+    std::cout << "Headers:" << std::endl;
+    std::map<std::string, unsigned long>::const_iterator current =
+        totals.headers.begin();
+    for (; current != totals.headers.end(); ++current) {
+        std::cout
+            << "  " << current->first << ": " << current->second
+            << std::endl;
+    }
+    std::cout << "Body sizes:" << std::endl;
+    for (std::size_t i = 0; i < totals.body_sizes.size(); ++i)
+    {
+        if (totals.body_sizes[i] == 0) {
+            continue;
+        }
+        std::cout
+            << "  < " << (1ul << i) << ": " << totals.body_sizes[i]
+            << std::endl;
+    }
+    ::scgi_archive_unmap(&archive);
+}
@@ -0,0 +1,156 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi-blob.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+    void check (bool condition, const char * what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(std::string(what) + " failed."));
+        }
+    }
+
+    std::string header (const ::scgi_blob * blob, const char * field)
+    {
+        std::size_t size = 0;
+        const char *const value = ::scgi_blob_header(blob, field, &size);
+        check(value != 0, "Lookup");
+        return (std::string(value, size));
+    }
+
+    // Overwrite a field in a copy of a valid blob, which must then fail
+    // the check.
+    void corrupt (const ::scgi_blob * blob, std::size_t offset,
+                  ::uint32_t value, const char * what)
+    {
+        ::uint32_t copy[1024];
+        std::memcpy(copy, blob, blob->size);
+        std::memcpy(reinterpret_cast<char*>(copy)+offset,
+                    &value, sizeof(value));
+        check(::scgi_blob_check(copy, sizeof(copy)) == 0, what);
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-blob <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    // Write the blob straight from the parser, one byte at a time.
+    ::uint32_t buffer[1024];
+    ::scgi_limits limits;
+    limits.max_head_size = 0;
+    limits.max_body_size = 0;
+    ::scgi_parser parser;
+    ::scgi_setup(&limits, &parser);
+    ::scgi_blob_writer writer;
+    writer.body = 1;
+    check(::scgi_blob_writer_setup(&writer, &parser,
+                                   buffer, sizeof(buffer)) == 0, "Setup");
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        ::scgi_consume(&parser, data.data()+i, 1);
+    }
+    check(parser.error == scgi_error_ok, "Parsing");
+
+    // Hand it over with a single copy, and query the copy in place.
+    const ::scgi_blob *const original =
+        reinterpret_cast<const ::scgi_blob*>(buffer);
+    ::uint32_t copy[1024];
+    std::memcpy(copy, buffer, original->size);
+    std::memset(buffer, 0xff, sizeof(buffer));
+    const ::scgi_blob *const blob = ::scgi_blob_check(copy, sizeof(copy));
+    check(blob != 0, "Checking");
+    std::size_t size = 0;
+    const char *const body = ::scgi_blob_body(blob, &size);
+
+    // Corrupt blobs are rejected, without reading past the buffer.
+    const std::size_t last = blob->table +
+        (blob->count-1)*sizeof(::scgi_blob_entry);
+    const ::scgi_blob_entry& entry =
+        *reinterpret_cast<const ::scgi_blob_entry*>(
+            reinterpret_cast<const char*>(blob) + last);
+    corrupt(blob, offsetof(::scgi_blob, size), 0xffffffff, "Huge size");
+    corrupt(blob, offsetof(::scgi_blob, count), 0x10000000, "Huge count");
+    corrupt(blob, offsetof(::scgi_blob, body_size), 0xffffffff, "Huge body");
+    corrupt(blob, last+offsetof(::scgi_blob_entry, field_size),
+            0xffffffff, "Huge field size");
+    corrupt(blob, last+offsetof(::scgi_blob_entry, value),
+            blob->size, "Value past the end");
+    corrupt(blob, last+offsetof(::scgi_blob_entry, value_size),
+            entry.value_size-1, "Missing terminator");
+
+    // Blobs that don't fit are rejected.
+    ::uint32_t small[16];
+    ::scgi_setup(&limits, &parser);
+    check(::scgi_blob_writer_setup(&writer, &parser, small, 8) < 0,
+          "Tiny buffer");
+    check(::scgi_blob_writer_setup(&writer, &parser, small,
+                                   sizeof(small)) == 0, "Small buffer");
+    ::scgi_consume(&parser, data.data(), data.size());
+    check(parser.error == scgi_error_head_overflow, "Overflow");
+
+    std::cout
+        << "Blob: " << blob->count << " headers, "
+        << "REQUEST_URI=" << header(blob, "REQUEST_URI") << ", "
+        << "body '" << std::string(body, size) << "'."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
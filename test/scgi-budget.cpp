@@ -0,0 +1,165 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.hpp"
+#include "scgi-budget.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+    void check (bool condition, const char * what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(std::string(what) + " failed."));
+        }
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-budget <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    // Charge one request per "connection" until the budget runs out.
+    scgi::Request request;
+    request.feed(data.data(), data.size());
+    const std::size_t footprint = request.footprint();
+    check(footprint > data.size(), "Footprint");
+
+    ::scgi_budget budget;
+    ::scgi_budget_setup(&budget, 8*footprint);
+    check(::scgi_budget_state(&budget) == scgi_budget_normal, "Normal");
+    std::size_t admitted = 0;
+    while (::scgi_budget_state(&budget) == scgi_budget_normal) {
+        check(::scgi_budget_charge(&budget, footprint) == 0, "Charge");
+        ++admitted;
+    }
+    check(::scgi_budget_state(&budget) == scgi_budget_refuse, "Refuse");
+
+    // In-flight requests may still grow.
+    check(::scgi_budget_charge(&budget, footprint) == 0, "In-flight charge");
+    check(::scgi_budget_state(&budget) == scgi_budget_pause, "Pause");
+    check(::scgi_budget_charge(&budget, footprint) == 0, "Last charge");
+    check(::scgi_budget_charge(&budget, 1) < 0, "Limit");
+    check(::scgi_budget_used(&budget) == 8*footprint, "Usage");
+
+    // Released memory lifts the pressure.
+    for (std::size_t i = 0; i < 8; ++i) {
+        ::scgi_budget_credit(&budget, footprint);
+    }
+    check(::scgi_budget_state(&budget) == scgi_budget_normal, "Recovery");
+    check(::scgi_budget_peak(&budget) == 8*footprint, "Peak");
+
+    // Connections also charge what they buffer, as it arrives.  Requests
+    // accepted while memory was available soon fill the budget with heads
+    // and bodies, and reads are paused before any request completes.
+    const std::size_t chunk = 16;
+    std::vector<scgi::Request> requests(64);
+    std::vector<std::size_t> charges(requests.size());
+    ::scgi_budget_setup(&budget, 8*footprint);
+    std::size_t accepted = 0;
+    while ((::scgi_budget_state(&budget) == scgi_budget_normal) &&
+           (accepted < requests.size()))
+    {
+        charges[accepted] = requests[accepted].footprint();
+        check(::scgi_budget_charge(&budget, charges[accepted]) == 0,
+              "Connection charge");
+        ++accepted;
+    }
+    check(accepted < requests.size(), "Connection limit");
+    std::size_t read = 0;
+    bool paused = false;
+    while (!paused && (read < data.size()))
+    {
+        const std::size_t size = std::min(chunk, data.size()-read);
+        for (std::size_t i = 0; (i < accepted) && !paused; ++i)
+        {
+            paused = ::scgi_budget_state(&budget) == scgi_budget_pause;
+            if (paused) {
+                break;
+            }
+            requests[i].feed(data.data()+read, size);
+            const std::size_t grown = requests[i].footprint();
+            if (grown > charges[i]) {
+                ::scgi_budget_force(&budget, grown-charges[i]);
+            }
+            else {
+                ::scgi_budget_credit(&budget, charges[i]-grown);
+            }
+            charges[i] = grown;
+        }
+        if (!paused) {
+            read += size;
+        }
+    }
+    check(paused, "Paused reads");
+    for (std::size_t i = 0; i < accepted; ++i) {
+        check(!requests[i].body_complete(), "Incomplete requests");
+    }
+
+    // Releasing connections returns everything they buffered.
+    for (std::size_t i = 0; i < accepted; ++i) {
+        ::scgi_budget_credit(&budget, charges[i]);
+    }
+    check(::scgi_budget_used(&budget) == 0, "Release");
+
+    std::cout
+        << "Budget: OK, " << admitted << " connections admitted, "
+        << accepted << " paused after " << read << " bytes."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
@@ -0,0 +1,158 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.hpp"
+#include "scgi-cache.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <time.h>
+
+namespace {
+
+    void check (bool condition, const char * what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(std::string(what) + " failed."));
+        }
+    }
+
+    void make_key (::scgi_cache_key& key, const scgi::Request& request,
+                   const std::string& query)
+    {
+        const std::string method = request.header("REQUEST_METHOD");
+        const std::string uri = request.header("REQUEST_URI");
+        ::scgi_cache_key_clear(&key);
+        ::scgi_cache_key_append(&key, method.data(), method.size());
+        ::scgi_cache_key_append(&key, uri.data(), uri.size());
+        ::scgi_cache_key_append(&key, query.data(), query.size());
+    }
+
+    std::string lookup (::scgi_cache& cache, const ::scgi_cache_key& key)
+    {
+        const ::scgi_cache_entry * entry = ::scgi_cache_lookup(&cache, 0, &key);
+        if (entry == 0) {
+            return ("");
+        }
+        const std::string response(entry->data, entry->size);
+        ::scgi_cache_unref(entry);
+        return (response);
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-cache <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string original((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+    scgi::Request request;
+    request.feed(original.data(), original.size());
+
+    const std::string first = "Status: 200 OK\r\n\r\nfirst";
+    const std::string second = "Status: 200 OK\r\n\r\nsecond";
+    ::scgi_cache_key key;
+    ::scgi_cache_key other;
+    make_key(key, request, "");
+    make_key(other, request, "q=42");
+
+    // Hits and misses.
+    ::scgi_cache cache;
+    check(::scgi_cache_setup(&cache, 1, 1024*1024, 60000) == 0, "Setup");
+    check(lookup(cache, key).empty(), "Lookup before insert");
+    ::scgi_cache_insert(&cache, &key, first.data(), first.size());
+    check(lookup(cache, key) == first, "Lookup after insert");
+    check(lookup(cache, other).empty(), "Lookup with other query");
+
+    // Replaced entries stay valid while held.
+    const ::scgi_cache_entry * held = ::scgi_cache_lookup(&cache, 0, &key);
+    ::scgi_cache_insert(&cache, &key, second.data(), second.size());
+    ::scgi_cache_quiescent(&cache, 0);
+    check(std::string(held->data, held->size) == first, "Held entry");
+    ::scgi_cache_unref(held);
+    check(lookup(cache, key) == second, "Lookup after replace");
+    ::scgi_cache_quiescent(&cache, 0);
+    check(cache.retired == 0, "Reclamation");
+    ::scgi_cache_release(&cache);
+
+    // Size bound: each shard fits a single entry.
+    check(::scgi_cache_setup(&cache, 1, 16*first.size(), 60000) == 0,
+          "Setup");
+    size_t hits = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        make_key(key, request, std::string(1, char('0'+(i%10))) +
+                 std::string(1, char('0'+(i/10))));
+        ::scgi_cache_insert(&cache, &key, first.data(), first.size());
+    }
+    for (int i = 0; i < 100; ++i)
+    {
+        make_key(key, request, std::string(1, char('0'+(i%10))) +
+                 std::string(1, char('0'+(i/10))));
+        hits += !lookup(cache, key).empty();
+    }
+    check((hits > 0) && (hits <= 16), "Eviction");
+    ::scgi_cache_release(&cache);
+
+    // Expiry.
+    check(::scgi_cache_setup(&cache, 1, 1024*1024, 1) == 0, "Setup");
+    make_key(key, request, "");
+    ::scgi_cache_insert(&cache, &key, first.data(), first.size());
+    const ::timespec delay = { 0, 50*1000*1000 };
+    ::nanosleep(&delay, 0);
+    check(lookup(cache, key).empty(), "Expiry");
+    ::scgi_cache_release(&cache);
+
+    std::cout
+        << "Cache: OK."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
@@ -0,0 +1,218 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.hpp"
+#include "scgi-cgi.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+namespace {
+
+    void check (bool condition, const char * what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(std::string(what) + " failed."));
+        }
+    }
+
+    const char * extra[] = { "GATEWAY_INTERFACE=CGI/1.1", 0 };
+
+    // This program doubles as the CGI program: it echoes its input.
+    int respond ()
+    {
+        const char * method = std::getenv("REQUEST_METHOD");
+        const char * uri = std::getenv("REQUEST_URI");
+        const char * length = std::getenv("CONTENT_LENGTH");
+        std::string body(length? std::atoi(length) : 0, '\0');
+        std::cin.read(&body[0], body.size());
+        std::cout
+            << "Status: 200 OK\r\n"
+            << "Content-Type: text/plain\r\n"
+            << "\r\n"
+            << (method? method : "?") << ' ' << (uri? uri : "?") << '\n'
+            << body.substr(0, std::cin.gcount())
+            << std::flush;
+        return (EXIT_SUCCESS);
+    }
+
+    bool contains (char ** variables, const char * variable)
+    {
+        for (; *variables; ++variables) {
+            if (std::strcmp(*variables, variable) == 0) {
+                return (true);
+            }
+        }
+        return (false);
+    }
+
+    // Relay a request whose first bytes are already buffered.
+    std::string relay (::scgi_cgi_child& child, const std::string& body)
+    {
+        const size_t buffered = 5;
+        int sockets[2];
+        check(::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0,
+              "Socket pair");
+        check(::write(sockets[0], body.data()+buffered,
+                      body.size()-buffered) > 0, "Client write");
+        check(::scgi_cgi_relay(&child, sockets[1], body.data(), buffered,
+                               body.size()-buffered) == 0, "Relay");
+        int status = -1;
+        check(::scgi_cgi_wait(&child, &status) == 0, "Wait");
+        check(WIFEXITED(status) && (WEXITSTATUS(status) == 0), "Exit");
+        ::close(sockets[1]);
+        std::string response;
+        char buffer[256];
+        ssize_t size = 0;
+        while ((size = ::read(sockets[0], buffer, sizeof(buffer))) > 0) {
+            response.append(buffer, size);
+        }
+        ::close(sockets[0]);
+        return (response);
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (std::getenv("GATEWAY_INTERFACE")) {
+        return (respond());
+    }
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-cgi <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string request((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+    ::signal(SIGPIPE, SIG_IGN);
+
+    // Variables point into the request's head.
+    scgi::FixedRequest<1024, 1024, 16> parsed;
+    parsed.feed(request.data(), request.size());
+    check(parsed.body_complete(), "Request");
+    const std::vector<char> head(parsed.head(),
+                                 parsed.head()+parsed.head_size());
+    const std::string body(parsed.body().data(), parsed.body().size());
+    char ** variables = ::scgi_cgi_environ(parsed.head(),
+                                           parsed.head_size(), extra);
+    check(variables != 0, "Environment");
+    check(contains(variables, "REQUEST_URI=/deepthought"), "Header");
+    check(contains(variables, "GATEWAY_INTERFACE=CGI/1.1"), "Extra");
+    check(variables[0] == parsed.head(), "In place");
+    check(parsed.header("REQUEST_METHOD") == "POST", "Header view");
+    std::vector<char> buffer(head);
+    char * small[3];
+    check(::scgi_cgi_environ_into(&buffer[0], buffer.size(), extra,
+                                  small, 3) == -1, "Capacity");
+
+    const std::string expected =
+        "Status: 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "\r\n"
+        "POST /deepthought\n" + body;
+    int responses = 0;
+
+    ::scgi_cgi_child child;
+    char * arguments[] = { argv[0], 0 };
+    check(::scgi_cgi_spawn(&child, argv[0], arguments, variables) == 0,
+          "Spawn");
+    check(relay(child, body) == expected, "Response");
+    ++responses;
+    std::free(variables);
+
+    // Two workers, then a fallback, then a replacement worker.
+    ::scgi_cgi_pool pool;
+    check(::scgi_cgi_pool_setup(&pool, 2, 4096, extra) == 0, "Pool");
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i == 3) {
+            check(::scgi_cgi_pool_refill(&pool) == 0, "Refill");
+        }
+        buffer = head;
+        check(::scgi_cgi_pool_spawn(&pool, &child, argv[0],
+                                    &buffer[0], buffer.size()) == 0,
+              "Pool spawn");
+        check(relay(child, body) == expected, "Pool response");
+        ++responses;
+    }
+
+    // Workers forked while a connection is open must not hold it open.
+    buffer = head;
+    check(::scgi_cgi_pool_spawn(&pool, &child, argv[0],
+                                &buffer[0], buffer.size()) == 0,
+          "Pool spawn");
+    int client[2];
+    check(::socketpair(AF_UNIX, SOCK_STREAM, 0, client) == 0,
+          "Socket pair");
+    check(::scgi_cgi_pool_refill(&pool) == 0, "Refill");
+    ::close(client[1]);
+    ::pollfd event;
+    event.fd = client[0];
+    event.events = POLLIN;
+    event.revents = 0;
+    char byte = 0;
+    check((::poll(&event, 1, 5000) == 1) &&
+          (::read(client[0], &byte, 1) == 0), "Connection closed");
+    ::close(client[0]);
+    check(relay(child, body) == expected, "Pool response");
+    ++responses;
+    ::scgi_cgi_pool_release(&pool);
+
+    std::cout
+        << "CGI: POST /deepthought, " << responses << " responses relayed."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
@@ -0,0 +1,254 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.hpp"
+#include "scgi-coalesce.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+namespace {
+
+    void check (bool condition, const char * what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(std::string(what) + " failed."));
+        }
+    }
+
+    // Connection state, as kept by a server.
+    struct Connection
+    {
+        ::scgi_coalesce_waiter waiter;
+        const ::scgi_coalesce_response * response;
+        int delivered;
+
+        Connection ()
+            : response(0), delivered(0)
+        {
+            waiter.deliver = &Connection::deliver;
+            waiter.object = this;
+            waiter.flight = 0;
+            waiter.next = 0;
+        }
+
+        static void deliver (::scgi_coalesce_waiter * waiter,
+                             const ::scgi_coalesce_response * response)
+        {
+            Connection& self = *static_cast<Connection*>(waiter->object);
+            self.response = response;
+            ++self.delivered;
+        }
+    };
+
+    void append (::scgi_cache_key& key, const scgi::View& part)
+    {
+        ::scgi_cache_key_append(&key, part.data(), part.size());
+    }
+
+    const char response[] =
+        "Status: 200 OK\r\n"
+        "Content-Type: application/javascript\r\n"
+        "\r\n"
+        "answer = 42;\n";
+
+    // Threads racing on a single key.  Waiters are delivered from the
+    // leader's thread, so they outlive all threads.  Failures are counted
+    // rather than thrown, since deliveries run inside C callbacks.
+    struct Race
+    {
+        ::scgi_coalesce * coalesce;
+        const ::scgi_cache_key * key;
+        std::vector< ::scgi_coalesce_waiter > waiters;
+        size_t next;
+        long handled;
+        long served;
+        long missing;
+    };
+
+    void count (::scgi_coalesce_waiter * waiter,
+                const ::scgi_coalesce_response * response)
+    {
+        Race& race = *static_cast<Race*>(waiter->object);
+        if (response == 0) {
+            __atomic_add_fetch(&race.missing, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        __atomic_add_fetch(&race.served, 1, __ATOMIC_RELAXED);
+        ::scgi_coalesce_unref(response);
+    }
+
+    void * race (void * object)
+    {
+        Race& race = *static_cast<Race*>(object);
+        size_t i = 0;
+        while ((i = __atomic_fetch_add(&race.next, 1, __ATOMIC_RELAXED))
+               < race.waiters.size())
+        {
+            ::scgi_coalesce_waiter& waiter = race.waiters[i];
+            waiter.deliver = &count;
+            waiter.object = &race;
+            if (::scgi_coalesce_join(race.coalesce, race.key, &waiter) == 1)
+            {
+                __atomic_add_fetch(&race.handled, 1, __ATOMIC_RELAXED);
+                ::scgi_coalesce_finish(race.coalesce, &waiter,
+                                       response, sizeof(response)-1);
+            }
+        }
+        return (0);
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-coalesce <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    scgi::FixedRequest<1024, 0, 16> request;
+    request.feed(data.data(), data.size());
+    check(request.head_complete(), "Request");
+    const scgi::View method = request.header("REQUEST_METHOD");
+    check(::scgi_coalesce_is_method(method.data(), method.size()), "GET");
+
+    ::scgi_cache_key key;
+    ::scgi_cache_key_clear(&key);
+    append(key, method);
+    append(key, request.header("REQUEST_URI"));
+    append(key, request.header("QUERY_STRING"));
+    ::scgi_cache_key other;
+    ::scgi_cache_key_clear(&other);
+    append(other, method);
+    append(other, "/assets/other.js");
+    append(other, request.header("QUERY_STRING"));
+
+    ::scgi_coalesce coalesce;
+    check(::scgi_coalesce_setup(&coalesce, 16) == 0, "Setup");
+
+    // A herd of identical requests: one handler run, shared by all.
+    const int requests = 100;
+    std::vector<Connection> connections(requests);
+    int handled = 0;
+    for (int i = 0; i < requests; ++i) {
+        handled += ::scgi_coalesce_join(&coalesce, &key,
+                                        &connections[i].waiter);
+    }
+    Connection distinct;
+    check(::scgi_coalesce_join(&coalesce, &other, &distinct.waiter) == 1,
+          "Other key");
+    check(::scgi_coalesce_leave(&coalesce, &connections[50].waiter) == 0,
+          "Leave");
+    check(::scgi_coalesce_leave(&coalesce, &connections[0].waiter) == -1,
+          "Leader leave");
+    ::scgi_coalesce_finish(&coalesce, &connections[0].waiter,
+                           response, sizeof(response)-1);
+    const ::scgi_coalesce_response * shared = connections[1].response;
+    check(shared != 0, "Response");
+    check(std::string(shared->data, shared->size) == response, "Copy");
+    int served = 0;
+    for (int i = 0; i < requests; ++i)
+    {
+        check(connections[i].delivered == ((i != 0) && (i != 50)),
+              "Delivery");
+        if (connections[i].response) {
+            check(connections[i].response == shared, "Single copy");
+            ::scgi_coalesce_unref(connections[i].response);
+            ++served;
+        }
+    }
+    check(distinct.delivered == 0, "Other flight");
+
+    // The next request starts a new flight.  When the leader gives up,
+    // waiters handle their own request.
+    Connection leader;
+    Connection waiter;
+    check(::scgi_coalesce_join(&coalesce, &key, &leader.waiter) == 1,
+          "New flight");
+    check(::scgi_coalesce_join(&coalesce, &key, &waiter.waiter) == 0,
+          "Wait");
+    ::scgi_coalesce_finish(&coalesce, &leader.waiter, 0, 0);
+    check((waiter.delivered == 1) && (waiter.response == 0), "Give up");
+    ::scgi_coalesce_finish(&coalesce, &distinct.waiter, 0, 0);
+
+    // Keys too long to be compared are never coalesced.
+    ::scgi_cache_key overflow;
+    ::scgi_cache_key_clear(&overflow);
+    append(overflow, std::string(2*SCGI_CACHE_MAX_KEY, 'x').c_str());
+    check(::scgi_coalesce_join(&coalesce, &overflow, &leader.waiter) == -1,
+          "Overflow");
+
+    // Every request is either handled or served, across threads.
+    Race state;
+    state.coalesce = &coalesce;
+    state.key = &key;
+    state.waiters.resize(40000);
+    state.next = state.handled = state.served = state.missing = 0;
+    pthread_t threads[4];
+    for (int i = 0; i < 4; ++i) {
+        check(::pthread_create(&threads[i], 0, &race, &state) == 0,
+              "Thread");
+    }
+    for (int i = 0; i < 4; ++i) {
+        ::pthread_join(threads[i], 0);
+    }
+    check(state.missing == 0, "Shared response");
+    check(state.handled + state.served == 40000, "Race");
+    ::scgi_coalesce_release(&coalesce);
+
+    std::cout
+        << "Coalesce: " << handled << " handler run for "
+        << requests << " requests, " << served << " responses shared."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
@@ -0,0 +1,251 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.h"
+#include "scgi-compact.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+    void check (bool condition, const std::string& what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(what + " failed."));
+        }
+    }
+
+    // Log of callbacks, identical for both parsers.
+    struct Log
+    {
+        std::string field;
+        std::string value;
+        std::ostringstream events;
+
+        void finish_value ()
+        {
+            events << field << '=' << value << '\n';
+            field.clear(), value.clear();
+        }
+    };
+
+    namespace full {
+
+        Log& log (::scgi_parser * parser)
+        {
+            return (*static_cast<Log*>(parser->object));
+        }
+
+        void accept_field (::scgi_parser * parser,
+                           const char * data, size_t size)
+        {
+            log(parser).field.append(data, size);
+        }
+
+        void accept_value (::scgi_parser * parser,
+                           const char * data, size_t size)
+        {
+            log(parser).value.append(data, size);
+        }
+
+        void finish_value (::scgi_parser * parser)
+        {
+            log(parser).finish_value();
+        }
+
+        void finish_head (::scgi_parser * parser)
+        {
+            log(parser).events << "--\n";
+        }
+
+        size_t accept_body (::scgi_parser * parser,
+                            const char * data, size_t size)
+        {
+            log(parser).events.write(data, size);
+            return (size);
+        }
+
+    }
+
+    namespace compact {
+
+        Log& log (::scgi_compact * parser)
+        {
+            return (*static_cast<Log*>(parser->object));
+        }
+
+        void accept_field (::scgi_compact * parser,
+                           const char * data, size_t size)
+        {
+            log(parser).field.append(data, size);
+        }
+
+        void accept_value (::scgi_compact * parser,
+                           const char * data, size_t size)
+        {
+            log(parser).value.append(data, size);
+        }
+
+        void finish_value (::scgi_compact * parser)
+        {
+            log(parser).finish_value();
+        }
+
+        void finish_head (::scgi_compact * parser)
+        {
+            log(parser).events << "--\n";
+        }
+
+        size_t accept_body (::scgi_compact * parser,
+                            const char * data, size_t size)
+        {
+            log(parser).events.write(data, size);
+            return (size);
+        }
+
+        // Shared by all parsers.
+        const ::scgi_compact_callbacks callbacks = {
+            &accept_field, 0, &accept_value, &finish_value,
+            &finish_head, &accept_body,
+        };
+
+    }
+
+    ::scgi_limits limits = { 1024, 1024 };
+
+    std::string parse_full (const std::string& data, std::size_t step)
+    {
+        Log log;
+        ::scgi_parser parser;
+        ::scgi_setup(&limits, &parser);
+        parser.object = &log;
+        parser.accept_field = &full::accept_field;
+        parser.accept_value = &full::accept_value;
+        parser.finish_value = &full::finish_value;
+        parser.finish_head = &full::finish_head;
+        parser.accept_body = &full::accept_body;
+        for (std::size_t used = 0; used < data.size(); used += step)
+        {
+            ::scgi_consume(&parser, data.data()+used,
+                           std::min(step, data.size()-used));
+            if (parser.error != scgi_error_ok) {
+                return (::scgi_error_message(parser.error));
+            }
+        }
+        return (log.events.str());
+    }
+
+    std::string parse_compact (const std::string& data, std::size_t step)
+    {
+        Log log;
+        ::scgi_compact parser;
+        ::scgi_compact_setup(&parser, &limits, &compact::callbacks, &log);
+        for (std::size_t used = 0; used < data.size(); used += step)
+        {
+            ::scgi_compact_consume(&parser, data.data()+used,
+                                   std::min(step, data.size()-used));
+            if (parser.error != scgi_error_ok) {
+                return (::scgi_error_message(
+                            ::scgi_parser_error(parser.error)));
+            }
+        }
+        return (log.events.str());
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-compact <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    // Size regression: 3 pointers, a counter, the head size and 2 bytes.
+    const std::size_t expected =
+        3*sizeof(void*) + sizeof(std::size_t) + sizeof(void*);
+    check(sizeof(::scgi_compact) <= expected, "Compact parser size");
+
+    // Both parsers agree, however the request is split.
+    const std::string events = parse_full(data, data.size());
+    for (std::size_t step = 1; step <= data.size(); ++step)
+    {
+        std::ostringstream what;
+        what << "Parsing " << step << " bytes at a time";
+        check(parse_compact(data, step) == events, what.str());
+    }
+
+    // Both parsers agree on errors.
+    const std::string errors[] = {
+        "x:", "2000:",
+        std::string("3:a\0b;", 6),
+        std::string("3:a\0b\0", 6),
+    };
+    for (std::size_t i = 0; i < sizeof(errors)/sizeof(errors[0]); ++i)
+    {
+        check(parse_compact(errors[i], 1) == parse_full(errors[i], 1),
+              "Error " + errors[i]);
+    }
+    check(parse_compact(":,", 1) ==
+          ::scgi_error_message(scgi_error_head_syntax), "Missing size");
+    const std::string large = "0:," + std::string(2000, 'x');
+    check(parse_compact(large, large.size()) ==
+          ::scgi_error_message(scgi_error_body_overflow), "Body overflow");
+
+    std::cout
+        << "Compact: " << sizeof(::scgi_compact) << " bytes instead of "
+        << sizeof(::scgi_parser) << ", same events."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
@@ -0,0 +1,210 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.hpp"
+#include "scgi-deflate.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+    void check (bool condition, const char * what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(std::string(what) + " failed."));
+        }
+    }
+
+    struct Output
+    {
+        std::string data;
+        size_t chunks;
+    };
+
+    int collect (void * object, const char * data, size_t size)
+    {
+        Output& output = *static_cast<Output*>(object);
+        output.data.append(data, size);
+        ++output.chunks;
+        return (0);
+    }
+
+    ::scgi_deflate_encoding negotiate (const char * value)
+    {
+        return (::scgi_deflate_negotiate(value, std::strlen(value)));
+    }
+
+    // Decompress both zlib and gzip formats.
+    std::string inflate (const std::string& data)
+    {
+        ::z_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+        check(::inflateInit2(&stream, 15+32) == Z_OK, "Inflate setup");
+        std::string output;
+        char buffer[4096];
+        stream.next_in = (Bytef*)data.data();
+        stream.avail_in = (uInt)data.size();
+        int status = Z_OK;
+        do {
+            stream.next_out = (Bytef*)buffer;
+            stream.avail_out = sizeof(buffer);
+            status = ::inflate(&stream, Z_NO_FLUSH);
+            check((status == Z_OK) || (status == Z_STREAM_END), "Inflate");
+            output.append(buffer, sizeof(buffer)-stream.avail_out);
+        }
+        while (status != Z_STREAM_END);
+        ::inflateEnd(&stream);
+        return (output);
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-deflate <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string original((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+    scgi::Request request;
+    request.feed(original.data(), original.size());
+    const std::string accept = request.header("HTTP_ACCEPT_ENCODING");
+
+    // Negotiation.
+    check(negotiate("") == ::scgi_deflate_identity, "Empty");
+    check(negotiate("gzip") == ::scgi_deflate_gzip, "Gzip");
+    check(negotiate("deflate, gzip") == ::scgi_deflate_gzip, "Tie");
+    check(negotiate("GZIP;q=0.5, deflate") == ::scgi_deflate_deflate,
+          "Quality");
+    check(negotiate("gzip;q=0, deflate;q=0") == ::scgi_deflate_identity,
+          "Refused");
+    check(negotiate("*;q=0.1, gzip;q=0") == ::scgi_deflate_deflate,
+          "Wildcard");
+    const ::scgi_deflate_encoding encoding =
+        ::scgi_deflate_negotiate(accept.data(), accept.size());
+
+    // Streaming, with a body larger than one chunk.
+    std::string body;
+    for (int i = 0; body.size() < 4*SCGI_DEFLATE_CHUNK; ++i)
+    {
+        body += "function f" + std::string(1, char('a'+(i%26))) +
+            std::string(1, char('a'+(i/26%26))) + "() { return 42; }\n";
+    }
+    const std::string sample = original + body.substr(0, 100);
+    ::scgi_deflate state;
+    ::scgi_deflate_setup(&state, 6);
+    Output output = { "", 0 };
+    check(::scgi_deflate_start(&state, encoding, &collect, &output) == 0,
+          "Start");
+    for (size_t i = 0; i < body.size(); i += 1000)
+    {
+        check(::scgi_deflate_write(&state, body.data()+i,
+                                   std::min<size_t>(1000, body.size()-i))
+              == 0, "Write");
+    }
+    check(::scgi_deflate_finish(&state) == 0, "Finish");
+    check(output.data.size() < body.size()/4, "Ratio");
+    check(inflate(output.data) == body, "Round trip");
+
+    // Reuse the state for other codings, with a flush.
+    for (int i = 0; i < 3; ++i)
+    {
+        Output other = { "", 0 };
+        const ::scgi_deflate_encoding next =
+            (i == 0)? ::scgi_deflate_deflate : ::scgi_deflate_gzip;
+        check(::scgi_deflate_start(&state, next, &collect, &other) == 0,
+              "Restart");
+        ::scgi_deflate_write(&state, sample.data(), sample.size()/2);
+        check(::scgi_deflate_flush(&state) == 0, "Flush");
+        check(!other.data.empty(), "Flushed output");
+        ::scgi_deflate_write(&state, sample.data()+sample.size()/2,
+                             sample.size()-sample.size()/2);
+        check(::scgi_deflate_finish(&state) == 0, "Finish");
+        check(inflate(other.data) == sample, "Reuse");
+    }
+    Output plain = { "", 0 };
+    ::scgi_deflate_start(&state, ::scgi_deflate_identity, &collect, &plain);
+    ::scgi_deflate_write(&state, body.data(), body.size());
+    ::scgi_deflate_finish(&state);
+    check(plain.data == body, "Identity");
+
+    // Compressed variants are built once.
+    ::scgi_cache cache;
+    check(::scgi_cache_setup(&cache, 1, 16*1024*1024, 60000) == 0, "Setup");
+    ::scgi_cache_key key;
+    const std::string uri = request.header("REQUEST_URI");
+    ::scgi_cache_key_clear(&key);
+    ::scgi_cache_key_append(&key, uri.data(), uri.size());
+    const ::scgi_cache_entry * first = ::scgi_deflate_cached(
+        &cache, 0, &key, &state, encoding, body.data(), body.size());
+    check(first != 0, "Miss");
+    check(inflate(std::string(first->data, first->size)) == body, "Variant");
+    const ::scgi_cache_entry * second = ::scgi_deflate_cached(
+        &cache, 0, &key, &state, encoding, body.data(), body.size());
+    check(second == first, "Hit");
+    const ::scgi_cache_entry * third = ::scgi_deflate_cached(
+        &cache, 0, &key, &state, ::scgi_deflate_deflate,
+        body.data(), body.size());
+    check((third != 0) && (third != first), "Other variant");
+    ::scgi_cache_unref(first);
+    ::scgi_cache_unref(second);
+    ::scgi_cache_unref(third);
+    ::scgi_cache_release(&cache);
+    ::scgi_deflate_release(&state);
+
+    std::cout
+        << "Deflate: " << ::scgi_deflate_name(encoding) << ", "
+        << body.size() << " bytes in " << output.chunks << " chunks."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
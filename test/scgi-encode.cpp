@@ -0,0 +1,150 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+    void check (const std::string& expected, const std::string& actual,
+                const char * what)
+    {
+        if (expected != actual) {
+            throw (std::runtime_error(std::string(what) + " mismatch."));
+        }
+    }
+
+#if !defined(_WIN32)
+    std::string gather (const scgi::Headers& fixed,
+                        const scgi::Headers& headers, const std::string& body)
+    {
+        std::string pairs;
+        std::vector< ::scgi_header > items;
+        scgi::Headers::const_iterator current = headers.begin();
+        for (; current != headers.end(); ++current)
+        {
+            if ((current->first == "CONTENT_LENGTH") ||
+                (current->first == "SCGI") ||
+                (fixed.count(current->first) != 0)) {
+                continue;
+            }
+            ::scgi_header header;
+            header.name = current->first.data();
+            header.name_size = current->first.size();
+            header.value = current->second.data();
+            header.value_size = current->second.size();
+            items.push_back(header);
+        }
+        std::vector< ::scgi_header > shared;
+        for (current = fixed.begin(); current != fixed.end(); ++current)
+        {
+            ::scgi_header header;
+            header.name = current->first.data();
+            header.name_size = current->first.size();
+            header.value = current->second.data();
+            header.value_size = current->second.size();
+            shared.push_back(header);
+        }
+        pairs.resize(::scgi_encode_pairs(&shared[0], shared.size(), 0, 0));
+        ::scgi_encode_pairs(&shared[0], shared.size(),
+                            &pairs[0], pairs.size());
+        char prefix[SCGI_ENCODE_PREFIX_SIZE];
+        std::vector< ::iovec > vector(4*items.size() + 4);
+        const size_t used = ::scgi_encode_iovec(
+            pairs.data(), pairs.size(), &items[0], items.size(),
+            body.data(), body.size(), prefix, &vector[0], vector.size());
+        std::string request;
+        for (size_t i = 0; i < used; ++i) {
+            request.append(static_cast<const char*>(vector[i].iov_base),
+                           vector[i].iov_len);
+        }
+        return (request);
+    }
+#endif
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-encode <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string original((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+    scgi::Request request;
+    request.feed(original.data(), original.size());
+
+    // Plain encoding, in header name order.
+    scgi::Encoder encoder;
+    std::string encoded;
+    encoder.request(request.headers(), request.body(), encoded);
+    check(original, encoded, "Plain encoding");
+
+    // Template encoding, with the fixed part written first.
+    scgi::Headers fixed;
+    fixed["REQUEST_METHOD"] = request.header("REQUEST_METHOD");
+    scgi::Headers headers(request.headers());
+    headers.erase("REQUEST_METHOD");
+    scgi::Encoder templated(fixed);
+    templated.request(headers, request.body(), encoded);
+    check(original, encoded, "Template encoding");
+
+#if !defined(_WIN32)
+    // Gathered output, without copying.
+    check(original, gather(fixed, request.headers(), request.body()),
+          "Gathered encoding");
+#endif
+
+    std::cout
+        << "Round trip: OK."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
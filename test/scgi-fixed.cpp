@@ -0,0 +1,126 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+    void check (bool condition, const char * what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(std::string(what) + " failed."));
+        }
+    }
+
+    // Enough for small API calls, in a flat array.
+    typedef scgi::FixedRequest<256, 64, 8> Request;
+    Request requests[16];
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-fixed <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    // Feed one byte at a time, to split every field, value and body.
+    // Headers seen mid-parse are complete and lie within the head.
+    Request& request = requests[0];
+    for (std::size_t i = 0; i < data.size(); ++i)
+    {
+        request.feed(data.data()+i, 1);
+        const char *const head = request.head();
+        for (std::size_t j = 0; j < request.header_count(); ++j)
+        {
+            const scgi::View value = request.value(j);
+            check((request.field(j).data() >= head) &&
+                  (value.data()+value.size() < head+request.head_size()) &&
+                  (value.data()[value.size()] == '\0'), "Partial head");
+        }
+    }
+    check(request.error() == scgi_error_ok, "Parsing");
+    check(request.body_complete(), "Body");
+
+    // Copies keep parsing into their own storage.
+    const std::size_t half = data.size() / 2;
+    requests[1].feed(data.data(), half);
+    requests[2] = requests[1];
+    requests[1].clear();
+    requests[2].feed(data.data()+half, data.size()-half);
+    check(requests[2].body_complete() &&
+          (requests[2].header("REQUEST_URI") ==
+           request.header("REQUEST_URI")), "Parsing after copy");
+    check(!requests[1].head_complete(), "Clear");
+
+    // Requests that do not fit are rejected.
+    scgi::FixedRequest<32, 64> short_head;
+    short_head.feed(data.data(), data.size());
+    check(short_head.error() == scgi_error_head_overflow, "Head capacity");
+    scgi::FixedRequest<256, 64, 2> few_headers;
+    few_headers.feed(data.data(), data.size());
+    check(few_headers.error() == scgi_error_head_overflow,
+          "Header capacity");
+    scgi::FixedRequest<256, 16> short_body;
+    short_body.feed(data.data(), data.size());
+    check(short_body.error() == scgi_error_body_overflow, "Body capacity");
+
+    std::cout
+        << "Fixed: " << request.header_count() << " headers, "
+        << request.header("REQUEST_METHOD") << " "
+        << request.header("REQUEST_URI") << ", "
+        << "body '" << request.body() << "'."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
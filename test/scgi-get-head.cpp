@@ -68,6 +68,10 @@ try
                 << std::endl;
             return (EXIT_FAILURE);
         }
+        // Only keep the headers listed after the file name, if any.
+        for (int i = 2; i < argc; ++i) {
+            request.select(argv[i]);
+        }
         file >> request;
     }
     std::cout
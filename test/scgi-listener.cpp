@@ -0,0 +1,195 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.hpp"
+#include "scgi-listener.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+    void check (bool condition, const char * what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(std::string(what) + " failed."));
+        }
+    }
+
+    int connect_to (const ::sockaddr * host, ::socklen_t size)
+    {
+        const int result = ::socket(host->sa_family, SOCK_STREAM, 0);
+        check(result >= 0, "Socket");
+        check(::connect(result, host, size) == 0, "Connect");
+        return (result);
+    }
+
+    bool readable (int socket)
+    {
+        ::pollfd event = { socket, POLLIN, 0 };
+        return (::poll(&event, 1, 2000) == 1);
+    }
+
+    // Read and parse whatever is available, as done right after accept.
+    bool parse (int socket, const std::string& expected)
+    {
+        scgi::Request request;
+        char data[4096];
+        const ::ssize_t size = ::read(socket, data, sizeof(data));
+        if (size <= 0) {
+            return (false);
+        }
+        request.feed(data, size);
+        return (request.body_complete() && (request.body() == expected));
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 3)
+    {
+        std::cerr
+            << "Usage: scgi-listener <request-file> <socket-path>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string original((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+    scgi::Request request;
+    request.feed(original.data(), original.size());
+    const std::string body = request.body();
+
+    // Unix-domain socket: a batch of connections, each with its request.
+    ::scgi_listener listener;
+    ::scgi_listener_setup(&listener);
+    listener.mode = 0660;
+    const std::string path = argv[2];
+    check(::scgi_listener_open(&listener, ("unix:" + path).c_str()) == 0,
+          "Open");
+    ::sockaddr_un local;
+    std::memset(&local, 0, sizeof(local));
+    local.sun_family = AF_UNIX;
+    std::memcpy(local.sun_path, path.data(), path.size());
+    int clients[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        clients[i] = connect_to((::sockaddr*)&local, sizeof(local));
+        check(::write(clients[i], original.data(), original.size())
+              == ::ssize_t(original.size()), "Write");
+    }
+    int sockets[8];
+    const int count = ::scgi_listener_accept(&listener, sockets, 8);
+    check(count == 3, "Batch");
+    check(::scgi_listener_accept(&listener, sockets+count, 8-count) == 0,
+          "Empty queue");
+    for (int i = 0; i < count; ++i)
+    {
+        check((::fcntl(sockets[i], F_GETFL) & O_NONBLOCK) != 0,
+              "Non-blocking");
+        check((::fcntl(sockets[i], F_GETFD) & FD_CLOEXEC) != 0,
+              "Close-on-exec");
+        check(parse(sockets[i], body), "Immediate parse");
+        ::close(sockets[i]);
+        ::close(clients[i]);
+    }
+
+    // A live server's socket is left alone, a stale one is replaced.
+    ::scgi_listener other;
+    ::scgi_listener_setup(&other);
+    check((::scgi_listener_open(&other, path.c_str()) < 0) &&
+          (errno == EADDRINUSE), "Live socket");
+    check(::access(path.c_str(), F_OK) == 0, "Live socket file");
+    ::scgi_listener_close(&listener);
+    check(::access(path.c_str(), F_OK) != 0, "Socket file removal");
+    const int stale = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    check((stale >= 0) &&
+          (::bind(stale, (::sockaddr*)&local, sizeof(local)) == 0),
+          "Stale socket");
+    ::close(stale);
+    check(::scgi_listener_open(&other, path.c_str()) == 0, "Stale socket");
+    ::scgi_listener_close(&other);
+
+    // TCP on an ephemeral port, queued only once data arrives.
+    ::scgi_listener_setup(&listener);
+    listener.defer = 1;
+    check(::scgi_listener_open(&listener, "127.0.0.1:0") == 0, "Open TCP");
+    check(listener.family == AF_INET, "Family");
+    ::sockaddr_in host;
+    ::socklen_t host_size = sizeof(host);
+    check(::getsockname(listener.socket, (::sockaddr*)&host, &host_size)
+          == 0, "Port");
+    const int client = connect_to((::sockaddr*)&host, host_size);
+    int deferred = 0;
+#if defined(__linux__)
+    deferred = (::scgi_listener_accept(&listener, sockets, 8) == 0);
+    check(deferred == 1, "Deferral");
+#endif
+    check(::write(client, original.data(), original.size())
+          == ::ssize_t(original.size()), "Write");
+    check(readable(listener.socket), "Wake up");
+    check(::scgi_listener_accept(&listener, sockets, 8) == 1, "Accept TCP");
+    check(readable(sockets[0]) && parse(sockets[0], body), "Parse TCP");
+    ::close(sockets[0]);
+    ::close(client);
+    ::scgi_listener_close(&listener);
+
+    std::cout
+        << "Listener: " << count << " requests on a Unix socket, "
+        << deferred << " deferred on TCP."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
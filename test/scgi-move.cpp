@@ -0,0 +1,118 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+    void check (bool condition, const char * what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(std::string(what) + " failed."));
+        }
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-move <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    const std::size_t half = data.size() / 2;
+
+    // Parsing continues where it left off after a swap...
+    scgi::Request first;
+    first.feed(data.data(), half);
+    scgi::Request second;
+    swap(first, second);
+    second.feed(data.data()+half, data.size()-half);
+    check(second.body_complete(), "Parsing after swap");
+    check(!first.head_complete(), "Swapped-in request");
+
+    // ... and after copies, including into a growing container.
+    std::vector<scgi::Request> requests(1);
+    requests[0].feed(data.data(), half);
+    requests.resize(16);
+    scgi::Request copy(requests[0]);
+    requests[0].feed(data.data()+half, data.size()-half);
+    copy.feed(data.data()+half, data.size()-half);
+    check(requests[0].body_complete() && copy.body_complete(),
+          "Parsing after copy");
+
+#if __cplusplus >= 201103L
+    scgi::Request moved(std::move(copy));
+    check(moved.body_complete() && !copy.head_complete(), "Move");
+#endif
+
+    // Lookups by literal, and bodies taken without copying.
+    const scgi::View method = second.header("REQUEST_METHOD");
+    check(method == "POST", "Lookup");
+    check(second.header("HTTP_COOKIE").empty(), "Missing header");
+    const char *const address = second.body().data();
+    const std::string body = second.take_body();
+    check(second.body().empty(), "Taking the body");
+    const scgi::Headers headers = second.take_headers();
+    check(second.headers().empty() && !headers.empty(),
+          "Taking the headers");
+
+    std::cout
+        << "Moved: " << method << " "
+        << headers.find("REQUEST_URI")->second << ", "
+        << ((body.data() == address)? "body not copied" : "body copied")
+        << "."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
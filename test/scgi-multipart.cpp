@@ -0,0 +1,182 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.hpp"
+#include "scgi-multipart.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+    // Collects a textual dump of all parts.
+    struct Dump
+    {
+        std::ostringstream stream;
+        int parts;
+        int done;
+    };
+
+    void accept_field (::scgi_multipart_parser * parser,
+                       const char * data, size_t size)
+    {
+        static_cast<Dump*>(parser->object)->stream.write(data, size);
+    }
+
+    void finish_field (::scgi_multipart_parser * parser)
+    {
+        static_cast<Dump*>(parser->object)->stream << '=';
+    }
+
+    void accept_value (::scgi_multipart_parser * parser,
+                       const char * data, size_t size)
+    {
+        static_cast<Dump*>(parser->object)->stream.write(data, size);
+    }
+
+    void finish_value (::scgi_multipart_parser * parser)
+    {
+        static_cast<Dump*>(parser->object)->stream << std::endl;
+    }
+
+    void finish_head (::scgi_multipart_parser * parser)
+    {
+        static_cast<Dump*>(parser->object)->stream << "data='";
+    }
+
+    void accept_data (::scgi_multipart_parser * parser,
+                      const char * data, size_t size)
+    {
+        static_cast<Dump*>(parser->object)->stream.write(data, size);
+    }
+
+    void finish_part (::scgi_multipart_parser * parser)
+    {
+        Dump& dump = *static_cast<Dump*>(parser->object);
+        dump.stream << "'" << std::endl;
+        ++dump.parts;
+    }
+
+    void finish_body (::scgi_multipart_parser * parser)
+    {
+        ++static_cast<Dump*>(parser->object)->done;
+    }
+
+    // Parse the body, feeding it to the parser in chunks of size `step`.
+    std::string parse (const std::string& type,
+                       const std::string& body, std::size_t step, int& parts)
+    {
+        const char * boundary = 0;
+        size_t length = 0;
+        if (!::scgi_multipart_boundary(type.data(), type.size(),
+                                       &boundary, &length))
+        {
+            throw (std::runtime_error("no multipart boundary."));
+        }
+        ::scgi_multipart_limits limits;
+        limits.max_head_size = 1024;
+        ::scgi_multipart_parser parser;
+        ::scgi_multipart_setup(&limits, &parser, boundary, length);
+        Dump dump;
+        dump.parts = 0;
+        dump.done = 0;
+        parser.object = &dump;
+        parser.accept_field = &accept_field;
+        parser.finish_field = &finish_field;
+        parser.accept_value = &accept_value;
+        parser.finish_value = &finish_value;
+        parser.finish_head = &finish_head;
+        parser.accept_data = &accept_data;
+        parser.finish_part = &finish_part;
+        parser.finish_body = &finish_body;
+        for (std::size_t used = 0; used < body.size(); used += step)
+        {
+            const std::size_t size = std::min(step, body.size()-used);
+            ::scgi_multipart_consume(&parser, body.data()+used, size);
+            if (parser.error != ::scgi_multipart_error_ok) {
+                throw (std::runtime_error(
+                    ::scgi_multipart_error_message(parser.error)));
+            }
+        }
+        if (dump.done != 1) {
+            throw (std::runtime_error("missing close delimiter."));
+        }
+        parts = dump.parts;
+        return (dump.stream.str());
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-multipart <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    scgi::Request request;
+    file >> request;
+    const std::string type = request.header("CONTENT_TYPE");
+    int parts = 0;
+    const std::string whole =
+        parse(type, request.body(), request.body().size(), parts);
+    // Byte-at-a-time parsing exercises boundaries split across chunks.
+    const std::string split = parse(type, request.body(), 1, parts);
+    if (whole != split)
+    {
+        std::cerr
+            << "Fragmented parse mismatch."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::cout
+        << whole
+        << "Parts: " << parts << "."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
@@ -0,0 +1,144 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+    // Parse the request, passing it @a step bytes at a time.
+    std::string parse (const std::string& data, std::size_t step)
+    {
+        ::scgi_limits limits;
+        limits.max_head_size = 0;
+        limits.max_body_size = 0;
+        ::scgi_parser parser;
+        ::scgi_setup(&limits, &parser);
+        std::ostringstream result;
+        std::size_t headers = 0;
+        std::string field;
+        std::string value;
+        std::string body;
+        bool done = false;
+        ::scgi_cursor cursor;
+        ::scgi_event event;
+        for (std::size_t used = 0; used < data.size(); used += step)
+        {
+            cursor.data = data.data() + used;
+            cursor.size = std::min(step, data.size()-used);
+            while (::scgi_next(&parser, &cursor, &event) != scgi_event_none)
+            {
+                switch (event.type)
+                {
+                case scgi_event_field:
+                    field.append(event.data, event.size);
+                    break;
+                case scgi_event_value:
+                    value.append(event.data, event.size);
+                    if (event.complete) {
+                        result << field << '=' << value << '\n';
+                        field.clear(), value.clear(), ++headers;
+                    }
+                    break;
+                case scgi_event_head:
+                    result << "--\n";
+                    break;
+                case scgi_event_body:
+                    body.append(event.data, event.size);
+                    break;
+                case scgi_event_done:
+                    done = true;
+                    break;
+                default:
+                    break;
+                }
+            }
+            if (parser.error != scgi_error_ok) {
+                throw (std::runtime_error(
+                    ::scgi_error_message(parser.error)));
+            }
+        }
+        if (!done) {
+            throw (std::runtime_error("Body is incomplete."));
+        }
+        result << body;
+        return (result.str());
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-next <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    // Every way of splitting the request gives the same result.
+    const std::string expected = parse(data, data.size());
+    for (std::size_t step = 1; step < data.size(); ++step)
+    {
+        if (parse(data, step) != expected) {
+            std::cerr
+                << "Parsing " << step << " bytes at a time differs."
+                << std::endl;
+            return (EXIT_FAILURE);
+        }
+    }
+    std::cout
+        << expected
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
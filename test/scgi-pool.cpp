@@ -0,0 +1,175 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi-pool.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <pthread.h>
+
+namespace {
+
+    void check (bool condition, const char * what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(std::string(what) + " failed."));
+        }
+    }
+
+    // Request handed off to the pool, as an I/O thread would.
+    struct Job
+    {
+        ::scgi_task task;
+        pthread_t mailbox;
+        int ran;
+        int ran_off_mailbox;
+        int done;
+        int done_on_mailbox;
+    };
+
+    Job * owner (::scgi_task * task)
+    {
+        return (reinterpret_cast<Job*>(
+            reinterpret_cast<char*>(task) - offsetof(Job, task)));
+    }
+
+    // Runs on a handler thread.
+    void run (::scgi_task * task)
+    {
+        Job& job = *owner(task);
+        ++job.ran;
+        job.ran_off_mailbox = !pthread_equal(pthread_self(), job.mailbox);
+    }
+
+    // Runs on the thread that dispatches the mailbox.
+    void done (::scgi_task * task)
+    {
+        Job& job = *owner(task);
+        ++job.done;
+        job.done_on_mailbox = pthread_equal(pthread_self(), job.mailbox);
+    }
+
+    // Several I/O threads submitting to the same pool and mailbox.
+    struct Submitter
+    {
+        pthread_t thread;
+        ::scgi_pool * pool;
+        Job * jobs;
+        std::size_t count;
+    };
+
+    void * submit (void * object)
+    {
+        Submitter& submitter = *static_cast<Submitter*>(object);
+        for (std::size_t i = 0; i < submitter.count; ++i) {
+            ::scgi_pool_submit(submitter.pool, &submitter.jobs[i].task);
+        }
+        return (0);
+    }
+
+}
+
+int main (int, char **)
+try
+{
+    const std::size_t threads = 4;
+    const std::size_t count = 1000;
+
+    // An empty pool could never run a task.
+    ::scgi_pool pool;
+    errno = 0;
+    check(::scgi_pool_setup(&pool, 0) < 0, "Empty pool");
+    check(errno == EINVAL, "Empty pool error");
+    check(::scgi_pool_setup(&pool, 3) == 0, "Pool setup");
+    ::scgi_mailbox mailbox;
+    check(::scgi_mailbox_setup(&mailbox) == 0, "Mailbox setup");
+
+    std::vector<Job> jobs(threads*count);
+    for (std::size_t i = 0; i < jobs.size(); ++i)
+    {
+        Job& job = jobs[i];
+        job.task.next = 0;
+        job.task.owner = &mailbox;
+        job.task.run = &run;
+        job.task.done = &done;
+        job.mailbox = pthread_self();
+        job.ran = job.ran_off_mailbox = 0;
+        job.done = job.done_on_mailbox = 0;
+    }
+    std::vector<Submitter> submitters(threads);
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        submitters[i].pool = &pool;
+        submitters[i].jobs = &jobs[i*count];
+        submitters[i].count = count;
+        check(::pthread_create(&submitters[i].thread, 0,
+                               &submit, &submitters[i]) == 0,
+              "Submitter start");
+    }
+
+    // Dispatch completed tasks on this thread, like an I/O loop.
+    std::size_t finished = 0;
+    while (finished < jobs.size())
+    {
+        ::pollfd event;
+        event.fd = ::scgi_mailbox_fd(&mailbox);
+        event.events = POLLIN;
+        event.revents = 0;
+        check(::poll(&event, 1, 5000) > 0, "Mailbox wake-up");
+        finished += ::scgi_mailbox_dispatch(&mailbox);
+    }
+    for (std::size_t i = 0; i < threads; ++i) {
+        ::pthread_join(submitters[i].thread, 0);
+    }
+    ::scgi_pool_release(&pool);
+    ::scgi_mailbox_release(&mailbox);
+
+    check(finished == jobs.size(), "Dispatch count");
+    for (std::size_t i = 0; i < jobs.size(); ++i)
+    {
+        check((jobs[i].ran == 1) && (jobs[i].done == 1), "Run once");
+        check(jobs[i].ran_off_mailbox, "Handler thread");
+        check(jobs[i].done_on_mailbox, "Mailbox thread");
+    }
+    std::cout
+        << "Pool: " << finished << " tasks from " << threads
+        << " threads, all done on the mailbox thread."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
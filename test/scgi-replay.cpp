@@ -0,0 +1,202 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.h"
+#include "scgi-capture.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <time.h>
+
+namespace {
+
+    // Replay statistics.
+    struct Totals
+    {
+        unsigned long requests;
+        unsigned long reads;
+        unsigned long bytes;
+        unsigned long errors;
+    };
+
+    // Parser for one captured connection.
+    struct Session
+    {
+        ::scgi_limits limits;
+        ::scgi_parser parser;
+    };
+
+    void accept_field (::scgi_parser *, const char *, size_t)
+    {
+    }
+
+    void accept_value (::scgi_parser *, const char *, size_t)
+    {
+    }
+
+    void finish_head (::scgi_parser * parser)
+    {
+        ++static_cast<Totals*>(parser->object)->requests;
+    }
+
+    size_t accept_body (::scgi_parser *, const char *, size_t size)
+    {
+        return (size);
+    }
+
+    Session * open (Totals& totals)
+    {
+        Session * session = new Session;
+        session->limits.max_head_size = 0;
+        session->limits.max_body_size = 0;
+        ::scgi_setup(&session->limits, &session->parser);
+        session->parser.object = &totals;
+        session->parser.accept_field = &accept_field;
+        session->parser.accept_value = &accept_value;
+        session->parser.finish_head = &finish_head;
+        session->parser.accept_body = &accept_body;
+        return (session);
+    }
+
+    ::uint64_t now ()
+    {
+        ::timespec now;
+        ::clock_gettime(CLOCK_MONOTONIC, &now);
+        return (::uint64_t(now.tv_sec)*1000000000u + now.tv_nsec);
+    }
+
+    // Wait until `delay` nanoseconds have elapsed since `start`.
+    void pace (::uint64_t start, ::uint64_t delay)
+    {
+        const ::uint64_t elapsed = now() - start;
+        if (elapsed >= delay) {
+            return;
+        }
+        ::timespec pause;
+        pause.tv_sec = (delay-elapsed) / 1000000000u;
+        pause.tv_nsec = (delay-elapsed) % 1000000000u;
+        while ((::nanosleep(&pause, &pause) < 0) && (errno == EINTR)) {
+        }
+    }
+
+    // Feed all records through the parser, with the original fragmentation.
+    void replay (::scgi_capture_reader& reader, bool paced, Totals& totals)
+    {
+        typedef std::map< ::uint64_t, Session* > Sessions;
+        Sessions sessions;
+        const ::scgi_capture_record * record = 0;
+        const char * data = 0;
+        const ::uint64_t start = now();
+        ::uint64_t origin = 0;
+        ::scgi_capture_rewind(&reader);
+        while (::scgi_capture_next(&reader, &record, &data))
+        {
+            if (origin == 0) {
+                origin = record->time;
+            }
+            if (paced && (record->time > origin)) {
+                pace(start, record->time - origin);
+            }
+            Session *& session = sessions[record->connection];
+            if ((record->flags & ::scgi_capture_begin) && session) {
+                delete session, session = 0;
+            }
+            if (session == 0) {
+                session = open(totals);
+            }
+            if (record->size > 0)
+            {
+                ++totals.reads, totals.bytes += record->size;
+                ::scgi_consume(&session->parser, data, record->size);
+                if (session->parser.error != ::scgi_error_ok) {
+                    ++totals.errors;
+                    delete session, session = 0;
+                    sessions.erase(record->connection);
+                    continue;
+                }
+            }
+            if (record->flags & ::scgi_capture_end) {
+                delete session, session = 0;
+                sessions.erase(record->connection);
+            }
+        }
+        Sessions::iterator current = sessions.begin();
+        for (; current != sessions.end(); ++current) {
+            delete current->second;
+        }
+    }
+
+}
+
+int main (int argc, char ** argv)
+{
+    bool paced = false;
+    unsigned long repeat = 1;
+    const char * path = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--rate") == 0) {
+            paced = true;
+        }
+        else if ((std::strcmp(argv[i], "--repeat") == 0) && (i+1 < argc)) {
+            repeat = std::strtoul(argv[++i], 0, 10);
+        }
+        else {
+            path = argv[i];
+        }
+    }
+    if (path == 0)
+    {
+        std::cerr
+            << "Usage: scgi-replay [--rate] [--repeat N] <capture-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    ::scgi_capture_reader reader;
+    if (::scgi_capture_map(&reader, path) < 0)
+    {
+        std::cerr
+            << "Could not open capture file: " << std::strerror(errno) << "."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    Totals totals;
+    std::memset(&totals, 0, sizeof(totals));
+    const ::uint64_t start = now();
+    for (unsigned long i = 0; i < repeat; ++i) {
+        replay(reader, paced, totals);
+    }
+    const double elapsed = double(now() - start) / 1e9;
+    ::scgi_capture_unmap(&reader);
+    std::cout
+        << "Requests: " << totals.requests
+        << ", reads: " << totals.reads
+        << ", bytes: " << totals.bytes
+        << ", errors: " << totals.errors << "."
+        << std::endl;
+    std::cout
+        << "Elapsed: " << elapsed << " s ("
+        << (elapsed > 0.0? totals.bytes/elapsed/1e6 : 0.0) << " MB/s)."
+        << std::endl;
+    return ((totals.errors == 0)? EXIT_SUCCESS : EXIT_FAILURE);
+}
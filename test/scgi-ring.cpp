@@ -0,0 +1,217 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi-blob.h"
+#include "scgi-ring.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+    const std::size_t workers = 2;
+    const std::size_t requests = 1000;
+
+    void check (bool condition, const char * what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(std::string(what) + " failed."));
+        }
+    }
+
+    std::string header (const ::scgi_blob * blob, const char * field)
+    {
+        std::size_t size = 0;
+        const char *const value = ::scgi_blob_header(blob, field, &size);
+        return ((value == 0)? std::string() : std::string(value, size));
+    }
+
+    // Answer requests until an empty record arrives.
+    int work (::scgi_ring_region& region, std::size_t index)
+    {
+        ::scgi_ring input;
+        ::scgi_ring output;
+        ::scgi_ring_open(&input, &region, 2*index);
+        ::scgi_ring_open(&output, &region, 2*index+1);
+        for (;;)
+        {
+            const ::scgi_ring_record * record = 0;
+            while ((record = ::scgi_ring_peek(&input)) == 0) {
+                ::scgi_ring_wait_read(&input, -1);
+            }
+            if (record->size == 0) {
+                return (EXIT_SUCCESS);
+            }
+            // Query the request in place: no socket, no parsing.
+            const ::scgi_blob *const blob =
+                ::scgi_blob_check(record+1, record->size);
+            if (blob == 0) {
+                return (EXIT_FAILURE);
+            }
+            const std::string response =
+                "Status: 200 OK\r\n"
+                "Content-Type: text/plain\r\n"
+                "\r\n" + header(blob, "REQUEST_METHOD") +
+                " " + header(blob, "REQUEST_URI");
+            while (::scgi_ring_write(&output, response.data(),
+                                     response.size(), record->tag) < 0) {
+                ::scgi_ring_wait_write(&output, response.size(), -1);
+            }
+            ::scgi_ring_release(&input);
+        }
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-ring <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    // Small rings, so that they wrap around many times.
+    ::scgi_ring_region region;
+    check(::scgi_ring_region_create(&region, 2*workers, 4096) == 0,
+          "Creating the region");
+    std::vector<pid_t> children;
+    for (std::size_t i = 0; i < workers; ++i)
+    {
+        const pid_t child = ::fork();
+        if (child == 0) {
+            ::_exit(work(region, i));
+        }
+        check(child > 0, "Starting a worker");
+        children.push_back(child);
+    }
+    std::vector< ::scgi_ring > inputs(workers);
+    std::vector< ::scgi_ring > outputs(workers);
+    for (std::size_t i = 0; i < workers; ++i)
+    {
+        ::scgi_ring_open(&inputs[i], &region, 2*i);
+        ::scgi_ring_open(&outputs[i], &region, 2*i+1);
+    }
+
+    // Parse each request straight into a ring slot, and collect answers.
+    std::vector<bool> answered(requests, false);
+    std::size_t sent = 0;
+    std::size_t received = 0;
+    while (received < requests)
+    {
+        bool busy = false;
+        if (sent < requests)
+        {
+            ::scgi_ring& ring = inputs[sent % workers];
+            void *const slot = ::scgi_ring_reserve(&ring, 1024);
+            if (slot != 0)
+            {
+                ::scgi_limits limits;
+                limits.max_head_size = 0;
+                limits.max_body_size = 0;
+                ::scgi_parser parser;
+                ::scgi_setup(&limits, &parser);
+                ::scgi_blob_writer writer;
+                writer.body = 1;
+                ::scgi_blob_writer_setup(&writer, &parser, slot, 1024);
+                ::scgi_consume(&parser, data.data(), data.size());
+                check(parser.error == scgi_error_ok, "Parsing");
+                ::scgi_ring_commit(&ring,
+                    static_cast< ::scgi_blob*>(slot)->size, sent++);
+                busy = true;
+            }
+        }
+        for (std::size_t i = 0; i < workers; ++i)
+        {
+            const ::scgi_ring_record * record = 0;
+            while ((record = ::scgi_ring_peek(&outputs[i])) != 0)
+            {
+                const std::string response(
+                    reinterpret_cast<const char*>(record+1), record->size);
+                check(response.find("\r\n\r\nPOST /deepthought") !=
+                      std::string::npos, "Response");
+                check(!answered[record->tag], "Unique response");
+                answered[record->tag] = true, ++received;
+                ::scgi_ring_release(&outputs[i]);
+                busy = true;
+            }
+        }
+        if (!busy) {
+            ::scgi_ring_wait_read(&outputs[received % workers], 1);
+        }
+    }
+
+    // Stop the workers.
+    for (std::size_t i = 0; i < workers; ++i)
+    {
+        while (::scgi_ring_write(&inputs[i], "", 0, 0) < 0) {
+            ::scgi_ring_wait_write(&inputs[i], 0, -1);
+        }
+    }
+    for (std::size_t i = 0; i < workers; ++i)
+    {
+        int status = 0;
+        ::waitpid(children[i], &status, 0);
+        check(WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS),
+              "Worker exit");
+    }
+    ::scgi_ring_region_detach(&region);
+
+    std::cout
+        << "Ring: " << received << " requests answered by "
+        << workers << " workers."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
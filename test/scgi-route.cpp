@@ -0,0 +1,223 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.h"
+#include "scgi-router.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+    const char *const answer_headers[] = { "CONTENT_TYPE", 0 };
+
+    // Route table for the tests.
+    ::scgi_route routes[] = {
+        { "/deepthought", scgi_method_get, 0, (void*)"think", 0 },
+        { "/deepthought", scgi_method_post, answer_headers,
+          (void*)"answer", 0 },
+        { "/deep*", scgi_method_any, 0, (void*)"deep", 0 },
+        { "/static/*", scgi_method_get|scgi_method_head, 0,
+          (void*)"static", 0 },
+        { "/", scgi_method_get, 0, (void*)"index", 0 },
+    };
+
+    // Routing state while parsing the request.
+    struct Session
+    {
+        ::scgi_router router;
+        ::scgi_router_match match;
+        std::string field;
+        std::string value;
+        bool needed;
+        std::string routed;
+        std::string kept;
+        std::string skipped;
+    };
+
+    void accept_field (::scgi_parser * parser, const char * data, size_t size)
+    {
+        Session& session = *static_cast<Session*>(parser->object);
+        session.field.append(data, size);
+    }
+
+    void finish_field (::scgi_parser * parser)
+    {
+        Session& session = *static_cast<Session*>(parser->object);
+        // The field name is complete: buffer the value only if needed.
+        session.needed = ::scgi_router_needs(
+            &session.router, &session.match,
+            session.field.data(), session.field.size());
+    }
+
+    void accept_value (::scgi_parser * parser, const char * data, size_t size)
+    {
+        Session& session = *static_cast<Session*>(parser->object);
+        if (session.needed) {
+            session.value.append(data, size);
+        }
+    }
+
+    void finish_value (::scgi_parser * parser)
+    {
+        Session& session = *static_cast<Session*>(parser->object);
+        if (!session.routed.empty())
+        {
+            std::string& list = session.needed? session.kept : session.skipped;
+            list += (list.empty()? "" : " ") + session.field;
+        }
+        if (::scgi_router_feed(&session.router, &session.match,
+                               session.field.data(), session.field.size(),
+                               session.value.data(), session.value.size())) {
+            session.routed = session.field;
+        }
+        session.field.clear();
+        session.value.clear();
+    }
+
+    void finish_head (::scgi_parser *)
+    {
+    }
+
+    size_t accept_body (::scgi_parser *, const char *, size_t size)
+    {
+        return (size);
+    }
+
+    std::string route (const ::scgi_router& router,
+                       const char * method, const char * path)
+    {
+        ::scgi_router_match match;
+        ::scgi_router_reset(&match);
+        ::scgi_router_feed(&router, &match, "REQUEST_URI", 11,
+                           path, std::char_traits<char>::length(path));
+        ::scgi_router_feed(&router, &match, "REQUEST_METHOD", 14,
+                           method, std::char_traits<char>::length(method));
+        switch (match.status)
+        {
+        case scgi_router_found:
+            return (static_cast<const char*>(match.route->object));
+        case scgi_router_not_found:
+            return ("404");
+        case scgi_router_method_not_allowed:
+            return ("405");
+        default:
+            return ("pending");
+        }
+    }
+
+    void check (const ::scgi_router& router, const char * method,
+                const char * path, const std::string& expected)
+    {
+        const std::string actual = route(router, method, path);
+        if (actual != expected)
+        {
+            throw (std::runtime_error(
+                std::string(method) + " " + path + ": expected '" +
+                expected + "', got '" + actual + "'."));
+        }
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-route <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    Session session;
+    ::scgi_router_setup(&session.router);
+    for (size_t i = 0; i < sizeof(routes)/sizeof(routes[0]); ++i)
+    {
+        if (::scgi_router_add(&session.router, &routes[i]) < 0) {
+            throw (std::bad_alloc());
+        }
+    }
+
+    // Path matching, independent of the request file.
+    check(session.router, "GET", "/deepthought?q=1", "think");
+    check(session.router, "DELETE", "/deepthought", "deep");
+    check(session.router, "GET", "/deeper/still", "deep");
+    check(session.router, "GET", "/static/", "static");
+    check(session.router, "POST", "/static/app.js", "405");
+    check(session.router, "GET", "/", "index");
+    check(session.router, "GET", "/other", "404");
+    check(session.router, "GET", "", "404");
+
+    // Route while parsing, skipping headers the route doesn't use.
+    ::scgi_limits limits;
+    limits.max_head_size = 0;
+    limits.max_body_size = 0;
+    ::scgi_parser parser;
+    ::scgi_setup(&limits, &parser);
+    parser.object = &session;
+    parser.accept_field = &accept_field;
+    parser.finish_field = &finish_field;
+    parser.accept_value = &accept_value;
+    parser.finish_value = &finish_value;
+    parser.finish_head = &finish_head;
+    parser.accept_body = &accept_body;
+    ::scgi_router_reset(&session.match);
+    ::scgi_consume(&parser, data.data(), data.size());
+    if (session.match.status != scgi_router_found) {
+        throw (std::runtime_error("Request not routed."));
+    }
+    std::cout
+        << "route: " << static_cast<const char*>(session.match.route->object)
+        << " after " << session.routed
+        << ", kept: " << session.kept
+        << ", skipped: " << session.skipped << "."
+        << std::endl;
+    ::scgi_router_release(&session.router);
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
@@ -0,0 +1,250 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.hpp"
+#include "scgi-prefork.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+    void check (bool condition, const char * what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(std::string(what) + " failed."));
+        }
+    }
+
+    ::scgi_prefork server;
+
+    void stop (int)
+    {
+        ::scgi_prefork_stop(&server);
+    }
+
+    // Runs in a worker: respond with the worker's PID and the body.
+    void serve (::scgi_prefork *, int socket)
+    {
+        scgi::Request request;
+        char data[4096];
+        ::ssize_t size = 0;
+        while (!request.body_complete() &&
+               ((size = ::read(socket, data, sizeof(data))) > 0))
+        {
+            request.feed(data, size);
+        }
+        std::ostringstream response;
+        response << ::getpid() << ' ' << request.body();
+        const std::string text = response.str();
+        if (::write(socket, text.data(), text.size()) < 0) {
+            std::perror("write");
+        }
+    }
+
+    // Send a request, return the PID of the worker that served it.
+    ::pid_t query (const ::sockaddr_un& address, const std::string& request,
+                   const std::string& body)
+    {
+        const int client = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        check(client >= 0, "Socket");
+        check(::connect(client, (const ::sockaddr*)&address,
+                        sizeof(address)) == 0, "Connect");
+        check(::write(client, request.data(), request.size())
+              == ::ssize_t(request.size()), "Request");
+        std::string response;
+        char data[256];
+        ::ssize_t size = 0;
+        while ((size = ::read(client, data, sizeof(data))) > 0) {
+            response.append(data, size);
+        }
+        ::close(client);
+        const std::string::size_type space = response.find(' ');
+        check(space != std::string::npos, "Response");
+        check(response.substr(space+1) == body, "Body");
+        return (std::atoi(response.c_str()));
+    }
+
+    unsigned long served ()
+    {
+        unsigned long total = 0;
+        for (size_t i = 0; i < server.workers; ++i) {
+            total += __atomic_load_n(&server.scoreboard[i].served,
+                                     __ATOMIC_ACQUIRE);
+        }
+        return (total);
+    }
+
+    // Workers update the scoreboard right after closing the connection.
+    void settle (int requests)
+    {
+        const ::timespec delay = { 0, 10*1000*1000 };
+        for (int i = 0; (i < 100) && (served() < unsigned(requests)); ++i) {
+            ::nanosleep(&delay, 0);
+        }
+        check(served() == unsigned(requests), "Scoreboard");
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 3)
+    {
+        std::cerr
+            << "Usage: scgi-scoreboard <request-file> <socket-path>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string request((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+    scgi::Request parsed;
+    parsed.feed(request.data(), request.size());
+    check(parsed.body_complete(), "Request file");
+    const std::string body = parsed.body();
+
+    // Descriptors survive the trip, and a closed peer reads as errno 0.
+    int pair[2];
+    int pipes[2];
+    check(::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0, "Socket pair");
+    check(::pipe(pipes) == 0, "Pipe");
+    check(::scgi_send_socket(pair[0], pipes[1]) == 0, "Send");
+    const int received = ::scgi_recv_socket(pair[1]);
+    check((received >= 0) && (received != pipes[1]), "Receive");
+    check(::write(received, "x", 1) == 1, "Write through");
+    char byte = 0;
+    check((::read(pipes[0], &byte, 1) == 1) && (byte == 'x'), "Read back");
+    ::close(received), ::close(pipes[0]), ::close(pipes[1]);
+    ::close(pair[0]);
+    errno = EINVAL;
+    check((::scgi_recv_socket(pair[1]) == -1) && (errno == 0), "Peer");
+    ::close(pair[1]);
+
+    // Serve on a Unix socket, from a separate acceptor process.
+    ::sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    check(std::strlen(argv[2]) < sizeof(address.sun_path), "Path");
+    std::strcpy(address.sun_path, argv[2]);
+    ::unlink(argv[2]);
+    const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    check((listener >= 0) &&
+          (::bind(listener, (const ::sockaddr*)&address,
+                  sizeof(address)) == 0) &&
+          (::listen(listener, 16) == 0), "Listener");
+    check(::scgi_prefork_setup(&server, listener, 2) == 0, "Setup");
+    server.serve = &serve;
+    const ::pid_t acceptor = ::fork();
+    check(acceptor >= 0, "Fork");
+    if (acceptor == 0)
+    {
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = &stop;
+        ::sigaction(SIGTERM, &action, 0);
+        ::signal(SIGPIPE, SIG_IGN);
+        const int result = ::scgi_prefork_run(&server);
+        ::scgi_prefork_release(&server);
+        ::_exit((result == 0)? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    ::close(listener);
+
+    // Workers count requests in the shared scoreboard (after closing).
+    int requests = 0;
+    for (; requests < 6; ++requests) {
+        query(address, request, body);
+    }
+    settle(requests);
+
+    // A killed worker is replaced, and no request is lost.
+    std::set< ::pid_t > before;
+    for (size_t i = 0; i < server.workers; ++i) {
+        before.insert(server.scoreboard[i].pid);
+    }
+    const ::pid_t victim = server.scoreboard[0].pid;
+    check(::kill(victim, SIGKILL) == 0, "Kill");
+    // A connection handed to a worker that is still dying is lost with it.
+    const ::timespec death = { 0, 100*1000*1000 };
+    ::nanosleep(&death, 0);
+    for (int i = 0; i < 6; ++i, ++requests) {
+        check(query(address, request, body) != victim, "Dead worker");
+    }
+    settle(requests);
+    int replaced = 0;
+    for (size_t i = 0; i < server.workers; ++i)
+    {
+        const ::pid_t pid = server.scoreboard[i].pid;
+        check((pid != 0) && (pid != victim), "Scoreboard PID");
+        replaced += (before.count(pid) == 0);
+    }
+    check(replaced == 1, "Respawn");
+
+    // The acceptor stops on SIGTERM, after stopping its workers.
+    int status = -1;
+    check(::kill(acceptor, SIGTERM) == 0, "Stop");
+    check(::waitpid(acceptor, &status, 0) == acceptor, "Wait");
+    check(WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS),
+          "Acceptor");
+    ::unlink(argv[2]);
+
+    std::cout
+        << "Prefork: " << requests << " requests, "
+        << replaced << " worker replaced."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
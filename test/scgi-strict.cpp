@@ -0,0 +1,186 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+    void check (bool condition, const std::string& what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(what + " failed."));
+        }
+    }
+
+    // Counts callbacks, to make sure bad heads are rejected up front.
+    struct Counter
+    {
+        ::scgi_limits limits;
+        ::scgi_parser parser;
+        int calls;
+
+        Counter ()
+            : calls(0)
+        {
+            limits.max_head_size = 0;
+            limits.max_body_size = 0;
+            ::scgi_setup(&limits, &parser);
+            parser.object = this;
+            parser.strict = 1;
+            parser.accept_field = &Counter::accept;
+            parser.accept_value = &Counter::accept;
+            parser.finish_head = &Counter::finish_head;
+            parser.accept_body = &Counter::accept_body;
+        }
+
+        static void accept (::scgi_parser * parser, const char *, size_t)
+        {
+            ++static_cast<Counter*>(parser->object)->calls;
+        }
+
+        static void finish_head (::scgi_parser * parser)
+        {
+            ++static_cast<Counter*>(parser->object)->calls;
+        }
+
+        static size_t accept_body (::scgi_parser *, const char *, size_t size)
+        {
+            return (size);
+        }
+    };
+
+    std::string netstring (const std::string& payload, char end=',')
+    {
+        std::ostringstream stream;
+        stream << payload.size() << ':' << payload << end;
+        return (stream.str());
+    }
+
+    std::string head (const char * data, std::size_t size)
+    {
+        return (netstring(std::string(data, size-1)));
+    }
+
+    // Feed all at once, then one byte at a time.
+    void accept (const std::string& request, const std::string& name)
+    {
+        Counter whole;
+        ::scgi_consume(&whole.parser, request.data(), request.size());
+        check(whole.parser.error == scgi_error_ok, name);
+        check(whole.parser.state == scgi_parser_body, name);
+        Counter bytes;
+        for (std::size_t i = 0; i < request.size(); ++i) {
+            ::scgi_consume(&bytes.parser, request.data()+i, 1);
+        }
+        check(bytes.parser.error == scgi_error_ok, name + " (fragmented)");
+        check(bytes.parser.state == scgi_parser_body, name);
+    }
+
+    void reject (const std::string& request, const std::string& name)
+    {
+        Counter whole;
+        ::scgi_consume(&whole.parser, request.data(), request.size());
+        check(whole.parser.error == scgi_error_head_syntax, name);
+        check(whole.calls == 0, name + " (callbacks)");
+        Counter bytes;
+        for (std::size_t i = 0; i < request.size(); ++i) {
+            ::scgi_consume(&bytes.parser, request.data()+i, 1);
+        }
+        check(bytes.parser.error == scgi_error_head_syntax,
+              name + " (fragmented)");
+        check(bytes.parser.state != scgi_parser_body, name);
+    }
+
+}
+
+#define HEAD(data) head(data, sizeof(data))
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc < 2)
+    {
+        std::cerr
+            << "Usage: scgi-strict <request-file> [<request-file>...]"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    for (int i = 1; i < argc; ++i)
+    {
+        std::ifstream file(argv[i], std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cerr
+                << "Could not open input file."
+                << std::endl;
+            return (EXIT_FAILURE);
+        }
+        const std::string data((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+        accept(data, argv[i]);
+    }
+
+    const std::string heads[] = {
+        HEAD("CONTENT_LENGTH\0" "0\0" "REQUEST_METHOD\0" "GET\0"),
+        HEAD("SCGI\0" "1\0" "CONTENT_LENGTH\0" "0\0"),
+        HEAD("CONTENT_LENGTH\0" "0\0" "SCGI\0" "1\0" "\0" "GET\0"),
+        HEAD("CONTENT_LENGTH\0" "0\0" "SCGI\0" "1\0" "REQUEST_METHOD\0"),
+        HEAD("CONTENT_LENGTH\0" "0\0" "SCGI\0" "2\0"),
+        HEAD("CONTENT_LENGTH\0" "0x10\0" "SCGI\0" "1\0"),
+        HEAD("CONTENT_LENGTH\0" "99999999999999999999999\0" "SCGI\0" "1\0"),
+        netstring(std::string("CONTENT_LENGTH\0" "0\0" "SCGI\0" "1\0", 21),
+                  ';'),
+    };
+    const std::size_t count = sizeof(heads) / sizeof(heads[0]);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::ostringstream name;
+        name << "Rejecting head #" << i;
+        reject(heads[i], name.str());
+    }
+    accept(HEAD("CONTENT_LENGTH\0" "0\0" "SCGI\0" "1\0"), "Minimal head");
+
+    std::cout
+        << "Strict: " << count << " malformed heads rejected, "
+        << (argc-1) << " requests accepted."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
@@ -0,0 +1,252 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.h"
+#include "scgi-throttle.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <time.h>
+
+namespace {
+
+    void check (bool condition, const char * what)
+    {
+        if (!condition) {
+            throw (std::runtime_error(std::string(what) + " failed."));
+        }
+    }
+
+    // Checks the client as soon as its header is parsed.
+    struct Connection
+    {
+        ::scgi_limits limits;
+        ::scgi_parser parser;
+        ::scgi_throttle * throttle;
+        ::uint64_t now;
+        std::string field;
+        std::string value;
+        int limited;
+        size_t body_size;
+
+        Connection (::scgi_throttle& throttle, ::uint64_t now)
+            : throttle(&throttle), now(now), limited(-1), body_size(0)
+        {
+            limits.max_head_size = 1024;
+            limits.max_body_size = 1024;
+            ::scgi_setup(&limits, &parser);
+            parser.object = this;
+            parser.accept_field = &Connection::accept_field;
+            parser.accept_value = &Connection::accept_value;
+            parser.finish_value = &Connection::finish_value;
+            parser.accept_body = &Connection::accept_body;
+        }
+
+        static void accept_field (::scgi_parser * parser,
+                                  const char * data, size_t size)
+        {
+            static_cast<Connection*>(parser->object)->field.append(data, size);
+        }
+
+        static void accept_value (::scgi_parser * parser,
+                                  const char * data, size_t size)
+        {
+            static_cast<Connection*>(parser->object)->value.append(data, size);
+        }
+
+        static void finish_value (::scgi_parser * parser)
+        {
+            Connection& self = *static_cast<Connection*>(parser->object);
+            if (::scgi_throttle_is_field(self.throttle, self.field.data(),
+                                         self.field.size()))
+            {
+                self.limited = !::scgi_throttle_admit_at(
+                    self.throttle, self.value.data(), self.value.size(),
+                    self.now);
+            }
+            self.field.clear();
+            self.value.clear();
+        }
+
+        static size_t accept_body (::scgi_parser * parser,
+                                   const char *, size_t size)
+        {
+            static_cast<Connection*>(parser->object)->body_size += size;
+            return (size);
+        }
+    };
+
+    // Feed the request head and stop as soon as the client is known.
+    int limited (::scgi_throttle& throttle, const std::string& request,
+                 ::uint64_t now)
+    {
+        Connection connection(throttle, now);
+        for (size_t i = 0; (i < request.size()) && (connection.limited < 0);
+             ++i)
+        {
+            ::scgi_consume(&connection.parser, &request[i], 1);
+        }
+        check(connection.limited >= 0, "Client header");
+        check(connection.body_size == 0, "Body left unread");
+        return (connection.limited);
+    }
+
+    bool admit (::scgi_throttle& throttle, const std::string& key)
+    {
+        return (::scgi_throttle_admit(&throttle, key.data(), key.size()));
+    }
+
+    bool admit (::scgi_throttle& throttle, const std::string& key,
+                ::uint64_t now)
+    {
+        return (::scgi_throttle_admit_at(&throttle, key.data(), key.size(),
+                                         now));
+    }
+
+    double elapsed (const ::timespec& start)
+    {
+        ::timespec now;
+        ::clock_gettime(CLOCK_MONOTONIC, &now);
+        return ((now.tv_sec - start.tv_sec)*1e9 +
+                (now.tv_nsec - start.tv_nsec));
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-throttle <request-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string request((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+
+    // 10 requests per second, in bursts of 5.
+    ::scgi_throttle throttle;
+    check(::scgi_throttle_setup(&throttle, 1024, 10, 5) == 0, "Setup");
+    int admitted = 0;
+    int refused = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        if (limited(throttle, request, 1000)) {
+            ++refused;
+        }
+        else {
+            ++admitted;
+        }
+    }
+    check(admitted == 5, "Burst");
+    check(admit(throttle, "198.51.100.1", 1000), "Other client");
+
+    // Tokens come back over time: 2.5 in 250ms.
+    int refilled = 0;
+    while (!limited(throttle, request, 1250)) {
+        ++refilled;
+    }
+    check(refilled == 2, "Refill");
+
+    // Insisting doesn't bring them back any faster.
+    refilled = 0;
+    for (::uint64_t now = 1251; now <= 1750; ++now) {
+        refilled += !limited(throttle, request, now);
+    }
+    check((refilled >= 4) && (refilled <= 5), "Refill under load");
+
+    ::scgi_throttle_release(&throttle);
+
+    // Refusing costs a hash and a single cache line.
+    check(::scgi_throttle_setup(&throttle, 1024, 1, 1) == 0, "Setup");
+    const std::string key = "203.0.113.7";
+    check(admit(throttle, key), "First request");
+    ::timespec start;
+    ::clock_gettime(CLOCK_MONOTONIC, &start);
+    int leaked = 0;
+    for (int i = 0; i < 1000000; ++i) {
+        leaked += admit(throttle, key);
+    }
+    std::cerr
+        << "Refused in " << elapsed(start)/1000000 << " ns."
+        << std::endl;
+    check(leaked <= 1, "Still limited");
+    ::scgi_throttle_release(&throttle);
+
+    // A full set evicts the least recently seen client, which comes back
+    // with a full bucket.  Refused requests count: a client can't get a new
+    // bucket by insisting.
+    check(::scgi_throttle_setup(&throttle, 4, 1, 1) == 0, "Setup");
+    check(admit(throttle, "abuser", 1000), "Abuser");
+    for (int i = 0; i < 3; ++i) {
+        check(admit(throttle, std::string(1, char('a'+i)), 1001+i),
+              "Set");
+    }
+    for (::uint64_t now = 1010; now < 1100; ++now) {
+        check(!admit(throttle, "abuser", now), "Abuser limited");
+    }
+    check(admit(throttle, "newcomer", 1100), "Eviction");
+    check(!admit(throttle, "abuser", 1101), "Abuser kept");
+    check(admit(throttle, "a", 1102), "Evicted client");
+    ::scgi_throttle_release(&throttle);
+
+    // Clients keep coming, every set stays usable.
+    check(::scgi_throttle_setup(&throttle, 4, 1, 1) == 0, "Setup");
+    for (int i = 0; i < 100; ++i)
+    {
+        const std::string client(1, char('a'+(i%26)));
+        check(admit(throttle, client + std::string(1, char('a'+i/26))),
+              "New client");
+    }
+    ::scgi_throttle_release(&throttle);
+
+    std::cout
+        << "Throttle: " << admitted << " admitted, "
+        << refused << " refused."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi-timer.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+    // Timer that records when it expired.
+    struct Deadline
+    {
+        ::scgi_timer timer;
+        ::scgi_timer_wheel * wheel;
+        std::size_t expired;
+        std::size_t late;
+        std::size_t restarts;
+    };
+
+    Deadline * owner (::scgi_timer * timer)
+    {
+        return (reinterpret_cast<Deadline*>(
+            reinterpret_cast<char*>(timer) - offsetof(Deadline, timer)));
+    }
+
+    void expire (::scgi_timer * timer)
+    {
+        Deadline& deadline = *owner(timer);
+        ++deadline.expired;
+        if (timer->expires != deadline.wheel->now) {
+            ++deadline.late;
+        }
+        // Some timers re-arm themselves, like idle connections would.
+        if (deadline.restarts > 0) {
+            --deadline.restarts;
+            ::scgi_timer_start(deadline.wheel, timer, 1000);
+        }
+    }
+
+}
+
+int main (int, char **)
+try
+{
+    // Cover all levels, and deadlines past the wheel's range.
+    const ::uint64_t delays[] = {
+        0, 1, 2, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 300000,
+        16777215, 16777216, 20000000,
+    };
+    const std::size_t count = sizeof(delays)/sizeof(delays[0]);
+    ::scgi_timer_wheel wheel;
+    ::scgi_timer_wheel_setup(&wheel, 1000);
+    std::vector<Deadline> deadlines(3*count);
+    for (std::size_t i = 0; i < deadlines.size(); ++i)
+    {
+        Deadline& deadline = deadlines[i];
+        deadline.wheel = &wheel;
+        deadline.expired = 0;
+        deadline.late = 0;
+        deadline.restarts = (i % 3 == 1)? 2 : 0;
+        ::scgi_timer_setup(&deadline.timer, &expire);
+        ::scgi_timer_start(&wheel, &deadline.timer, delays[i % count]);
+    }
+
+    // Every third timer is cancelled.
+    std::size_t stopped = 0;
+    for (std::size_t i = 0; i < deadlines.size(); i += 3, ++stopped) {
+        ::scgi_timer_stop(&wheel, &deadlines[i].timer);
+    }
+
+    // Advance in uneven steps, as a busy I/O loop would.
+    ::uint64_t now = wheel.now;
+    std::size_t expired = 0;
+    for (std::size_t step = 1; wheel.count > 0; step = (step*7 + 3) % 5000) {
+        expired += ::scgi_timer_wheel_advance(&wheel, now += step);
+    }
+
+    std::size_t late = 0;
+    for (std::size_t i = 0; i < deadlines.size(); ++i)
+    {
+        const std::size_t expected = (i % 3 == 0)? 0 : (i % 3 == 1)? 3 : 1;
+        if (deadlines[i].expired != expected) {
+            throw (std::runtime_error("Wrong number of expiries."));
+        }
+        late += deadlines[i].late;
+    }
+    if (late > 0) {
+        throw (std::runtime_error("Timer expired at the wrong tick."));
+    }
+    std::cout
+        << "Timers: " << expired << " expired on time, "
+        << stopped << " stopped."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi-trace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+    // Chrome trace phase for each event.
+    const char * phase (::uint32_t event)
+    {
+        if (event == scgi_trace_handler_begin) {
+            return ("B");
+        }
+        if (event == scgi_trace_handler_end) {
+            return ("E");
+        }
+        return ("i");
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 2)
+    {
+        std::cerr
+            << "Usage: scgi-trace-dump <trace-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    ::scgi_trace_header header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        (std::memcmp(header.magic, "SCGITRC", 8) != 0) ||
+        (header.version != 1))
+    {
+        std::cerr
+            << "Not a trace file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::vector< ::scgi_trace_entry > records(header.count);
+    if ((header.count > 0) &&
+        !file.read(reinterpret_cast<char*>(&records[0]),
+                   header.count*sizeof(::scgi_trace_entry)))
+    {
+        std::cerr
+            << "Trace file is truncated."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+
+    // Timestamps are in microseconds, relative to the first event.
+    ::uint64_t start = 0;
+    for (std::size_t i = 0; i < records.size(); ++i)
+    {
+        if ((i == 0) || (records[i].time < start)) {
+            start = records[i].time;
+        }
+    }
+    // Event names come from a table: don't trust the file.
+    for (std::size_t i = 0; i < records.size(); ++i)
+    {
+        if (records[i].event > scgi_trace_handler_end)
+        {
+            std::cerr
+                << "Trace file is corrupt."
+                << std::endl;
+            return (EXIT_FAILURE);
+        }
+    }
+    std::cout << "{\"traceEvents\":[";
+    for (std::size_t i = 0; i < records.size(); ++i)
+    {
+        const ::scgi_trace_entry& record = records[i];
+        const ::uint64_t time = record.time - start;
+        char timestamp[32];
+        std::sprintf(timestamp, "%lu.%03lu",
+                     static_cast<unsigned long>(time / 1000),
+                     static_cast<unsigned long>(time % 1000));
+        std::cout
+            << ((i == 0)? "\n" : ",\n")
+            << "{\"name\":\"" << ::scgi_trace_name(
+                static_cast< ::scgi_trace_event>(record.event)) << "\""
+            << ",\"ph\":\"" << phase(record.event) << "\""
+            << ((*phase(record.event) == 'i')? ",\"s\":\"t\"" : "")
+            << ",\"ts\":" << timestamp
+            << ",\"pid\":1,\"tid\":" << record.thread
+            << ",\"args\":{\"request\":" << record.request
+            << ",\"size\":" << record.size << "}}";
+    }
+    std::cout
+        << "\n],\"displayTimeUnit\":\"ns\"}"
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}
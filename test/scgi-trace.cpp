@@ -0,0 +1,118 @@
+// Copyright (c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "scgi.h"
+#include "scgi-trace.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+namespace {
+
+    void accept (::scgi_parser*, const char *, size_t)
+    {
+    }
+
+    void finish_head (::scgi_parser*)
+    {
+    }
+
+    size_t accept_body (::scgi_parser*, const char *, size_t size)
+    {
+        return (size);
+    }
+
+}
+
+int main (int argc, char ** argv)
+try
+{
+    if (argc != 3)
+    {
+        std::cerr
+            << "Usage: scgi-trace <request-file> <trace-file>"
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr
+            << "Could not open input file."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    // Trace every other request.
+    ::scgi_trace_setup(2, 1024);
+    ::scgi_limits limits;
+    limits.max_head_size = 0;
+    limits.max_body_size = 0;
+    ::scgi_parser parser;
+    ::scgi_setup(&limits, &parser);
+    parser.accept_field = &accept;
+    parser.accept_value = &accept;
+    parser.finish_head = &finish_head;
+    parser.accept_body = &accept_body;
+    for (int i = 0; i < 4; ++i)
+    {
+        ::scgi_clear(&parser);
+        const std::size_t half = data.size() / 2;
+        ::scgi_consume(&parser, data.data(), half);
+        ::scgi_consume(&parser, data.data()+half, data.size()-half);
+#ifdef SCGI_TRACE
+        const ::uint64_t request = parser.trace;
+#else
+        // Without SCGI_TRACE, the parser does not sample requests.
+        const ::uint64_t request = ::scgi_trace_sample();
+#endif
+        ::scgi_trace_record(request, scgi_trace_handler_begin, 0);
+        ::scgi_trace_record(request, scgi_trace_handler_end, 0);
+    }
+    if (::scgi_trace_save(argv[2]) < 0)
+    {
+        std::cerr
+            << "Could not save trace."
+            << std::endl;
+        return (EXIT_FAILURE);
+    }
+    std::cout
+        << "Trace: saved."
+        << std::endl;
+}
+catch (const std::exception& error)
+{
+    std::cerr
+        << error.what()
+        << std::endl;
+    return (EXIT_FAILURE);
+}
+catch (...)
+{
+    std::cerr
+        << "Unknown error."
+        << std::endl;
+    return (EXIT_FAILURE);
+}